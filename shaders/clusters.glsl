@@ -0,0 +1,43 @@
+// Light lists of view frustum clusters (froxels), written by cullLights.comp (see LightClusters).
+// Clusters are screen tiles split into CLUSTER_Z slices, exponentially spaced in view depth.
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+
+struct LightCluster {
+    uint offset;
+    uint count;
+};
+
+layout(std430, binding = 8) buffer LightClusterBlock {
+    LightCluster clusters[];
+};
+
+layout(std430, binding = 9) buffer LightIndexBlock {
+    uint lightIndexCount;
+    uint lightIndices[];
+};
+
+uniform vec2 clusterTileSize;   // in pixels
+uniform float clusterNear, clusterFar;
+
+// Distance to the camera plane of the near side of a slice
+float clusterSliceDepth(uint slice) {
+    return clusterNear * pow(clusterFar / clusterNear, float(slice) / CLUSTER_Z);
+}
+
+uint clusterSlice(float depth) {
+    float slice = log(depth / clusterNear) / log(clusterFar / clusterNear) * CLUSTER_Z;
+    return uint(clamp(slice, 0, CLUSTER_Z - 1));
+}
+
+// depth is the distance to the camera plane, gl_FragCoord.z can be linearized with clusterLinearDepth
+uint clusterIndex(vec2 fragCoord, float depth) {
+    uvec2 tile = min(uvec2(fragCoord / clusterTileSize), uvec2(CLUSTER_X - 1, CLUSTER_Y - 1));
+    return tile.x + CLUSTER_X * (tile.y + CLUSTER_Y * clusterSlice(depth));
+}
+
+float clusterLinearDepth(float fragDepth) {
+    float z = fragDepth * 2.0 - 1.0;
+    return 2.0 * clusterNear * clusterFar / (clusterFar + clusterNear - z * (clusterFar - clusterNear));
+}
@@ -1,6 +1,6 @@
 const float PI = 3.1415982;
 
-uniform mat4 pv;
+// Expects shaders/frame.glsl to be included first, for pv
 
 // Returns position of a voxel in texture coordinates. worldPosition assumed inside the voxel volume.
 vec3 voxelLinearPosition(vec3 worldPosition, vec3 voxelCenter, vec3 voxelMin, vec3 voxelMax) {
@@ -41,8 +41,9 @@ vec3 voxelTesselationWarpedPosition(vec3 position) {
     return projected.xyz;
 }
 
-vec3 getVoxelPosition(vec3 pos, int voxelDim, vec3 voxelCenter, vec3 voxelMin, vec3 voxelMax, bool warpVoxels) {
-    if (warpVoxels) {
+// warp is usually warpVoxels, it isn't named so since a specialized variant turns that into a constant
+vec3 getVoxelPosition(vec3 pos, int voxelDim, vec3 voxelCenter, vec3 voxelMin, vec3 voxelMax, bool warp) {
+    if (warp) {
         pos = voxelWarpedPosition(pos, eye, voxelCenter, voxelMin, voxelMax);
     }
     else if (warpTexture) {
@@ -59,8 +60,40 @@ vec3 getVoxelPosition(vec3 pos, int voxelDim, vec3 voxelCenter, vec3 voxelMin, v
     return pos;
 }
 
-vec3 voxelIndex(vec3 pos, int voxelDim, vec3 voxelCenter, vec3 voxelMin, vec3 voxelMax, bool warpVoxels) {
-    return voxelDim * getVoxelPosition(pos, voxelDim, voxelCenter, voxelMin, voxelMax, warpVoxels);
+vec3 voxelIndex(vec3 pos, int voxelDim, vec3 voxelCenter, vec3 voxelMin, vec3 voxelMax, bool warp) {
+    return voxelDim * getVoxelPosition(pos, voxelDim, voxelCenter, voxelMin, voxelMax, warp);
+}
+
+// Clipmap cascades: cascade c covers 2^c times the volume around voxelCenter at the same voxelDim. The
+// voxel textures stack them along z, cascade c at [c, c + 1) / voxelCascades.
+float cascadeScale(int cascade) {
+    return float(1 << cascade);
+}
+
+// Maps texture coordinates within cascade 0 to those within the given cascade
+vec3 cascadePosition(vec3 tc, int cascade) {
+    vec3 k = voxelMin / (voxelMax - voxelMin);
+    return (tc + k) / cascadeScale(cascade) - k;
+}
+
+// Toroidal addressing: while the volume follows the camera, a cascade's voxels keep their texels and wrap
+// around the textures, so moving only revoxelizes the cells it uncovers (Application::updateVoxelScroll)
+vec3 toroidalTexcoord(vec3 tc, int cascade) {
+    return voxelToroidal ? fract(tc + vec3(voxelScroll[cascade].xyz) / voxelDim) : tc;
+}
+
+// texel may be off the volume by less than voxelDim
+ivec3 toroidalTexel(ivec3 texel, int cascade) {
+    return voxelToroidal ? (texel + voxelScroll[cascade].xyz + voxelDim) % voxelDim : texel;
+}
+
+// Coordinates of tc within a cascade in the stacked textures. z keeps half a texel of the coarser level
+// sampled at lod away from the cascade's bounds, so filtering doesn't reach the neighbouring cascades.
+vec3 cascadeTexcoord(vec3 tc, int cascade, float lod) {
+    tc = toroidalTexcoord(tc, cascade);
+    float halfTexel = 0.5 * exp2(ceil(lod)) / voxelDim;
+    tc.z = (clamp(tc.z, halfTexel, 1 - halfTexel) + cascade) / voxelCascades;
+    return tc;
 }
 
 vec3 linearVoxelSize(int voxelDim, vec3 voxelMin, vec3 voxelMax) {
@@ -11,9 +11,7 @@ layout(binding = 0) uniform sampler3D voxels;
 
 uniform mat4 mvp;
 
-uniform float level = 0.0;
-uniform float voxelDim;
-uniform vec3 voxelMin, voxelMax, voxelCenter;
+#pragma include "frame.glsl"
 
 void main() {
     float instance = float(gl_InstanceID);
@@ -23,7 +21,11 @@ void main() {
     vec3 voxelPosition = vec3(x,y,z) + 0.5 / voxelDim;
 
     vec3 tc = voxelPosition;
-    vs_out.voxelColor = textureLod(voxels, tc, level);
+    if (voxelToroidal) {
+        tc = fract(tc + vec3(voxelScroll[0].xyz) / voxelDim);
+    }
+    tc.z /= voxelCascades;  // only cascade 0 of the clipmap
+    vs_out.voxelColor = textureLod(voxels, tc, miplevel);
 
     // TODO doesn't account for warping (will need to scale cubes differently too)
     vs_out.worldPosition = position + voxelCenter + mix(voxelMin, voxelMax, voxelPosition);
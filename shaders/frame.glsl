@@ -0,0 +1,163 @@
+// Constants shared by every pass, written once per frame by FrameConstants and bound at fixed points.
+// Members are named like the uniforms they replaced. Must match the structs in FrameConstants.h.
+
+layout(std140, binding = 0) uniform FrameBlock {
+    mat4 projection;
+    mat4 view;
+    mat4 pv;            // camera with a shorter depth range, for the voxel warp
+    mat4 ls;            // light space of the main light
+    mat4 lsInverse;
+    vec3 eye;
+    vec3 lightPos;      // main light
+    vec3 lightInt;
+};
+
+layout(std140, binding = 1) uniform VoxelBlock {
+    mat4 mvp_x, mvp_y, mvp_z;   // orthographic views of the voxel volume along each axis
+    vec3 voxelMin;
+    int voxelDim;
+    vec3 voxelMax;
+    bool warpVoxels;
+    vec3 voxelCenter;
+    bool warpTexture;
+    bool voxelizeTesselationWarp;
+    int voxelCascades;          // clipmap cascades stacked along z, see common.glsl
+    int voxelLevels;
+    bool voxelToroidal;         // voxels wrap around the textures, offset by voxelScroll texels per cascade
+    ivec4 voxelScroll[4];
+};
+
+layout(std140, binding = 2) uniform SettingsBlock {
+    bool voxelize, normals, dominant_axis, radiance;
+    bool drawWarpSlope, drawOcclusion;
+    bool debugOcclusion, debugIndirect, debugReflections;
+    bool debugMaterialDiffuse, debugMaterialRoughness, debugMaterialMetallic;
+    bool debugWarpTexture;
+    bool toggle;
+
+    bool cooktorrance;
+    bool clusteredLighting;
+    bool enablePostprocess, enableShadows, enableNormalMap, enableIndirect;
+    bool enableDiffuse, enableSpecular, enableReflections;
+    float ambientScale, reflectScale;
+    float miplevel;
+
+    int vctSteps;
+    float vctConeAngle, vctBias, vctConeInitialHeight, vctLodOffset;
+    int vctSpecularSteps;
+    float vctSpecularConeAngle, vctSpecularBias, vctSpecularConeInitialHeight, vctSpecularLodOffset;
+    bool vctSpecularConeAngleFromRoughness;
+
+    int axis_override;
+    bool voxelizeDilate, voxelizeAtomicMax, voxelizeLighting;
+
+    bool radianceLighting, radianceDilate, temporalFilterRadiance;
+    float temporalDecay;
+    float voxelSetOpacity;
+    bool voxelOctree;       // trace the sparse voxel octree (octree.glsl) instead of the dense volume
+};
+
+// A specialized variant (ProgramVariants) defines SPECIALIZE_<name> as true or false for the booleans
+// its sources use. Those replace the block members from here on, so the compiler drops the dead branches.
+#ifdef SPECIALIZE_warpVoxels
+#define warpVoxels SPECIALIZE_warpVoxels
+#endif
+#ifdef SPECIALIZE_warpTexture
+#define warpTexture SPECIALIZE_warpTexture
+#endif
+#ifdef SPECIALIZE_voxelizeTesselationWarp
+#define voxelizeTesselationWarp SPECIALIZE_voxelizeTesselationWarp
+#endif
+#ifdef SPECIALIZE_voxelize
+#define voxelize SPECIALIZE_voxelize
+#endif
+#ifdef SPECIALIZE_normals
+#define normals SPECIALIZE_normals
+#endif
+#ifdef SPECIALIZE_dominant_axis
+#define dominant_axis SPECIALIZE_dominant_axis
+#endif
+#ifdef SPECIALIZE_radiance
+#define radiance SPECIALIZE_radiance
+#endif
+#ifdef SPECIALIZE_drawWarpSlope
+#define drawWarpSlope SPECIALIZE_drawWarpSlope
+#endif
+#ifdef SPECIALIZE_drawOcclusion
+#define drawOcclusion SPECIALIZE_drawOcclusion
+#endif
+#ifdef SPECIALIZE_debugOcclusion
+#define debugOcclusion SPECIALIZE_debugOcclusion
+#endif
+#ifdef SPECIALIZE_debugIndirect
+#define debugIndirect SPECIALIZE_debugIndirect
+#endif
+#ifdef SPECIALIZE_debugReflections
+#define debugReflections SPECIALIZE_debugReflections
+#endif
+#ifdef SPECIALIZE_debugMaterialDiffuse
+#define debugMaterialDiffuse SPECIALIZE_debugMaterialDiffuse
+#endif
+#ifdef SPECIALIZE_debugMaterialRoughness
+#define debugMaterialRoughness SPECIALIZE_debugMaterialRoughness
+#endif
+#ifdef SPECIALIZE_debugMaterialMetallic
+#define debugMaterialMetallic SPECIALIZE_debugMaterialMetallic
+#endif
+#ifdef SPECIALIZE_debugWarpTexture
+#define debugWarpTexture SPECIALIZE_debugWarpTexture
+#endif
+#ifdef SPECIALIZE_toggle
+#define toggle SPECIALIZE_toggle
+#endif
+#ifdef SPECIALIZE_cooktorrance
+#define cooktorrance SPECIALIZE_cooktorrance
+#endif
+#ifdef SPECIALIZE_clusteredLighting
+#define clusteredLighting SPECIALIZE_clusteredLighting
+#endif
+#ifdef SPECIALIZE_enablePostprocess
+#define enablePostprocess SPECIALIZE_enablePostprocess
+#endif
+#ifdef SPECIALIZE_enableShadows
+#define enableShadows SPECIALIZE_enableShadows
+#endif
+#ifdef SPECIALIZE_enableNormalMap
+#define enableNormalMap SPECIALIZE_enableNormalMap
+#endif
+#ifdef SPECIALIZE_enableIndirect
+#define enableIndirect SPECIALIZE_enableIndirect
+#endif
+#ifdef SPECIALIZE_enableDiffuse
+#define enableDiffuse SPECIALIZE_enableDiffuse
+#endif
+#ifdef SPECIALIZE_enableSpecular
+#define enableSpecular SPECIALIZE_enableSpecular
+#endif
+#ifdef SPECIALIZE_enableReflections
+#define enableReflections SPECIALIZE_enableReflections
+#endif
+#ifdef SPECIALIZE_vctSpecularConeAngleFromRoughness
+#define vctSpecularConeAngleFromRoughness SPECIALIZE_vctSpecularConeAngleFromRoughness
+#endif
+#ifdef SPECIALIZE_voxelizeDilate
+#define voxelizeDilate SPECIALIZE_voxelizeDilate
+#endif
+#ifdef SPECIALIZE_voxelizeAtomicMax
+#define voxelizeAtomicMax SPECIALIZE_voxelizeAtomicMax
+#endif
+#ifdef SPECIALIZE_voxelizeLighting
+#define voxelizeLighting SPECIALIZE_voxelizeLighting
+#endif
+#ifdef SPECIALIZE_radianceLighting
+#define radianceLighting SPECIALIZE_radianceLighting
+#endif
+#ifdef SPECIALIZE_radianceDilate
+#define radianceDilate SPECIALIZE_radianceDilate
+#endif
+#ifdef SPECIALIZE_temporalFilterRadiance
+#define temporalFilterRadiance SPECIALIZE_temporalFilterRadiance
+#endif
+#ifdef SPECIALIZE_voxelOctree
+#define voxelOctree SPECIALIZE_voxelOctree
+#endif
@@ -0,0 +1,21 @@
+// Scene lights, mirrored by LightData in Scene.h
+#define POINT_LIGHT 0
+#define DIRECTIONAL_LIGHT 1
+struct Light {
+                        // base		offset
+    vec3 position;		// 16		0
+    vec3 direction;		// 16		16
+    vec3 color;			// 16		32
+
+    float range;		// 4		44
+    float intensity;	// 4		48
+
+    bool enabled;		// 4		52
+    bool selected;		// 4		56
+    bool shadowCaster;	// 4		60
+    uint type;			// 4		64
+};
+
+layout(std140, binding = 3) buffer LightBlock {
+    Light lights[];
+};
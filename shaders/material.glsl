@@ -0,0 +1,38 @@
+// Materials of every loaded mesh, indexed by DrawData.material (see MaterialTable).
+// Texture references are ARB_bindless_texture handles when bindlessMaterials is set,
+// otherwise (array + 1, layer) into materialArrays. (0, 0) means the material has no such map.
+// Must be included before any declarations since it enables an extension.
+#extension GL_ARB_bindless_texture : enable
+
+struct Material {
+    vec3 ambient;
+    float shininess;
+    vec3 diffuse;
+    float roughness;
+    vec3 specular;
+    float metallic;
+
+    uvec2 diffuseMap, specularMap, normalMap, roughnessMap, metallicMap, alphaMap;
+};
+
+layout(std430, binding = 7) readonly buffer MaterialBlock {
+    Material materials[];
+};
+
+#define MATERIAL_ARRAY_COUNT 8
+layout(binding = 11) uniform sampler2DArray materialArrays[MATERIAL_ARRAY_COUNT];
+
+uniform bool bindlessMaterials = false;
+
+bool hasMap(uvec2 map) {
+    return map != uvec2(0);
+}
+
+vec4 sampleMap(uvec2 map, vec2 texcoord) {
+#ifdef GL_ARB_bindless_texture
+    if (bindlessMaterials) {
+        return texture(sampler2D(map), texcoord);
+    }
+#endif
+    return texture(materialArrays[map.x - 1], vec3(texcoord, map.y));
+}
@@ -0,0 +1,108 @@
+// Sparse voxel octree (SparseVoxelOctree), after OpenGL Insights chapter 22. Siblings are allocated
+// together in tiles of 2x2x2 nodes, tile 0 holds the children of the root. A node stores the tile of
+// its children, 0 for none. Node values live in brick pools, 3D textures with a brick of 2x2x2 texels
+// per tile, so the texture unit filters between siblings.
+// Nodes at depth d cover voxelDim >> d voxels (rounded up to a power of two), the leaves are single voxels.
+// frame.glsl must be included first.
+
+const uint OCTREE_CHILD_MASK = 0x7FFFFFFFu;
+const uint OCTREE_SUBDIVIDE = 0x80000000u;  // set by the flag pass, replaced by the child tile
+const uint OCTREE_NONE = 0xFFFFFFFFu;
+
+struct OctreeLevel {
+    uint tileStart, tileCount;
+    uint numGroupsX, numGroupsY, numGroupsZ;  // indirect dispatch over the nodes of the level
+    uint pad0, pad1, pad2;
+};
+
+// Voxel fragment from voxelize.frag, position packed 10:10:10 and values packUnorm4x8
+struct VoxelFragment {
+    uint position, color, normal;
+};
+
+layout(std430, binding = 10) buffer OctreeNodeBlock {
+    uint octreeNodes[];
+};
+
+layout(std430, binding = 11) buffer OctreeFragmentBlock {
+    uint octreeFragmentCount;   // may exceed octreeFragments.length(), the rest were dropped
+    uint fragmentPad0, fragmentPad1, fragmentPad2;
+    VoxelFragment octreeFragments[];
+};
+
+layout(std430, binding = 12) buffer OctreeInfoBlock {
+    uint octreeTileCount;       // may exceed the pool, nodes are only linked to tiles that fit
+    uint infoPad0, infoPad1, infoPad2, infoPad3, infoPad4, infoPad5, infoPad6;
+    OctreeLevel octreeLevels[]; // indexed by depth
+};
+
+int octreeDepth() {
+    return findMSB(voxelDim - 1) + 1;
+}
+
+uint packVoxelPosition(uvec3 p) {
+    return p.x | (p.y << 10) | (p.z << 20);
+}
+
+uvec3 unpackVoxelPosition(uint p) {
+    return uvec3(p & 0x3FFu, (p >> 10) & 0x3FFu, (p >> 20) & 0x3FFu);
+}
+
+// Which child of its parent the node at depth containing voxel is
+uint octreeChildIndex(uvec3 voxel, int depth, int maxDepth) {
+    uvec3 c = (voxel >> uint(maxDepth - depth)) & 1u;
+    return c.x | (c.y << 1) | (c.z << 2);
+}
+
+// Node at depth containing voxel, OCTREE_NONE if an ancestor has no children
+uint octreeLookup(uvec3 voxel, int depth) {
+    int maxDepth = octreeDepth();
+    uint tile = 0;
+    for (int d = 1; d < depth; d++) {
+        tile = octreeNodes[tile * 8 + octreeChildIndex(voxel, d, maxDepth)] & OCTREE_CHILD_MASK;
+        if (tile == 0) {
+            return OCTREE_NONE;
+        }
+    }
+    return tile * 8 + octreeChildIndex(voxel, depth, maxDepth);
+}
+
+ivec3 octreeBrick(uint tile, int brickPoolDim) {
+    uint tiles = uint(brickPoolDim / 2);
+    return 2 * ivec3(tile % tiles, (tile / tiles) % tiles, tile / (tiles * tiles));
+}
+
+ivec3 octreeBrickTexel(uint node, int brickPoolDim) {
+    uint c = node & 7u;
+    return octreeBrick(node >> 3, brickPoolDim) + ivec3(c & 1u, (c >> 1) & 1u, (c >> 2) & 1u);
+}
+
+// Value at a position in [0, 1] of the volume, interpolated between the nodes at the fractional depth
+// around it. Empty where the octree has no nodes.
+vec4 sampleOctree(sampler3D bricks, vec3 position, float depth) {
+    int maxDepth = octreeDepth();
+    depth = clamp(depth, 1.0, float(maxDepth));
+    int d0 = int(depth), d1 = min(d0 + 1, maxDepth);
+
+    // The octree covers a power of two voxels, which can be more than voxelDim
+    vec3 p = clamp(position * float(voxelDim) / float(1 << maxDepth), vec3(0), vec3(0.99999));
+    uvec3 voxel = uvec3(p * float(1 << maxDepth));
+    float brickPoolDim = float(textureSize(bricks, 0).x);
+
+    vec4 s0 = vec4(0), s1 = vec4(0);
+    uint tile = 0;
+    for (int d = 1; d <= d1; d++) {
+        // tile holds the nodes at depth d, clamped to the brick since there is no border
+        if (d >= d0) {
+            vec3 local = clamp(fract(p * float(1 << (d - 1))) * 2.0, vec3(0.5), vec3(1.5));
+            vec4 s = textureLod(bricks, (vec3(octreeBrick(tile, int(brickPoolDim))) + local) / brickPoolDim, 0);
+            if (d == d0) s0 = s; else s1 = s;
+        }
+        if (d == d1) break;
+
+        tile = octreeNodes[tile * 8 + octreeChildIndex(voxel, d, maxDepth)] & OCTREE_CHILD_MASK;
+        if (tile == 0) break;
+    }
+
+    return mix(s0, s1, depth - float(d0));
+}
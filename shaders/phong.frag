@@ -2,10 +2,13 @@
 
 #define NORMAL_MAP
 
+#pragma include "material.glsl"
+
 in VS_OUT {
     vec3 fragPosition;
     vec3 fragNormal;
     vec2 fragTexcoord;
+    flat uint material;
 
     vec4 lightFragPos;
 
@@ -17,60 +20,11 @@ in VS_OUT {
 #endif
 } fs_in;
 
-#define POINT_LIGHT 0
-#define DIRECTIONAL_LIGHT 1
-struct Light {
-                        // base		offset
-    vec3 position;		// 16		0
-    vec3 direction;		// 16		16
-    vec3 color;			// 16		32
-
-    float range;		// 4		44
-    float intensity;	// 4		48
-
-    bool enabled;		// 4		52
-    bool selected;		// 4		56
-    bool shadowCaster;	// 4		60
-    uint type;			// 4		64
-};
-
-layout(std140, binding = 3) buffer LightBlock {
-    Light lights[];
-};
-
-struct Material {
-                        // base		offset
-    vec3 ambient;		// 16		0
-    vec3 diffuse;		// 16		16
-    vec3 specular;		// 16		32
-    float shininess;	// 4		44
-
-    bool hasAmbientMap;	// 4		48
-    bool hasDiffuseMap;	// 4		52
-    bool hasSpecularMap;// 4		56
-    bool hasAlphaMap;	// 4		60
-    bool hasNormalMap;	// 4		64
-    bool hasRoughnessMap;//4        68
-    bool hasMetallicMap; //4        72
-};
-
-layout(std140) uniform MaterialBlock {
-    Material material;
-};
-
-// uniform sampler2D ambientMap;
-layout(binding = 9) uniform sampler2D alphaMap;
+#pragma include "light.glsl"
 
-layout(binding = 0) uniform sampler2D diffuseMap;
-layout(binding = 1) uniform sampler2D specularMap;
-
-#ifdef NORMAL_MAP
-layout(binding = 5) uniform sampler2D normalMap;
-#endif
+#pragma include "clusters.glsl"
 
 layout(binding = 6) uniform sampler2D shadowmap;
-layout(binding = 7) uniform sampler2D roughnessMap;
-layout(binding = 8) uniform sampler2D metallicMap;
 
 layout(binding = 2) uniform sampler3D voxelColor;
 layout(binding = 3) uniform sampler3D voxelNormal;
@@ -78,61 +32,88 @@ layout(binding = 4) uniform sampler3D voxelRadiance;
 
 layout(binding = 10) uniform sampler3D warpmap;
 
-uniform bool voxelize = false;
-uniform bool normals = false;
-uniform bool dominant_axis = false;
-uniform bool radiance = false;
-uniform bool drawWarpSlope = false;
-uniform bool drawOcclusion = false;
-uniform bool debugOcclusion = false;
-uniform bool debugIndirect = false;
-uniform bool debugReflections = false;
-uniform bool debugMaterialDiffuse = false, debugMaterialRoughness = false, debugMaterialMetallic = false;
-uniform bool debugWarpTexture = false;
-uniform bool toggle = false;
-
-uniform bool cooktorrance = true;
-
-uniform bool enablePostprocess = false;
-uniform bool enableShadows = true;
-uniform bool enableNormalMap = true;
-uniform bool enableIndirect = false;
-uniform bool enableDiffuse = true;
-uniform bool enableSpecular = true;
-uniform bool enableReflections = false;
-uniform float ambientScale = 0.2;
-uniform float reflectScale = 0.5;
-
-uniform vec3 eye;
-uniform mat4 ls;
-
-uniform float miplevel = 0.0;
-uniform int voxelDim;
-uniform vec3 voxelMin, voxelMax;
-uniform vec3 voxelCenter;
-uniform bool warpVoxels;
-uniform bool warpTexture;
-uniform bool voxelizeTesselationWarp;
-
-uniform int vctSteps;
-uniform float vctConeAngle;
-uniform float vctBias;
-uniform float vctConeInitialHeight;
-uniform float vctLodOffset;
-uniform int vctSpecularSteps;
-uniform float vctSpecularConeAngle;
-uniform float vctSpecularBias;
-uniform float vctSpecularConeInitialHeight;
-uniform float vctSpecularLodOffset;
-uniform bool vctSpecularConeAngleFromRoughness;
+#pragma include "frame.glsl"
 
 out vec4 color;
 
 #pragma include "common.glsl"
 
+#pragma include "octree.glsl"
+
+// traceCone through the sparse voxel octree, the voxel samplers are then bound to its brick pools.
+// Depth in the octree takes the place of the mip level. Warping isn't supported.
+vec4 traceConeOctree(sampler3D bricks, vec3 position, vec3 normal, vec3 direction, int steps, float bias, float coneAngle, float coneHeight, float lodOffset) {
+    direction = normalize(direction);
+
+    vec3 color = vec3(0);
+    float alpha = 0;
+
+    float scale = 1.0 / voxelDim;
+    float maxDepth = float(octreeDepth());
+    vec3 start = position + bias * normal * scale;
+    for (int i = 0; i < steps && alpha < 0.95; i++) {
+        float coneRadius = coneHeight * tan(coneAngle / 2.0);
+        float lod = log2(max(1.0, 2 * coneRadius));
+        vec3 samplePosition = start + coneHeight * direction * scale;
+        if (any(notEqual(samplePosition, clamp(samplePosition, 0, 1)))) break;
+        vec4 sampleColor = sampleOctree(bricks, samplePosition, maxDepth - (lod + lodOffset));
+        float a = 1 - alpha;
+        color += sampleColor.rgb * a;
+        alpha += a * sampleColor.a;
+        coneHeight += coneRadius;
+    }
+
+    return vec4(color, alpha);
+}
+
+// traceCone through the clipmap cascades, positions and cone heights stay relative to cascade 0. A sample
+// reads the finest cascade whose mips reach the cone's footprint and that holds the whole footprint.
+// Also used for toroidal addressing. Warping isn't supported.
+vec4 traceConeClipmap(sampler3D voxelTexture, vec3 position, vec3 normal, vec3 direction, int steps, float bias, float coneAngle, float coneHeight, float lodOffset) {
+    direction = normalize(direction);
+
+    vec3 color = vec3(0);
+    float alpha = 0;
+
+    float scale = 1.0 / voxelDim;
+    vec3 start = position + bias * normal * scale;
+    for (int i = 0; i < steps && alpha < 0.95; i++) {
+        float coneRadius = coneHeight * tan(coneAngle / 2.0);
+        float lod = log2(max(1.0, 2 * coneRadius)) + lodOffset;
+        vec3 samplePosition = start + coneHeight * direction * scale;
+
+        int cascade = clamp(int(floor(lod)) - (voxelLevels - 1), 0, voxelCascades - 1);
+        vec3 tc = cascadePosition(samplePosition, cascade);
+        for (; cascade < voxelCascades - 1; cascade++) {
+            float margin = 0.5 * exp2(max(lod - cascade, 0.0)) * scale;
+            if (all(equal(tc, clamp(tc, margin, 1 - margin)))) break;
+            tc = cascadePosition(samplePosition, cascade + 1);
+        }
+        if (any(notEqual(tc, clamp(tc, 0, 1)))) break;
+
+        float cascadeLod = max(lod - cascade, 0.0);
+        vec4 sampleColor = textureLod(voxelTexture, cascadeTexcoord(tc, cascade, cascadeLod), cascadeLod);
+        float a = 1 - alpha;
+        color += sampleColor.rgb * a;
+        alpha += a * sampleColor.a;
+
+        // Outer cascades are coarser than the footprint close by, step by at least half their voxel
+        coneHeight += max(coneRadius, 0.5 * cascadeScale(cascade));
+    }
+
+    return vec4(color, alpha);
+}
+
 // Performs voxel cone tracing through a given voxelTexture
 // based on https://github.com/godotengine/godot/blob/master/drivers/gles3/shaders/scene.glsl
 vec4 traceCone(sampler3D voxelTexture, vec3 position, vec3 normal, vec3 direction, int steps, float bias, float coneAngle, float coneHeight, float lodOffset) {
+    if (voxelOctree) {
+        return traceConeOctree(voxelTexture, position, normal, direction, steps, bias, coneAngle, coneHeight, lodOffset);
+    }
+    if (voxelCascades > 1 || voxelToroidal) {
+        return traceConeClipmap(voxelTexture, position, normal, direction, steps, bias, coneAngle, coneHeight, lodOffset);
+    }
+
     direction = normalize(direction);
 
     vec3 color = vec3(0);
@@ -306,17 +287,26 @@ LightingResult calculateDirectLighting(Material m, vec4 diffuseColor, vec3 eye,
     vec3 V = normalize(eye - P);
 
     float roughness = .5;    // TODO better default roughness?
-    if (m.hasRoughnessMap) {
-        roughness = texture(roughnessMap, fs_in.fragTexcoord).r;    // TODO always sample from level 0?
+    if (hasMap(m.roughnessMap)) {
+        roughness = sampleMap(m.roughnessMap, fs_in.fragTexcoord).r;    // TODO always sample from level 0?
     }
 
     float metallic = 0;
-    if (m.hasMetallicMap) {
-        metallic = texture(metallicMap, fs_in.fragTexcoord).r;
+    if (hasMap(m.metallicMap)) {
+        metallic = sampleMap(m.metallicMap, fs_in.fragTexcoord).r;
+    }
+
+    // Only the lights reaching this fragment's cluster when clustered
+    uint lightCount = lights.length(), firstLight = 0;
+    if (clusteredLighting) {
+        LightCluster cluster = clusters[clusterIndex(gl_FragCoord.xy, clusterLinearDepth(gl_FragCoord.z))];
+        lightCount = cluster.count;
+        firstLight = cluster.offset;
     }
 
     LightingResult finalLighting = LightingResult(vec3(0), vec3(0));
-    for (int i = 0; i < lights.length(); i++) {
+    for (uint j = 0; j < lightCount; j++) {
+        uint i = clusteredLighting ? lightIndices[firstLight + j] : j;
         if (!lights[i].enabled) continue;
 
         LightingResult lighting = LightingResult(vec3(0), vec3(0));
@@ -344,7 +334,26 @@ LightingResult calculateDirectLighting(Material m, vec4 diffuseColor, vec3 eye,
 }
 
 void main() {
-    if (voxelize) {
+    Material material = materials[fs_in.material];
+
+    if (voxelize && voxelOctree) {
+        vec3 i = voxelLinearPosition(fs_in.fragPosition, voxelCenter, voxelMin, voxelMax);
+        float depth = float(octreeDepth()) - miplevel;
+        color = sampleOctree(normals ? voxelNormal : radiance ? voxelRadiance : voxelColor, i, depth);
+        return;
+    }
+    else if (voxelize && (voxelCascades > 1 || voxelToroidal)) {
+        // The finest cascade holding the fragment
+        vec3 i = voxelLinearPosition(fs_in.fragPosition, voxelCenter, voxelMin, voxelMax);
+        int cascade = 0;
+        vec3 tc = i;
+        while (cascade < voxelCascades - 1 && any(notEqual(tc, clamp(tc, 0, 1)))) {
+            tc = cascadePosition(i, ++cascade);
+        }
+        color = textureLod(normals ? voxelNormal : radiance ? voxelRadiance : voxelColor, cascadeTexcoord(tc, cascade, miplevel), miplevel);
+        return;
+    }
+    else if (voxelize) {
         vec3 i = voxelIndex(fs_in.fragPosition, voxelDim, voxelCenter, voxelMin, voxelMax, warpVoxels) / voxelDim;
 
         if (normals) {
@@ -404,32 +413,33 @@ void main() {
     }
     else if (debugMaterialDiffuse) {
         color = vec4(0.5, 0.0, 0.5, 1.0);
-        if (material.hasDiffuseMap) {
-            color = vec4(texture(diffuseMap, fs_in.fragTexcoord).rgb, 1);
+        if (hasMap(material.diffuseMap)) {
+            color = vec4(sampleMap(material.diffuseMap, fs_in.fragTexcoord).rgb, 1);
         }
         return;
     }
     else if (debugMaterialRoughness) {
         color = vec4(0.5, 0.0, 0.5, 1.0);
-        if (material.hasRoughnessMap) {
-            color = vec4(vec3(texture(roughnessMap, fs_in.fragTexcoord).r), 1);
+        if (hasMap(material.roughnessMap)) {
+            color = vec4(vec3(sampleMap(material.roughnessMap, fs_in.fragTexcoord).r), 1);
         }
         return;
     }
     else if (debugMaterialMetallic) {
         color = vec4(0.5, 0.0, 0.5, 1.0);
-        if (material.hasMetallicMap) {
-            color = vec4(vec3(texture(metallicMap, fs_in.fragTexcoord).r), 1);
+        if (hasMap(material.metallicMap)) {
+            color = vec4(vec3(sampleMap(material.metallicMap, fs_in.fragTexcoord).r), 1);
         }
         return;
     }
 
     vec3 normal;
 #ifdef NORMAL_MAP
-    if (enableNormalMap && material.hasNormalMap) {
+    if (enableNormalMap && hasMap(material.normalMap)) {
 
-        normal = texture(normalMap, fs_in.fragTexcoord).rgb;
-        normal = normalize(normal * 2.0 - 1.0);
+        // z is reconstructed so two channel (BC5) normal maps work as well
+        normal.xy = sampleMap(material.normalMap, fs_in.fragTexcoord).rg * 2.0 - 1.0;
+        normal.z = sqrt(max(1.0 - dot(normal.xy, normal.xy), 0.0));
         normal = normalize(fs_in.TBN * normal);
     }
     else
@@ -446,7 +456,7 @@ void main() {
         color = vec4(step(vec3(max(max(normal.x, normal.y), normal.z)), normal.xyz), 1);
     }
     else {
-        vec4 diffuseColor = material.hasDiffuseMap ? texture(diffuseMap, fs_in.fragTexcoord) : vec4(material.diffuse, 1);
+        vec4 diffuseColor = hasMap(material.diffuseMap) ? sampleMap(material.diffuseMap, fs_in.fragTexcoord) : vec4(material.diffuse, 1);
         LightingResult lighting = calculateDirectLighting(material, diffuseColor, eye, fs_in.fragPosition, normal);
 
         vec3 diffuseLighting = enableDiffuse ? lighting.diffuse : vec3(0);
@@ -491,8 +501,8 @@ void main() {
 
             if (enableReflections) {
                 float coneAngle = vctSpecularConeAngle;
-                if (vctSpecularConeAngleFromRoughness && material.hasRoughnessMap) {
-                    float roughness = texture(roughnessMap, fs_in.fragTexcoord).r;
+                if (vctSpecularConeAngleFromRoughness && hasMap(material.roughnessMap)) {
+                    float roughness = sampleMap(material.roughnessMap, fs_in.fragTexcoord).r;
                     coneAngle = roughness * PI * 0.1;
                 }
                 vec4 reflectColor = traceCone(
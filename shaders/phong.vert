@@ -1,27 +1,16 @@
-#version 330 core
+#version 430 core
 
 #define NORMAL_MAP
 
-layout (location = 0) in vec3 position;
-layout (location = 1) in vec3 normal;
-layout (location = 2) in vec2 texcoord;
-#ifdef NORMAL_MAP
-layout (location = 3) in vec3 tangent;
-layout (location = 4) in vec3 bitangent;
-
-uniform vec3 lightPos;
-uniform vec3 eye;
-#endif
+#pragma include "vertex.glsl"
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
-uniform mat4 ls;
+#pragma include "frame.glsl"
 
 out VS_OUT {
     vec3 fragPosition;
     vec3 fragNormal;
     vec2 fragTexcoord;
+    flat uint material;
 
     vec4 lightFragPos;
 
@@ -34,19 +23,27 @@ out VS_OUT {
 } vs_out;
 
 void main() {
+    DrawData draw = draws[drawID];
+    MeshVertex vertex = fetchVertex(gl_VertexID, draw);
+    mat4 model = draw.model;
+    vec3 position = vertex.position;
+    vec3 normal = vertex.normal;
+    vec2 texcoord = vertex.texcoord;
+
     mat3 normalMatrix = mat3(transpose(inverse(model)));
 
     vs_out.fragPosition = vec3(model * vec4(position, 1));
     vs_out.fragNormal = normalMatrix * normal;
     vs_out.fragTexcoord = texcoord;
+    vs_out.material = draw.material;
     gl_Position = projection * view * model * vec4(position, 1);
 
     vs_out.lightFragPos = ls * model * vec4(position, 1);
 
 #ifdef NORMAL_MAP
     // https://learnopengl.com/Advanced-Lighting/Normal-Mapping
-    vec3 T = normalMatrix * tangent;
-    vec3 B = normalMatrix * bitangent;
+    vec3 T = normalMatrix * vertex.tangent;
+    vec3 B = normalMatrix * vertex.bitangent;
     vec3 N = normalMatrix * normal;
     // re-orthogonalize
     T = normalize(T - dot(T, N) * N);
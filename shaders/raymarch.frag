@@ -9,7 +9,6 @@ layout(binding = 1) uniform sampler3D voxelNormal;
 layout(binding = 2) uniform sampler3D voxelRadiance;
 layout(binding = 10) uniform sampler3D warpmap;
 
-uniform vec3 eye = vec3(0);
 uniform vec3 viewForward = vec3(0, 0, -1);
 uniform vec3 viewRight = vec3(1, 0, 0);
 uniform vec3 viewUp = vec3(0, 1, 0);
@@ -18,16 +17,7 @@ uniform int width = 1280, height = 720;
 
 uniform float near = 0.1, far = 100.0;
 
-uniform int voxelDim = 128;
-uniform vec3 voxelMin, voxelMax;
-uniform vec3 voxelCenter;
-uniform bool warpVoxels;
-uniform bool warpTexture;
-
-uniform float lod = 0.0;
-
-uniform bool radiance = true;
-
+#pragma include "frame.glsl"
 #pragma include "common.glsl"
 
 void main() {
@@ -41,7 +31,7 @@ void main() {
     float stepSize = linearVoxelSize(voxelDim, voxelMin, voxelMax).x;
     while (value.a < 1 && scale < far) {
         vec3 voxelCoords = voxelIndex(rayStart + scale * rayDir, voxelDim, voxelCenter, voxelMin, voxelMax, warpVoxels) / float(voxelDim);
-        vec4 sampleColor = textureLod(radiance ? voxelRadiance : voxelColor, voxelCoords, lod);
+        vec4 sampleColor = textureLod(radiance ? voxelRadiance : voxelColor, cascadeTexcoord(voxelCoords, 0, miplevel), miplevel);
         float alpha = 1 - value.a;
         value.rgb += sampleColor.rgb * alpha;
         value.a += sampleColor.a * alpha;
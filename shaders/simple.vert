@@ -1,22 +1,28 @@
-#version 330 core
+#version 430 core
 
-layout (location = 0) in vec3 position;
-layout (location = 1) in vec3 normal;
-layout (location = 2) in vec2 texcoord;
+#pragma include "vertex.glsl"
 
 uniform mat4 projection;
 uniform mat4 view;
-uniform mat4 model;
 
 out vec3 fragPosition;
 out vec3 fragNormal;
 out vec2 fragTexcoord;
+flat out uint fragMaterial;
 
 void main() {
+    DrawData draw = draws[drawID];
+    MeshVertex vertex = fetchVertex(gl_VertexID, draw);
+    mat4 model = draw.model;
+    vec3 position = vertex.position;
+    vec3 normal = vertex.normal;
+    vec2 texcoord = vertex.texcoord;
+
     mat3 normalMatrix = mat3(transpose(inverse(model)));
 
     fragPosition = vec3(model * vec4(position, 1));
     fragNormal = normalMatrix * normal;
     fragTexcoord = texcoord;
+    fragMaterial = draw.material;
     gl_Position = projection * view * model * vec4(position, 1);
 }
@@ -0,0 +1,74 @@
+// Programmable vertex pulling from the GeometryArena vertex buffer (see Mesh::uploadVertices).
+// Full vertices are 14 floats: position, normal, texcoord, tangent, bitangent.
+// Compact vertices are 5 words:
+//   0: position.xy    unorm16 relative to the mesh bounds
+//   1: position.z     unorm16, bit 16 set if the bitangent is -cross(normal, tangent)
+//   2: normal         octahedral snorm16
+//   3: tangent        octahedral snorm16
+//   4: texcoord       half float
+
+// Index of the draw in DrawBlock, sourced from the baseInstance of the indirect command (see GeometryArena::bind)
+layout(location = 0) in uint drawID;
+
+struct DrawData {
+    mat4 model;
+    vec3 vertexMin;
+    uint material;
+    vec3 vertexExtent;
+    uint compactVertices;
+};
+
+layout(std430, binding = 5) readonly buffer VertexBlock {
+    uint vertexData[];
+};
+
+layout(std430, binding = 6) readonly buffer DrawBlock {
+    DrawData draws[];
+};
+
+struct MeshVertex {
+    vec3 position;
+    vec3 normal;
+    vec2 texcoord;
+    vec3 tangent;
+    vec3 bitangent;
+};
+
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0) {
+        vec2 s = vec2(n.x >= 0 ? 1.0 : -1.0, n.y >= 0 ? 1.0 : -1.0);
+        n.xy = (1.0 - abs(n.yx)) * s;
+    }
+    return normalize(n);
+}
+
+vec3 fetchVec3(uint base) {
+    return uintBitsToFloat(uvec3(vertexData[base], vertexData[base + 1], vertexData[base + 2]));
+}
+
+MeshVertex fetchVertex(int index, DrawData draw) {
+    MeshVertex v;
+
+    if (draw.compactVertices != 0) {
+        uint base = uint(index) * 5;
+        uint positionZ = vertexData[base + 1];
+
+        vec3 position = vec3(unpackUnorm2x16(vertexData[base]), float(positionZ & 0xffff) / 65535.0);
+        v.position = draw.vertexMin + position * draw.vertexExtent;
+        v.normal = decodeOctahedral(unpackSnorm2x16(vertexData[base + 2]));
+        v.tangent = decodeOctahedral(unpackSnorm2x16(vertexData[base + 3]));
+        v.texcoord = unpackHalf2x16(vertexData[base + 4]);
+        v.bitangent = ((positionZ & 0x10000) != 0 ? -1.0 : 1.0) * cross(v.normal, v.tangent);
+    }
+    else {
+        uint base = uint(index) * 14;
+        v.position = fetchVec3(base);
+        v.normal = fetchVec3(base + 3);
+        v.texcoord = uintBitsToFloat(uvec2(vertexData[base + 6], vertexData[base + 7]));
+        v.tangent = fetchVec3(base + 8);
+        v.bitangent = fetchVec3(base + 11);
+    }
+
+    return v;
+}
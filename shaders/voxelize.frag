@@ -1,5 +1,7 @@
 #version 430 core
 
+#pragma include "material.glsl"
+
 #pragma include "use_rgba16f.glsl"
 
 #if USE_RGBA16F
@@ -24,30 +26,11 @@ in GS_OUT {
     vec3 normal;
     vec2 texcoord;
     flat int axis;
+    flat uint material;
 } fs_in;
 
-#define POINT_LIGHT 0
-#define DIRECTIONAL_LIGHT 1
-struct Light {
-                        // base		offset
-    vec3 position;		// 16		0
-    vec3 direction;		// 16		16
-    vec3 color;			// 16		32
-
-    float range;		// 4		44
-    float intensity;	// 4		48
-
-    bool enabled;		// 4		52
-    bool selected;		// 4		56
-    bool shadowCaster;	// 4		60
-    uint type;			// 4		64
-};
-
-layout(std140, binding = 3) buffer LightBlock {
-    Light lights[];
-};
+#pragma include "light.glsl"
 
-layout(binding = 0) uniform sampler2D diffuseMap;
 layout(binding = 6) uniform sampler2D shadowmap;
 
 struct VoxelizeInfo {
@@ -58,16 +41,14 @@ layout(std140, binding = 4) buffer VoxelizeInfoBlock {
     VoxelizeInfo voxelizeInfo;
 };
 
+#pragma include "frame.glsl"
+#pragma include "octree.glsl"
+
 uniform bool voxelizeOccupancy = false;
-uniform bool voxelizeDilate = false;
-uniform bool warpVoxels;
-uniform bool warpTexture;
-uniform bool voxelizeAtomicMax = false;
-uniform bool voxelizeLighting;
-uniform bool voxelizeTesselationWarp;
-uniform vec3 eye;
-uniform vec3 voxelCenter, voxelMin, voxelMax;
-uniform mat4 ls;
+uniform bool voxelizeFragmentList = false;   // append to the octree's fragment list instead
+uniform int voxelCascade = 0;                   // written to its slice of the stacked textures
+uniform ivec3 voxelizeRegionMin = ivec3(0);     // voxels of the cascade being revoxelized
+uniform ivec3 voxelizeRegionMax = ivec3(0x7FFFFFFF);
 
 layout(binding = 10) uniform sampler3D warpmap;
 
@@ -97,10 +78,11 @@ vec3 getVoxelPosition(ivec3 size) {
     }
     unit.z = 1 - unit.z;
 
-    if (warpVoxels) {
+    // The octree isn't warped
+    if (warpVoxels && !voxelizeFragmentList) {
         unit = voxelWarp(unit, voxelLinearPosition(eye, voxelCenter, voxelMin, voxelMax));
     }
-    else if (warpTexture && !voxelizeOccupancy) {
+    else if (warpTexture && !voxelizeOccupancy && !voxelizeFragmentList) {
         unit = texture(warpmap, unit).xyz;
     }
 
@@ -192,9 +174,15 @@ void main() {
         return;
     }
 
+    vec3 voxelPosition = min(getVoxelPosition(ivec3(voxelDim)), vec3(voxelDim - 1));
+    if (any(lessThan(voxelPosition, vec3(voxelizeRegionMin))) || any(greaterThanEqual(voxelPosition, vec3(voxelizeRegionMax)))) {
+        return;
+    }
+
     atomicAdd(voxelizeInfo.totalVoxelFragments, 1);
 
-    vec3 color = texture(diffuseMap, fs_in.texcoord).rgb;
+    Material material = materials[fs_in.material];
+    vec3 color = hasMap(material.diffuseMap) ? sampleMap(material.diffuseMap, fs_in.texcoord).rgb : material.diffuse;
     vec3 normal = (normalize(fs_in.normal) + 1) * 0.5; // map normal [-1, 1] -> [0, 1]
 
     if (voxelizeLighting) {
@@ -224,8 +212,21 @@ void main() {
         color = clamp(finalLighting, 0, 1);
     }
 
+    if (voxelizeFragmentList) {
+        uvec3 voxel = uvec3(voxelPosition);
+        uint index = atomicAdd(octreeFragmentCount, 1);
+        if (index < uint(octreeFragments.length())) {
+            octreeFragments[index] = VoxelFragment(packVoxelPosition(voxel), packUnorm4x8(vec4(color, 1)), packUnorm4x8(vec4(normal, 1)));
+        }
+        return;
+    }
+
     // Store value (must be atomic, use alpha component as count)
-    vec3 voxelPosition = getVoxelPosition(imageSize(voxelColor));
+    // Wrap around the textures, into the cascade's slice
+    if (voxelToroidal) {
+        voxelPosition = mod(voxelPosition + vec3(voxelScroll[voxelCascade].xyz), float(voxelDim));
+    }
+    voxelPosition.z += float(voxelCascade * voxelDim);
     ivec3 voxelIndex = ivec3(voxelPosition);
     if (voxelizeDilate) {
         vec3 fractionalPosition = fract(voxelPosition);
@@ -1,18 +1,22 @@
 #version 430 core
 
-layout (location = 0) in vec3 vertPosition;
-layout (location = 1) in vec3 vertNormal;
-layout (location = 2) in vec2 vertTexcoord;
+#pragma include "vertex.glsl"
 
 out VS_OUT {
     vec3 position;
     vec3 normal;
     vec2 texcoord;
+    flat uint material;
 } vs_out;
 
-uniform mat4 model;
-
 void main() {
+    DrawData draw = draws[drawID];
+    MeshVertex vertex = fetchVertex(gl_VertexID, draw);
+    mat4 model = draw.model;
+    vec3 vertPosition = vertex.position;
+    vec3 vertNormal = vertex.normal;
+    vec2 vertTexcoord = vertex.texcoord;
+
     gl_Position = model * vec4(vertPosition, 1.0);
 
     mat3 normalMatrix = mat3(transpose(inverse(model)));
@@ -20,4 +24,5 @@ void main() {
     vs_out.position = vec3(gl_Position);
     vs_out.normal = normalMatrix * vertNormal;
     vs_out.texcoord = vertTexcoord;
+    vs_out.material = draw.material;
 }
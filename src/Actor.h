@@ -7,11 +7,11 @@
 #include <iostream>
 
 #include "ResourceLoader.h"
+#include "Graphics/DrawList.h"
 #include "Graphics/Mesh.h"
 #include "Transform.h"
 #include "log.h"
 
-class GLShaderProgram;
 class Actor;
 
 class ActorController {
@@ -22,12 +22,15 @@ public:
 class Actor {
 public:
     virtual void update(float dt) { if (controller) controller->update(*this, dt); }
-    virtual void draw(GLShaderProgram &program, GLenum mode = GL_TRIANGLES) const {}
+    virtual void addDraws(DrawList &drawList) {}
 
     const glm::mat4 &getTransform() { return transform.getMatrix(); }
 
     ActorController *controller = nullptr;
 
+    // Moves or changes, so it's voxelized every frame rather than into the static volume
+    bool dynamic = false;
+
     Transform transform;
 };
 
@@ -35,7 +38,7 @@ class StaticMeshActor : public Actor {
 public:
     StaticMeshActor(const std::string &meshname) : Actor(), mesh(ResourceLoader::loadMesh(meshname)) {}
 
-    void draw(GLShaderProgram &program, GLenum mode = GL_TRIANGLES) const override { mesh->draw(program, mode); }
+    void addDraws(DrawList &drawList) override { drawList.addMesh(*mesh, getTransform(), dynamic); }
 
     MeshResource mesh;
 };
@@ -10,13 +10,16 @@
 #include <glm/gtx/string_cast.hpp>
 
 #include <iostream>
+#include <limits>
 #include <vector>
 #include <memory>
+#include <random>
 
 #include "Graphics/GLHelper.h"
 #include "Graphics/GLShaderProgram.h"
 #include "Graphics/GLQuad.h"
 #include "Graphics/GLTimer.h"
+#include "Graphics/TextureStreamer.h"
 
 #include "Input/Keyboard.h"
 #include "Input/Mouse.h"
@@ -69,26 +72,40 @@ void Application::init() {
     }
     shadowmapFBO.unbind();
 
-    // Create shaders
-    program.attachAndLink({SHADER_DIR "phong.vert", SHADER_DIR "phong.frag"});
-    program.setObjectLabel("Phong");
-    voxelProgram.attachAndLink({SHADER_DIR "voxelize.vert", SHADER_DIR "voxelize.frag", SHADER_DIR "voxelize.geom"});
-    voxelProgram.setObjectLabel("Voxelize");
+    // Create shaders, compiled in parallel while the scene loads
+    programs.add(program, "Phong", {SHADER_DIR "phong.vert", SHADER_DIR "phong.frag"});
+    programs.add(voxelProgram, "Voxelize", {SHADER_DIR "voxelize.vert", SHADER_DIR "voxelize.frag", SHADER_DIR "voxelize.geom"});
 #if RSM
-    shadowmapProgram.attachAndLink({SHADER_DIR "simple.vert", SHADER_DIR "reflectiveShadowMap.frag"});
-    shadowmapProgram.setObjectLabel("RSM");
+    programs.add(shadowmapProgram, "RSM", {SHADER_DIR "simple.vert", SHADER_DIR "reflectiveShadowMap.frag"});
 #else
-    shadowmapProgram.attachAndLink({SHADER_DIR "simple.vert", SHADER_DIR "empty.frag"});
-    shadowmapProgram.setObjectLabel("Shadowmap");
+    programs.add(shadowmapProgram, "Shadowmap", {SHADER_DIR "simple.vert", SHADER_DIR "empty.frag"});
 #endif
-    injectRadianceProgram.attachAndLink({SHADER_DIR "injectRadiance.comp"});
-    injectRadianceProgram.setObjectLabel("Inject Radiance");
-    temporalRadianceFilterProgram.attachAndLink({SHADER_DIR "temporalRadianceFilter.comp"});
-    temporalRadianceFilterProgram.setObjectLabel("Temporal Radiance Filter");
-    mipmapProgram.attachAndLink({SHADER_DIR "filterRadiance.comp"});
-    mipmapProgram.setObjectLabel("Filter Radiance");
-    ditherProgram.attachAndLink({SHADER_DIR "simple.vert", SHADER_DIR "dither.frag"});
-    ditherProgram.setObjectLabel("Dither");
+    programs.add(injectRadianceProgram, "Inject Radiance", {SHADER_DIR "injectRadiance.comp"});
+    programs.add(temporalRadianceFilterProgram, "Temporal Radiance Filter", {SHADER_DIR "temporalRadianceFilter.comp"});
+    programs.add(mipmapProgram, "Filter Radiance", {SHADER_DIR "filterRadiance.comp"});
+    programs.add(ditherProgram, "Dither", {SHADER_DIR "simple.vert", SHADER_DIR "dither.frag"});
+    programs.add(generateWarpmapProgram, "Generate Warpmap", {SHADER_DIR "quad.vert", SHADER_DIR "generateWarpmap.geom", SHADER_DIR "generateWarpmap.frag"});
+    programs.add(warpWeightsProgram, "Generate Warp Weights", {SHADER_DIR "quad.vert", SHADER_DIR "generateWarpmap.geom", SHADER_DIR "generateWarpmapWeights.frag"});
+    programs.add(transferVoxelsProgram, "Transfer Voxels", {SHADER_DIR "transferVoxels.comp"});
+
+    // Passes using these skip or fall back until they are ready
+    programs.add(blurProgram, "Blur Shader", {SHADER_DIR "gaussianBlur.comp"}, ProgramRegistry::OPTIONAL);
+    programs.add(voxelizeTesselationProgram, "Voxelize Tesselation", {
+        SHADER_DIR "simpleTesselated.vert",
+        SHADER_DIR "testTesselation.tesc",
+        SHADER_DIR "testTesselation.tese"
+    }, ProgramRegistry::OPTIONAL);
+    programs.add(voxelizeTesselationDebugProgram, "Voxelize Tesselation Debug", {
+        SHADER_DIR "simpleTesselated.vert",
+        SHADER_DIR "testTesselation.tesc",
+        SHADER_DIR "testTesselation.tese",
+        SHADER_DIR "debugVoxelsTesselated.geom",
+        SHADER_DIR "debugVoxels.frag"
+    }, ProgramRegistry::OPTIONAL);
+    programs.add(fillHolesProgram, "Voxel Fill Holes", {SHADER_DIR "voxelFillHoles.comp"}, ProgramRegistry::OPTIONAL);
+    programs.add(debugVoxelsProgram, "Debug Voxels", {SHADER_DIR "debugVoxels.vert", SHADER_DIR "debugVoxels.geom", SHADER_DIR "debugVoxels.frag"}, ProgramRegistry::OPTIONAL);
+    occlusionCulling.addPrograms(programs);
+    octree.addPrograms(programs);
 
     // Create scene
     scene = std::make_unique<Scene>();
@@ -99,6 +116,7 @@ void Application::init() {
     scene->addActor(std::make_shared<StaticMeshActor>(sponza));
 
     // nanosuit.transform.setScale(glm::vec3(0.25f));
+    // nanosuit.dynamic = true;
     // nanosuit.controller = new LambdaActorController([](Actor &actor, float dt, float time) {
     // 	const float speedMultiplier = 1.0f;
     // 	// actor.transform.setPosition(actor.transform.getPosition() + glm::vec3(0.0f, glm::sin(time), 0.0f));
@@ -110,6 +128,7 @@ void Application::init() {
 
     // StaticMeshActor nanosuit2 {RESOURCE_DIR "nanosuit/nanosuit.obj"};
     // nanosuit2.transform.setScale(glm::vec3(0.2f));
+    // nanosuit2.dynamic = true;
     // nanosuit2.controller = new LambdaActorController([](Actor &actor, float dt, float time) {
     // 	actor.transform.setPosition(glm::vec3(2 * glm::sin(0.4 * time) - 2, 4.2f, 3.0f));
     // });
@@ -117,6 +136,7 @@ void Application::init() {
 
     // StaticMeshActor cube {RESOURCE_DIR "cube.obj"};
     // cube.transform.setScale(glm::vec3(0.5f));
+    // cube.dynamic = true;
     // cube.controller = new LambdaActorController([](Actor &actor, float dt, float time) {
     // 	actor.transform.setPosition(glm::vec3(2 * glm::sin(0.4 * time) + 2, 5.0f, 3.0f));
     // });
@@ -183,17 +203,352 @@ void Application::update(float dt) {
     if (GLFW_CURSOR_DISABLED == glfwGetInputMode(window, GLFW_CURSOR)) {
         camera.update(dt);
     }
+    else if (Mouse::getMouseButtonClick(GLFW_MOUSE_BUTTON_MIDDLE)) {
+        // Pick the actor under the cursor
+        const glm::mat4 projection = glm::perspective(camera.fov, (float)width / height, near, far);
+        const glm::vec4 viewport(0.0f, 0.0f, width, height);
+        glm::vec3 cursor(Mouse::getX(), height - Mouse::getY(), 0.0f);
+        glm::vec3 nearPoint = glm::unProject(cursor, camera.lookAt(), projection, viewport);
+        cursor.z = 1.0f;
+        glm::vec3 farPoint = glm::unProject(cursor, camera.lookAt(), projection, viewport);
+
+        float distance = 0.0f;
+        pickedActor = scene->raycast(nearPoint, farPoint - nearPoint, 1.0f, distance);
+        pickedDistance = distance * glm::length(farPoint - nearPoint);
+    }
 
     if (settings.voxelTrackCamera) {
-        // To prevent temporal artifacts, the voxel textures are 'snapped' to a discrete grid
-        glm::vec3 gridcell = glm::pow(2.f, (float)vct.voxelLevels) * (vct.max - vct.min) / (float)vct.voxelDim;
+        // To prevent temporal artifacts, the voxel textures are 'snapped' to a discrete grid, that of the
+        // coarsest cascade
+        glm::vec3 gridcell = glm::pow(2.f, (float)vct.voxelLevels) * vct.cascadeScale(vct.voxelCascades - 1) * (vct.max - vct.min) / (float)vct.voxelDim;
         vct.center = glm::floor(camera.position / gridcell) * gridcell;
     }
 
+    TextureStreamer::getInstance().update();
+
+    updateStressLights();
+
     scene->update(dt);
 }
 
+void Application::shutdown() {
+    TextureStreamer::getInstance().shutdown();
+}
+
+// Adds or removes the light stress test's point lights when its settings change
+void Application::updateStressLights() {
+    size_t count = settings.lightStressTest ? std::max(settings.lightStressCount, 0) : 0;
+    if (count == stressLightCount) {
+        return;
+    }
+
+    scene->removeLights(stressLightCount);
+
+    // Fixed seed, so timings are comparable between runs
+    std::mt19937 rng(1337);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (size_t i = 0; i < count; i++) {
+        Light light;
+        light.type = Light::Type::Point;
+        light.position = vct.min + glm::vec3(unit(rng), unit(rng), unit(rng)) * (vct.max - vct.min);
+        light.color = glm::vec3(unit(rng), unit(rng), unit(rng));
+        light.range = 0.5f + 1.5f * unit(rng);
+        scene->addLight(light);
+    }
+
+    stressLightCount = count;
+}
+
+// Falls back to the dense volumes while the octree programs compile, or if they failed to
+bool Application::voxelOctree() const {
+    return settings.voxelOctree && octreeReady;
+}
+
+// Toroidal addressing needs the volume to move in whole cells of the coarsest mip, as voxelTrackCamera
+// snaps it. transferVoxels.comp normalizes RGBA16F voxels in place, so those are revoxelized every frame.
+bool Application::voxelToroidal() const {
+    return settings.voxelTrackCamera && settings.voxelScrolling && !voxelOctree() && !vct.useRGBA16f;
+}
+
+// The octree voxelizes into its fragment list, it has no volumes to keep
+bool Application::voxelStaticSplit() const {
+    return settings.voxelizeStaticSplit && !voxelOctree();
+}
+
+// Like toroidal addressing the voxels have to keep from frame to frame
+bool Application::voxelDirtyRegions() const {
+    return settings.voxelizeDirtyRegions && !voxelOctree() && !vct.useRGBA16f;
+}
+
+// Calls fn(offset, size) for the boxes of texels a box wraps around to in a volume of dim^3 texels
+template <typename F>
+static void forEachWrappedBox(const glm::ivec3 &min, const glm::ivec3 &max, const glm::ivec3 &scroll, int dim, F fn) {
+    glm::ivec3 starts[2], sizes[2];
+    int counts[3];
+    for (int axis = 0; axis < 3; axis++) {
+        int start = (min[axis] + scroll[axis]) % dim, size = max[axis] - min[axis];
+        starts[0][axis] = start;
+        sizes[0][axis] = std::min(size, dim - start);
+        starts[1][axis] = 0;
+        sizes[1][axis] = size - sizes[0][axis];
+        counts[axis] = sizes[1][axis] > 0 ? 2 : 1;
+    }
+
+    for (int i = 0; i < counts[0]; i++) {
+        for (int j = 0; j < counts[1]; j++) {
+            for (int k = 0; k < counts[2]; k++) {
+                fn(glm::ivec3(starts[i].x, starts[j].y, starts[k].z), glm::ivec3(sizes[i].x, sizes[j].y, sizes[k].z));
+            }
+        }
+    }
+}
+
+// Decides what this frame revoxelizes. With toroidal addressing that's only the voxels each cascade uncovered
+// since the last frame, as slabs along each axis that moved. With the static split and no scrolling it's
+// only the cascades that moved. With dirty regions it's also the boxes of the meshes that moved. Anything
+// else that changes the voxels, including meshes moving without dirty regions or the draws being rebuilt, and
+// moving a whole volume or more, revoxelizes everything.
+void Application::updateVoxelScroll(uint64_t features) {
+    const int dim = vct.voxelDim;
+    const bool toroidal = frameConstants.voxel.voxelToroidal;
+    const bool split = voxelStaticSplit();
+    const bool persistent = toroidal || split || voxelDirtyRegions();
+    const size_t staticChanges = scene->getDrawList().getStaticChanges();
+
+    // The meshes that moved in voxels that are kept, dynamic ones are voxelized every frame with the split.
+    // Past a few boxes revoxelizing everything is about as cheap.
+    const size_t maxDirtyBoxes = 32;
+    std::vector<DrawList::MovedBox> dirtyBoxes;
+    for (const DrawList::MovedBox &box : scene->getDirtyBoxes()) {
+        if (!(split && box.dynamic)) {
+            dirtyBoxes.push_back(box);
+        }
+    }
+    scene->clearDirtyBoxes();
+    const bool dirty = voxelDirtyRegions() && dirtyBoxes.size() <= maxDirtyBoxes;
+
+    // Lighting and the warpmap change with the light and camera, voxels they shaped don't keep
+    const bool full = !persistent || !vct.scrollValid || settings.voxelizeLighting
+                   || frameConstants.voxel.warpVoxels || frameConstants.voxel.warpTexture
+                   || features != scrollFeatures
+                   || settings.conservativeRasterization != scrollRasterization
+                   || settings.voxelizeMultiplier != scrollMultiplier
+                   || staticChanges != scrollStaticChanges
+                   || (!dirtyBoxes.empty() && !dirty);
+
+    voxelRegions.clear();
+    for (int cascade = 0; cascade < frameConstants.voxel.voxelCascades; cascade++) {
+        const glm::ivec3 origin = vct.cascadeOrigin(cascade);
+        const glm::ivec3 shift = origin - vct.scrollOrigin[cascade];
+        vct.scrollOrigin[cascade] = origin;
+
+        if (full || (!toroidal && shift != glm::ivec3(0))) {
+            voxelRegions.push_back({ cascade, glm::ivec3(0), glm::ivec3(dim) });
+            continue;
+        }
+
+        // What's left once the slabs of the previous axes are taken, so the slabs don't overlap
+        glm::ivec3 min(0), max(dim);
+        for (int axis = 0; axis < 3 && min[axis] < max[axis]; axis++) {
+            const int k = shift[axis];
+            if (k == 0) {
+                continue;
+            }
+            if (std::abs(k) >= dim) {
+                voxelRegions.push_back({ cascade, min, max });
+                break;
+            }
+
+            VoxelRegion slab { cascade, min, max };
+            if (k > 0) {
+                slab.min[axis] = dim - k;
+                max[axis] = dim - k;
+            }
+            else {
+                slab.max[axis] = -k;
+                min[axis] = -k;
+            }
+            voxelRegions.push_back(slab);
+        }
+
+        if (!dirty) {
+            continue;
+        }
+        const glm::vec3 voxelSize = vct.voxelWorldSize() * vct.cascadeScale(cascade);
+        for (const DrawList::MovedBox &box : dirtyBoxes) {
+            // A voxel of margin for conservative rasterization and the volume not starting on a voxel
+            VoxelRegion region { cascade, glm::ivec3(glm::floor(box.min / voxelSize)) - origin - 1, glm::ivec3(glm::ceil(box.max / voxelSize)) - origin + 1 };
+            region.min = glm::clamp(region.min, 0, dim);
+            region.max = glm::clamp(region.max, 0, dim);
+            if (glm::all(glm::lessThan(region.min, region.max))) {
+                addVoxelRegion(region);
+            }
+        }
+    }
+
+    vct.scrollValid = persistent;
+    scrollStaticChanges = staticChanges;
+    scrollFeatures = features;
+    scrollRasterization = settings.conservativeRasterization;
+    scrollMultiplier = settings.voxelizeMultiplier;
+}
+
+// Adds a region merged with those it overlaps, so no voxel is voxelized twice
+void Application::addVoxelRegion(VoxelRegion region) {
+    for (size_t i = 0; i < voxelRegions.size();) {
+        const VoxelRegion &other = voxelRegions[i];
+        if (other.cascade == region.cascade && glm::all(glm::lessThan(region.min, other.max)) && glm::all(glm::lessThan(other.min, region.max))) {
+            region.min = glm::min(region.min, other.min);
+            region.max = glm::max(region.max, other.max);
+            voxelRegions.erase(voxelRegions.begin() + i);
+            // The grown region may overlap ones checked already
+            i = 0;
+        }
+        else {
+            i++;
+        }
+    }
+    voxelRegions.push_back(region);
+}
+
+void Application::clearVoxelRegion(const VoxelRegion &region, GLuint color, GLuint normal) {
+    const int dim = vct.voxelDim;
+    const glm::ivec3 scroll = glm::ivec3(frameConstants.voxel.voxelScroll[region.cascade]);
+    forEachWrappedBox(region.min, region.max, scroll, dim, [&](const glm::ivec3 &offset, const glm::ivec3 &size) {
+        for (GLuint texture : { color, normal }) {
+            glClearTexSubImage(texture, 0, offset.x, offset.y, offset.z + region.cascade * dim, size.x, size.y, size.z, GL_RGBA, GL_FLOAT, nullptr);
+        }
+    });
+}
+
+// Refilters the mips of a texture over a region, expects mipmapProgram bound
+void Application::filterVoxelRegion(GLuint texture, const VoxelRegion &region) {
+    const int local_size = 8;
+    const glm::ivec3 scroll = glm::ivec3(frameConstants.voxel.voxelScroll[region.cascade]);
+
+    for (int level = 0; level + 1 < vct.voxelLevels; level++) {
+        const int shift = level + 1, dim = vct.voxelDim >> shift;
+
+        glBindImageTexture(0, texture, level, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA8);
+        glBindImageTexture(1, texture, level + 1, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+        // Texels of the level touched by the region, the scroll is a multiple of the coarsest texel
+        const glm::ivec3 min = region.min >> shift, max = (region.max + (1 << shift) - 1) >> shift;
+        forEachWrappedBox(min, max, scroll >> shift, dim, [&](const glm::ivec3 &offset, const glm::ivec3 &size) {
+            mipmapProgram.setUniform3iv("dstOffset", offset + glm::ivec3(0, 0, region.cascade * dim));
+            glDispatchCompute((size.x + local_size - 1) / local_size, (size.y + local_size - 1) / local_size, (size.z + local_size - 1) / local_size);
+        });
+
+        glBindImageTexture(0, 0, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA8);
+        glBindImageTexture(1, 0, 1, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+}
+
+void Application::uploadFrameConstants(const glm::mat4 &projection, const glm::mat4 &view, const glm::mat4 &pv, const glm::mat4 &ls, const Light &mainlight) {
+    FrameConstants::FrameData &frame = frameConstants.frame;
+    frame.projection = projection;
+    frame.view = view;
+    frame.pv = pv;
+    frame.ls = ls;
+    frame.lsInverse = glm::inverse(ls);
+    frame.eye = camera.position;
+    frame.lightPos = mainlight.position;
+    frame.lightInt = mainlight.color;
+
+    // Orthographic views of the voxel volume along each axis
+    FrameConstants::VoxelData &voxel = frameConstants.voxel;
+    glm::mat4 voxelProjection = glm::ortho(vct.min.x, vct.max.x, vct.min.y, vct.max.y, 0.0f, vct.max.z - vct.min.z);
+    voxel.mvp_x = voxelProjection * glm::lookAt(glm::vec3(vct.max.x, 0, 0) + vct.center, vct.center, glm::vec3(0, 1, 0));
+    voxel.mvp_y = voxelProjection * glm::lookAt(glm::vec3(0, vct.max.y, 0) + vct.center, vct.center, glm::vec3(0, 0, -1));
+    voxel.mvp_z = voxelProjection * glm::lookAt(glm::vec3(0, 0, vct.max.z) + vct.center, vct.center, glm::vec3(0, 1, 0));
+    voxel.voxelMin = vct.min;
+    voxel.voxelDim = vct.voxelDim;
+    voxel.voxelMax = vct.max;
+    voxel.voxelCenter = vct.center;
+    // The clipmap cascades and toroidal addressing aren't warped, the octree keeps a single volume
+    const bool clipmap = vct.voxelCascades > 1 && !voxelOctree();
+    const bool toroidal = voxelToroidal();
+    voxel.warpVoxels = settings.warpVoxels && !clipmap && !toroidal;
+    voxel.warpTexture = settings.warpTexture && !clipmap && !toroidal;
+    voxel.voxelizeTesselationWarp = settings.voxelizeTesselationWarp && !clipmap && !toroidal;
+    voxel.voxelCascades = clipmap ? vct.voxelCascades : 1;
+    voxel.voxelLevels = vct.voxelLevels;
+    voxel.voxelToroidal = toroidal;
+    for (int cascade = 0; cascade < VCT::MAX_CASCADES; cascade++) {
+        voxel.voxelScroll[cascade] = glm::ivec4(toroidal ? vct.cascadeScroll(cascade) : glm::ivec3(0), 0);
+    }
+
+    FrameConstants::SettingsData &s = frameConstants.settings;
+    s.voxelize = settings.drawVoxels;
+    s.normals = settings.drawNormals;
+    s.dominant_axis = settings.drawDominantAxis;
+    s.radiance = settings.drawRadiance;
+    s.drawWarpSlope = settings.drawWarpSlope;
+    s.drawOcclusion = settings.drawOcclusion;
+    s.debugOcclusion = settings.debugOcclusion;
+    s.debugIndirect = settings.debugIndirect;
+    s.debugReflections = settings.debugReflections;
+    s.debugMaterialDiffuse = settings.debugMaterialDiffuse;
+    s.debugMaterialRoughness = settings.debugMaterialRoughness;
+    s.debugMaterialMetallic = settings.debugMaterialMetallic;
+    s.debugWarpTexture = settings.debugWarpTexture;
+    s.toggle = settings.toggle;
+
+    s.cooktorrance = settings.cooktorrance;
+    s.clusteredLighting = settings.clusteredLighting;
+    s.enablePostprocess = settings.enablePostprocess;
+    s.enableShadows = settings.enableShadows;
+    s.enableNormalMap = settings.enableNormalMap;
+    s.enableIndirect = settings.enableIndirect;
+    s.enableDiffuse = settings.enableDiffuse;
+    s.enableSpecular = settings.enableSpecular;
+    s.enableReflections = settings.enableReflections;
+    s.ambientScale = settings.ambientScale;
+    s.reflectScale = settings.reflectScale;
+    s.miplevel = settings.miplevel;
+
+    s.vctSteps = settings.diffuseConeSettings.steps;
+    s.vctConeAngle = settings.diffuseConeSettings.coneAngle;
+    s.vctBias = settings.diffuseConeSettings.bias;
+    s.vctConeInitialHeight = settings.diffuseConeSettings.coneInitialHeight;
+    s.vctLodOffset = settings.diffuseConeSettings.lodOffset;
+    s.vctSpecularSteps = settings.specularConeSettings.steps;
+    s.vctSpecularConeAngle = settings.specularConeSettings.coneAngle;
+    s.vctSpecularBias = settings.specularConeSettings.bias;
+    s.vctSpecularConeInitialHeight = settings.specularConeSettings.coneInitialHeight;
+    s.vctSpecularLodOffset = settings.specularConeSettings.lodOffset;
+    s.vctSpecularConeAngleFromRoughness = settings.specularConeAngleFromRoughness;
+
+    s.axis_override = settings.axisOverride;
+    s.voxelizeDilate = settings.voxelizeDilate;
+    s.voxelizeAtomicMax = settings.voxelizeAtomicMax;
+    s.voxelizeLighting = settings.voxelizeLighting;
+
+    s.radianceLighting = settings.radianceLighting;
+    s.radianceDilate = settings.radianceDilate;
+    s.temporalFilterRadiance = settings.temporalFilterRadiance;
+    s.temporalDecay = settings.temporalDecay;
+    s.voxelSetOpacity = settings.voxelSetOpacity;
+    s.voxelOctree = voxelOctree();
+
+    frameConstants.upload();
+}
+
 void Application::render(float dt) {
+    programs.update();
+    octreeReady = octree.isReady();
+    occlusionCullingReady = occlusionCulling.isReady();
+    if (!programs.requiredReady()) {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        GL_DEBUG_PUSH("Render Overlay")
+        ui.render(dt);
+        GL_DEBUG_POP()
+        return;
+    }
+
     totalTimer.start();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -209,6 +564,34 @@ void Application::render(float dt) {
     const glm::mat4 lv = glm::lookAt(mainlight.position, mainlight.position + mainlight.direction, glm::vec3(0.0f, 1.0f, 0.0f));
     const glm::mat4 ls = lp * lv;
 
+    uploadFrameConstants(projection, view, pv, ls, mainlight);
+
+    const uint64_t features = ProgramVariants::features(frameConstants);
+    GLShaderProgram &phongProgram = phongVariants.select(features);
+    GLShaderProgram &voxelizeProgram = voxelizeVariants.select(features);
+    GLShaderProgram &transferProgram = transferVoxelsVariants.select(features);
+    GLShaderProgram &injectProgram = injectRadianceVariants.select(features);
+
+    // Each pass culls against its own volume
+    const Frustum cameraFrustum = Frustum::fromMatrix(projection * view);
+    const Frustum shadowFrustum = Frustum::fromMatrix(ls);
+    const Frustum voxelFrustum = Frustum::fromBox(vct.cascadeMin(0), vct.cascadeMax(0));
+    const int voxelCascades = frameConstants.voxel.voxelCascades;
+    const bool toroidal = frameConstants.voxel.voxelToroidal;
+    const bool split = voxelStaticSplit();
+    const bool dirtyRegions = voxelDirtyRegions();
+
+    if (split) {
+        vct.makeStatic();
+    }
+    else {
+        vct.deleteStatic();
+    }
+    updateVoxelScroll(features);
+    vct.setWrap(toroidal ? GL_REPEAT : GL_CLAMP_TO_BORDER);
+    const bool cull = settings.frustumCulling;
+    cullingInfo.total = scene->getDrawCount();
+
     // Generate shadowmap
     shadowmapTimer.start();
     {
@@ -223,7 +606,7 @@ void Application::render(float dt) {
         shadowmapProgram.setUniformMatrix4fv("projection", lp);
         shadowmapProgram.setUniformMatrix4fv("view", lv);
 
-        scene->draw(shadowmapProgram);
+        cullingInfo.shadowmap = scene->draw(shadowmapProgram, GL_TRIANGLES, cull ? &shadowFrustum : nullptr);
 
         shadowmapProgram.unbind();
         shadowmapFBO.unbind();
@@ -256,28 +639,16 @@ void Application::render(float dt) {
 
         glClearTexImage(vct.voxelOccupancy, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
 
-        glm::mat4 projection =
-            glm::ortho(vct.min.x, vct.max.x, vct.min.y, vct.max.y, 0.0f, vct.max.z - vct.min.z);
-        glm::mat4 mvp_x = projection * glm::lookAt(glm::vec3(vct.max.x, 0, 0) + vct.center,
-                                                   vct.center, glm::vec3(0, 1, 0));
-        glm::mat4 mvp_y = projection * glm::lookAt(glm::vec3(0, vct.max.y, 0) + vct.center,
-                                                   vct.center, glm::vec3(0, 0, -1));
-        glm::mat4 mvp_z = projection * glm::lookAt(glm::vec3(0, 0, vct.max.z) + vct.center,
-                                                   vct.center, glm::vec3(0, 1, 0));
-
-        voxelProgram.bind();
-        voxelProgram.setUniformMatrix4fv("mvp_x", mvp_x);
-        voxelProgram.setUniformMatrix4fv("mvp_y", mvp_y);
-        voxelProgram.setUniformMatrix4fv("mvp_z", mvp_z);
-
-        voxelProgram.setUniform1i("voxelizeOccupancy", GL_TRUE);
+        voxelizeProgram.bind();
+        voxelizeProgram.setUniform1i("voxelizeOccupancy", GL_TRUE);
+        voxelizeProgram.setUniform1i("voxelCascade", 0);
 
         glBindImageTexture(2, vct.voxelOccupancy, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
 
-        scene->draw(voxelProgram);
+        scene->draw(voxelizeProgram, GL_TRIANGLES, cull ? &voxelFrustum : nullptr);
 
         glBindImageTexture(2, 0, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
-        voxelProgram.unbind();
+        voxelizeProgram.unbind();
 
         // Restore OpenGL state
         glViewport(0, 0, width, height);
@@ -372,10 +743,6 @@ void Application::render(float dt) {
         GL_DEBUG_PUSH("Generate Warpmap")
 
         // Use layered rendering to generate the warpmap
-        static GLShaderProgram generateWarpmapShader{"Generate Warpmap",
-                                                     {SHADER_DIR "quad.vert",
-                                                      SHADER_DIR "generateWarpmap.geom",
-                                                      SHADER_DIR "generateWarpmap.frag"}};
         static GLuint warpmapFBO = 0;
         static GLuint warpTextureId, warpPartialsId, warpWeightsId;
         if (warpmapFBO == 0) {
@@ -429,9 +796,6 @@ void Application::render(float dt) {
         // Compute warpmap weights separately
         static GLuint warpmapWeightsLow = 0, warpmapWeightsHigh = 0;
         if (settings.useWarpmapWeightsTexture) {
-            static GLShaderProgram warpweightShader {"Generate Warp Weights", {SHADER_DIR "quad.vert",
-                                                          SHADER_DIR "generateWarpmap.geom",
-                                                          SHADER_DIR "generateWarpmapWeights.frag"}};
             static GLuint warpmapWeightsFBO = 0;
             if (warpmapWeightsFBO == 0) {
                 // Create 3D warpmap
@@ -467,35 +831,35 @@ void Application::render(float dt) {
             glViewport(0, 0, warpDim, warpDim);
             glDisable(GL_DEPTH_TEST);
             glDisable(GL_CULL_FACE);
-            warpweightShader.bind();
+            warpWeightsProgram.bind();
 
             // glBindImageTexture(0, vct.voxelOccupancy, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
             glBindImageTexture(0, warpTextureId, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
             glBindImageTexture(1, warpPartialsId, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA32I);
             glBindImageTexture(2, warpWeightsId, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
 
-            warpweightShader.setUniform1i("warpDim", warpDim);
-            warpweightShader.setUniform1f("maxWeight", settings.warpTextureHighResolution);
+            warpWeightsProgram.setUniform1i("warpDim", warpDim);
+            warpWeightsProgram.setUniform1f("maxWeight", settings.warpTextureHighResolution);
 
+            static CachedUniform weightsLayerOffset {"layerOffset"};
             const size_t layersPerRender = 32;
             for (size_t layerOffset = 0; layerOffset < warpDim; layerOffset += layersPerRender) {
-                warpweightShader.setUniform1i("layerOffset", layerOffset);
+                glUniform1i(weightsLayerOffset.get(warpWeightsProgram), layerOffset);
                 GLQuad::draw();
             }
 
             glBindImageTexture(0, 0, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
             glBindImageTexture(1, 0, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA32I);
             glBindImageTexture(2, 0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
-            warpweightShader.unbind();
+            warpWeightsProgram.unbind();
             glViewport(0, 0, width, height);
             glEnable(GL_DEPTH_TEST);
             glEnable(GL_CULL_FACE);
             glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
             // Apply Gaussian blur to the weights
-            if (settings.blurWarpmapWeights) {
+            if (settings.blurWarpmapWeights && blurProgram.isReady() && blurProgram.isLinked()) {
                 GL_DEBUG_PUSH("Blur Warpmap Weights")
-                static GLShaderProgram blurShader {"Blur Shader", {SHADER_DIR "gaussianBlur.comp"}};
 
                 static GLuint blurTemp = 0;
                 if (blurTemp == 0) {
@@ -511,9 +875,9 @@ void Application::render(float dt) {
 
                 GLuint num_groups = (warpDim + 8 - 1) / 8;
                 GLuint src = warpmapWeightsHigh, dst = blurTemp;
-                blurShader.bind();
+                blurProgram.bind();
                 for (size_t axis = 0; axis < 3; ++axis) {
-                    blurShader.setUniform1i("axis", axis);
+                    blurProgram.setUniform1i("axis", axis);
                     glBindImageTexture(0, src, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA16F);
                     glBindImageTexture(1, dst, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
 
@@ -526,7 +890,13 @@ void Application::render(float dt) {
                 }
                 glBindImageTexture(0, 0, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA16F);
                 glBindImageTexture(1, 0, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
-                blurShader.unbind();
+                blurProgram.unbind();
+
+                // An odd number of passes leaves the result in blurTemp
+                if (src != warpmapWeightsHigh) {
+                    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+                    glCopyImageSubData(src, GL_TEXTURE_3D, 0, 0, 0, 0, warpmapWeightsHigh, GL_TEXTURE_3D, 0, 0, 0, 0, warpDim, warpDim, warpDim);
+                }
 
                 GL_DEBUG_POP()
             }
@@ -536,7 +906,7 @@ void Application::render(float dt) {
         glViewport(0, 0, warpDim, warpDim);
         glDisable(GL_DEPTH_TEST);
         glDisable(GL_CULL_FACE);
-        generateWarpmapShader.bind();
+        generateWarpmapProgram.bind();
 
         // glBindImageTexture(0, vct.voxelOccupancy, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
         glBindImageTexture(0, warpTextureId, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
@@ -548,16 +918,17 @@ void Application::render(float dt) {
             glBindTextureUnit(1, warpmapWeightsHigh);
         }
 
-        generateWarpmapShader.setUniform1i("toggle", settings.toggle);
-        generateWarpmapShader.setUniform1i("warpTextureLinear", settings.warpTextureLinear);
-        glUniform3iv(generateWarpmapShader.uniformLocation("warpTextureAxes"), 1, settings.warpTextureAxes);
-        generateWarpmapShader.setUniform1i("warpDim", warpDim);
-        generateWarpmapShader.setUniform1i("useWarpmapWeightsTexture", settings.useWarpmapWeightsTexture);
-        generateWarpmapShader.setUniform1f("maxWeight", settings.warpTextureHighResolution);
+        generateWarpmapProgram.setUniform1i("toggle", settings.toggle);
+        generateWarpmapProgram.setUniform1i("warpTextureLinear", settings.warpTextureLinear);
+        glUniform3iv(generateWarpmapProgram.uniformLocation("warpTextureAxes"), 1, settings.warpTextureAxes);
+        generateWarpmapProgram.setUniform1i("warpDim", warpDim);
+        generateWarpmapProgram.setUniform1i("useWarpmapWeightsTexture", settings.useWarpmapWeightsTexture);
+        generateWarpmapProgram.setUniform1f("maxWeight", settings.warpTextureHighResolution);
 
+        static CachedUniform warpmapLayerOffset {"layerOffset"};
         const size_t layersPerRender = 32;
         for (size_t layerOffset = 0; layerOffset < warpDim; layerOffset += layersPerRender) {
-            generateWarpmapShader.setUniform1i("layerOffset", layerOffset);
+            glUniform1i(warpmapLayerOffset.get(generateWarpmapProgram), layerOffset);
         GLQuad::draw();
         }
 
@@ -568,7 +939,7 @@ void Application::render(float dt) {
             glBindTextureUnit(0, 0);
             glBindTextureUnit(1, 0);
         }
-        generateWarpmapShader.unbind();
+        generateWarpmapProgram.unbind();
         glViewport(0, 0, width, height);
         glEnable(GL_DEPTH_TEST);
         glEnable(GL_CULL_FACE);
@@ -582,29 +953,16 @@ void Application::render(float dt) {
 
     voxelizeTimer.start();
     // Voxelize scene
-    if (settings.voxelizeTesselation) {
+    // Falls back to the geometry shader voxelization while the tesselation programs compile, or if they failed
+    // to. Only the geometry shader voxelization writes the octree's fragment list, the clipmap cascades, toroidal
+    // addressing, the static volume and dirty regions.
+    const bool voxelizeTesselation = !voxelOctree() && voxelCascades == 1 && !toroidal && !split && !dirtyRegions && settings.voxelizeTesselation
+                                  && voxelizeTesselationProgram.isReady() && voxelizeTesselationProgram.isLinked()
+                                  && (!settings.voxelizeTesselationDebug || (voxelizeTesselationDebugProgram.isReady() && voxelizeTesselationDebugProgram.isLinked()));
+    if (voxelizeTesselation) {
         GL_DEBUG_PUSH("Voxelize Tesselation")
 
-        static GLShaderProgram voxelizeTesselationShader {
-            "Voxelize Tesselation",
-            {
-                SHADER_DIR "simpleTesselated.vert",
-                SHADER_DIR "testTesselation.tesc",
-                SHADER_DIR "testTesselation.tese"
-            }};
-        static GLShaderProgram voxelizeTesselationDebugShader{
-            "Voxelize Tesselation Debug",
-            {
-                // SHADER_DIR "quad.vert",
-                SHADER_DIR "simpleTesselated.vert",
-                SHADER_DIR "testTesselation.tesc",
-                SHADER_DIR "testTesselation.tese",
-                SHADER_DIR "debugVoxelsTesselated.geom",
-                SHADER_DIR "debugVoxels.frag"
-                // SHADER_DIR "testTesselation.frag"
-            }};
-
-        GLShaderProgram *shader = &voxelizeTesselationShader;
+        GLShaderProgram *shader = nullptr;
 
         if (settings.voxelizeTesselationDebug) {
 
@@ -613,7 +971,7 @@ void Application::render(float dt) {
             glEnable(GL_DEPTH_TEST);
             glEnable(GL_CULL_FACE);
 
-            shader = &voxelizeTesselationDebugShader;
+            shader = &voxelizeTesselationDebugProgram;
         }
         else {
 
@@ -621,7 +979,7 @@ void Application::render(float dt) {
             glDisable(GL_DEPTH_TEST);
             glDisable(GL_CULL_FACE);
 
-            shader = &voxelizeTesselationShader;
+            shader = &voxelizeTesselationVariants.select(features);
         }
 
         glClearTexImage(vct.voxelColor, 0, GL_RGBA, GL_FLOAT, nullptr);
@@ -629,21 +987,12 @@ void Application::render(float dt) {
 
         shader->bind();
 
-        shader->setUniformMatrix4fv("projection", projection);
-        shader->setUniformMatrix4fv("view", view);
-        shader->setUniform1i("voxelizeAtomicMax", settings.voxelizeAtomicMax);
-        shader->setUniform1i("voxelizeTesselationWarp", settings.voxelizeTesselationWarp);
-        shader->setUniform1f("voxelDim", vct.voxelDim);
-        shader->setUniform3fv("voxelMin", vct.min);
-        shader->setUniform3fv("voxelMax", vct.max);
-        shader->setUniform3fv("voxelCenter", vct.center);
-        shader->setUniformMatrix4fv("pv", pv);
-
         glBindImageTexture(0, vct.voxelColor, 0, GL_TRUE, 0, GL_READ_WRITE, vct.useRGBA16f ? GL_RGBA16F : GL_R32UI);
         glBindImageTexture(1, vct.voxelNormal, 0, GL_TRUE, 0, GL_READ_WRITE, vct.useRGBA16f ? GL_RGBA16F : GL_R32UI);
 
         // GLQuad::draw(GL_PATCHES);
-        scene->draw(*shader, GL_PATCHES);
+        cullingInfo.voxelize = scene->draw(*shader, GL_PATCHES, cull ? &voxelFrustum : nullptr);
+        cullingInfo.voxelizePasses = 1;
 
         glBindImageTexture(0, 0, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
         glBindImageTexture(1, 0, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
@@ -683,54 +1032,104 @@ void Application::render(float dt) {
                 break;
         }
 
-        glClearTexImage(vct.voxelColor, 0, GL_RGBA, GL_FLOAT, nullptr);
-        glClearTexImage(vct.voxelNormal, 0, GL_RGBA, GL_FLOAT, nullptr);
-
-        glm::mat4 projection = glm::ortho(vct.min.x, vct.max.x, vct.min.y, vct.max.y, 0.0f, vct.max.z - vct.min.z);
-        glm::mat4 mvp_x = projection * glm::lookAt(glm::vec3(vct.max.x, 0, 0) + vct.center, vct.center, glm::vec3(0, 1, 0));
-        glm::mat4 mvp_y = projection * glm::lookAt(glm::vec3(0, vct.max.y, 0) + vct.center, vct.center, glm::vec3(0, 0, -1));
-        glm::mat4 mvp_z = projection * glm::lookAt(glm::vec3(0, 0, vct.max.z) + vct.center, vct.center, glm::vec3(0, 1, 0));
-
-        voxelProgram.bind();
-        voxelProgram.setUniformMatrix4fv("mvp_x", mvp_x);
-        voxelProgram.setUniformMatrix4fv("mvp_y", mvp_y);
-        voxelProgram.setUniformMatrix4fv("mvp_z", mvp_z);
-
-        voxelProgram.setUniform1i("voxelizeOccupancy", GL_FALSE);
-
-        voxelProgram.setUniform1i("axis_override", settings.axisOverride);
-
-        voxelProgram.setUniform3fv("eye", camera.position);
-        voxelProgram.setUniform3fv("lightPos", mainlight.position);
-        voxelProgram.setUniform3fv("lightInt", mainlight.color);
-        voxelProgram.setUniform1i("voxelizeDilate", settings.voxelizeDilate);
-        voxelProgram.setUniform1i("warpVoxels", settings.warpVoxels);
-        voxelProgram.setUniform1i("warpTexture", settings.warpTexture);
-        voxelProgram.setUniform1i("voxelizeAtomicMax", settings.voxelizeAtomicMax);
-        voxelProgram.setUniform1i("toggle", settings.toggle);
-        voxelProgram.setUniform1i("voxelizeLighting", settings.voxelizeLighting);
-        voxelProgram.setUniform3fv("voxelMin", vct.min);
-        voxelProgram.setUniform3fv("voxelMax", vct.max);
-        voxelProgram.setUniform3fv("voxelCenter", vct.center);
+        if (voxelOctree()) {
+            octree.beginVoxelize();
+        }
+        else if (split) {
+            glClearTexImage(vct.voxelColor, 0, GL_RGBA, GL_FLOAT, nullptr);
+            glClearTexImage(vct.voxelNormal, 0, GL_RGBA, GL_FLOAT, nullptr);
+            for (const VoxelRegion &region : voxelRegions) {
+                clearVoxelRegion(region, vct.staticColor, vct.staticNormal);
+            }
+        }
+        else {
+            for (const VoxelRegion &region : voxelRegions) {
+                clearVoxelRegion(region, vct.voxelColor, vct.voxelNormal);
+            }
+        }
 
-        glBindImageTexture(0, vct.voxelColor, 0, GL_TRUE, 0, GL_READ_WRITE, vct.useRGBA16f ? GL_RGBA16F : GL_R32UI);
-        glBindImageTexture(1, vct.voxelNormal, 0, GL_TRUE, 0, GL_READ_WRITE, vct.useRGBA16f ? GL_RGBA16F : GL_R32UI);
+        voxelizeProgram.bind();
+        voxelizeProgram.setUniform1i("voxelizeOccupancy", GL_FALSE);
+        voxelizeProgram.setUniform1i("voxelizeFragmentList", voxelOctree());
 
         scene->bindLightSSBO(3);
-        voxelProgram.setUniformMatrix4fv("ls", ls);
 
         GLuint shadowmap = shadowmapFBO.getTexture(0);
         glBindTextureUnit(6, shadowmap);
 
         glBindTextureUnit(10, warpmap);
 
-        scene->draw(voxelProgram);
+        // Each cascade is drawn with the projection of cascade 0 scaled around the center, once per region
+        // with the draws culled to it, the projections scissored to it and fragments outside it dropped.
+        // Regions smaller than the cascade are always culled, they're revoxelized around few meshes.
+        const float viewportDim = settings.voxelizeMultiplier * vct.voxelDim;
+        const glm::mat4 *axisProjections[3] = { &frameConstants.voxel.mvp_x, &frameConstants.voxel.mvp_y, &frameConstants.voxel.mvp_z };
+        glEnable(GL_SCISSOR_TEST);
+        auto voxelizeRegion = [&](const VoxelRegion &region, DrawList::Subset subset) {
+            const float scale = vct.cascadeScale(region.cascade);
+            const glm::vec3 voxelSize = vct.voxelWorldSize() * scale;
+            const glm::vec3 origin = glm::vec3(vct.cascadeOrigin(region.cascade)) * voxelSize;
+            const glm::vec3 regionMin = origin + glm::vec3(region.min) * voxelSize, regionMax = origin + glm::vec3(region.max) * voxelSize;
+            const Frustum regionFrustum = Frustum::fromBox(regionMin, regionMax);
+            const bool partial = region.min != glm::ivec3(0) || region.max != glm::ivec3(vct.voxelDim);
+
+            // The geometry shader picks the viewport by projection axis, see voxelize.geom
+            const glm::vec3 scaledMin = vct.center + (regionMin - vct.center) / scale, scaledMax = vct.center + (regionMax - vct.center) / scale;
+            for (int axis = 0; axis < 3; axis++) {
+                glm::vec2 lo(std::numeric_limits<float>::max()), hi(std::numeric_limits<float>::lowest());
+                for (int corner = 0; corner < 8; corner++) {
+                    const glm::vec3 p((corner & 1) ? scaledMax.x : scaledMin.x, (corner & 2) ? scaledMax.y : scaledMin.y, (corner & 4) ? scaledMax.z : scaledMin.z);
+                    const glm::vec4 clip = *axisProjections[axis] * glm::vec4(p, 1.0f);
+                    const glm::vec2 window = (glm::vec2(clip.x, clip.y) * 0.5f + 0.5f) * viewportDim;
+                    lo = glm::min(lo, window);
+                    hi = glm::max(hi, window);
+                }
+                // A pixel of margin for conservative rasterization
+                const glm::ivec2 scissorMin = glm::max(glm::ivec2(glm::floor(lo)) - 1, 0);
+                const glm::ivec2 scissorMax = glm::min(glm::ivec2(glm::ceil(hi)) + 1, (int)viewportDim);
+                glScissorIndexed(axis, scissorMin.x, scissorMin.y, std::max(scissorMax.x - scissorMin.x, 0), std::max(scissorMax.y - scissorMin.y, 0));
+            }
+
+            voxelizeProgram.setUniform1i("voxelCascade", region.cascade);
+            voxelizeProgram.setUniform3iv("voxelizeRegionMin", region.min);
+            voxelizeProgram.setUniform3iv("voxelizeRegionMax", region.max);
+            cullingInfo.voxelize += scene->draw(voxelizeProgram, GL_TRIANGLES, cull || partial ? &regionFrustum : nullptr, subset);
+        };
+
+        cullingInfo.voxelize = 0;
+        cullingInfo.voxelizePasses = voxelRegions.size();
+        if (split) {
+            // Static actors into their volume over the regions that changed, dynamic ones over every cascade
+            glBindImageTexture(0, vct.staticColor, 0, GL_TRUE, 0, GL_READ_WRITE, vct.useRGBA16f ? GL_RGBA16F : GL_R32UI);
+            glBindImageTexture(1, vct.staticNormal, 0, GL_TRUE, 0, GL_READ_WRITE, vct.useRGBA16f ? GL_RGBA16F : GL_R32UI);
+            for (const VoxelRegion &region : voxelRegions) {
+                voxelizeRegion(region, DrawList::STATIC);
+            }
+
+            glBindImageTexture(0, vct.voxelColor, 0, GL_TRUE, 0, GL_READ_WRITE, vct.useRGBA16f ? GL_RGBA16F : GL_R32UI);
+            glBindImageTexture(1, vct.voxelNormal, 0, GL_TRUE, 0, GL_READ_WRITE, vct.useRGBA16f ? GL_RGBA16F : GL_R32UI);
+            for (int cascade = 0; cascade < voxelCascades; cascade++) {
+                voxelizeRegion({ cascade, glm::ivec3(0), glm::ivec3(vct.voxelDim) }, DrawList::DYNAMIC);
+            }
+            cullingInfo.voxelizePasses += voxelCascades;
+        }
+        else {
+            glBindImageTexture(0, vct.voxelColor, 0, GL_TRUE, 0, GL_READ_WRITE, vct.useRGBA16f ? GL_RGBA16F : GL_R32UI);
+            glBindImageTexture(1, vct.voxelNormal, 0, GL_TRUE, 0, GL_READ_WRITE, vct.useRGBA16f ? GL_RGBA16F : GL_R32UI);
+            for (const VoxelRegion &region : voxelRegions) {
+                voxelizeRegion(region, DrawList::ALL);
+            }
+        }
 
+        glDisable(GL_SCISSOR_TEST);
         glBindImageTexture(0, 0, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA16F);
         glBindImageTexture(1, 0, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA16F);
         glBindTextureUnit(6, 0);
         glBindTextureUnit(10, 0);
-        voxelProgram.unbind();
+        voxelizeProgram.unbind();
+        if (voxelOctree()) {
+            octree.endVoxelize();
+        }
 
         // Restore OpenGL state
         glViewport(0, 0, width, height);
@@ -754,10 +1153,16 @@ void Application::render(float dt) {
     }
     voxelizeTimer.stop();
 
-    {
-        GL_DEBUG_PUSH("Transfer Voxels")
+    octreeBuildTimer.start();
+    if (voxelOctree()) {
+        GL_DEBUG_PUSH("Build Octree")
+        octree.build(vct.voxelDim);
+        GL_DEBUG_POP()
+    }
+    octreeBuildTimer.stop();
 
-        static GLShaderProgram transferVoxels { "Transfer Voxels", {SHADER_DIR "transferVoxels.comp"}};
+    if (!voxelOctree()) {
+        GL_DEBUG_PUSH("Transfer Voxels")
 
         if (!settings.temporalFilterRadiance) {
             glClearTexImage(vct.voxelRadiance, 0, GL_RGBA, GL_FLOAT, nullptr);
@@ -765,33 +1170,44 @@ void Application::render(float dt) {
 
         glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 
-        transferVoxels.bind();
-        transferVoxels.setUniform1i("temporalFilter", settings.temporalFilterRadiance);
-        transferVoxels.setUniform1f("temporalDecay", settings.temporalDecay);
-        transferVoxels.setUniform1f("voxelSetOpacity", settings.voxelSetOpacity);
+        transferProgram.bind();
 
         glBindImageTexture(0, vct.voxelColor, 0, GL_TRUE, 0, GL_READ_WRITE, vct.voxelFormat);
         glBindImageTexture(1, vct.voxelNormal, 0, GL_TRUE, 0, GL_READ_WRITE, vct.voxelFormat);
         glBindImageTexture(2, vct.voxelRadiance, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
 
-        glDispatchCompute((vct.voxelDim + 8 - 1) / 8, (vct.voxelDim + 8 - 1) / 8, (vct.voxelDim + 8 - 1) / 8);
+        // Merges the static volume into the dynamic voxels
+        transferProgram.setUniform1i("mergeStatic", split);
+        if (split) {
+            glBindImageTexture(3, vct.staticColor, 0, GL_TRUE, 0, GL_READ_ONLY, vct.voxelFormat);
+            glBindImageTexture(4, vct.staticNormal, 0, GL_TRUE, 0, GL_READ_ONLY, vct.voxelFormat);
+        }
+
+        glDispatchCompute((vct.voxelDim + 8 - 1) / 8, (vct.voxelDim + 8 - 1) / 8, (vct.voxelDim * voxelCascades + 8 - 1) / 8);
 
         glBindImageTexture(0, 0, 0, GL_TRUE, 0, GL_READ_WRITE, vct.voxelFormat);
         glBindImageTexture(1, 0, 0, GL_TRUE, 0, GL_READ_WRITE, vct.voxelFormat);
         glBindImageTexture(2, 0, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
-        transferVoxels.unbind();
+        glBindImageTexture(3, 0, 0, GL_TRUE, 0, GL_READ_ONLY, vct.voxelFormat);
+        glBindImageTexture(4, 0, 0, GL_TRUE, 0, GL_READ_ONLY, vct.voxelFormat);
+        transferProgram.unbind();
 
         GL_DEBUG_POP()
     }
 
     // Inject radiance into voxel grid
     radianceTimer.start();
-    {
+    if (voxelOctree()) {
+        GL_DEBUG_PUSH("Radiance Injection")
+        octree.injectRadiance(shadowmapFBO.getTexture(0), SHADOWMAP_WIDTH, SHADOWMAP_HEIGHT);
+        GL_DEBUG_POP()
+    }
+    else {
         GL_DEBUG_PUSH("Radiance Injection")
 
         glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 
-        injectRadianceProgram.bind();
+        injectProgram.bind();
 
         glBindImageTexture(0, vct.voxelColor, 0, GL_TRUE, 0, GL_READ_ONLY, vct.voxelFormat);
         glBindImageTexture(1, vct.voxelNormal, 0, GL_TRUE, 0, GL_READ_ONLY, vct.voxelFormat);
@@ -799,27 +1215,7 @@ void Application::render(float dt) {
 
         GLuint shadowmap = shadowmapFBO.getTexture(0);
         glBindTextureUnit(1, shadowmap);
-        injectRadianceProgram.setUniform1i("shadowmap", 1);
-
-        glm::mat4 lsInverse = glm::inverse(ls);
-        injectRadianceProgram.setUniformMatrix4fv("lsInverse", lsInverse);
-        injectRadianceProgram.setUniform3fv("lightPos", mainlight.position);
-        injectRadianceProgram.setUniform3fv("lightInt", mainlight.color);
-
-        injectRadianceProgram.setUniform3fv("eye", camera.position);
-        injectRadianceProgram.setUniform1i("warpVoxels", settings.warpVoxels);
-        injectRadianceProgram.setUniform1i("warpTexture", settings.warpTexture);
-        injectRadianceProgram.setUniform1i("voxelizeTesselationWarp", settings.voxelizeTesselationWarp);
-        injectRadianceProgram.setUniformMatrix4fv("pv", pv);
-        injectRadianceProgram.setUniform1i("voxelDim", vct.voxelDim);
-        injectRadianceProgram.setUniform3fv("voxelMin", vct.min);
-        injectRadianceProgram.setUniform3fv("voxelMax", vct.max);
-        injectRadianceProgram.setUniform3fv("voxelCenter", vct.center);
-
-        injectRadianceProgram.setUniform1i("radianceLighting", settings.radianceLighting);
-        injectRadianceProgram.setUniform1i("radianceDilate", settings.radianceDilate);
-        injectRadianceProgram.setUniform1i("temporalFilterRadiance", settings.temporalFilterRadiance);
-        injectRadianceProgram.setUniform1f("temporalDecay", settings.temporalDecay);
+        injectProgram.setUniform1i("shadowmap", 1);
 
         glBindTextureUnit(10, warpmap);
 
@@ -830,18 +1226,17 @@ void Application::render(float dt) {
         glBindImageTexture(0, 0, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA16F);
         glBindImageTexture(1, 0, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA16F);
         glBindImageTexture(2, 0, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
-        injectRadianceProgram.unbind();
+        injectProgram.unbind();
 
         GL_DEBUG_POP()
     }
     radianceTimer.stop();
 
-    if (settings.voxelFillHoles) {
+    if (settings.voxelFillHoles && !voxelOctree() && voxelCascades == 1 && fillHolesProgram.isReady() && fillHolesProgram.isLinked()) {
         GL_DEBUG_PUSH("Voxel Fill Holes")
 
         glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 
-        static GLShaderProgram fillHoles {"Voxel Fill Holes", {SHADER_DIR "voxelFillHoles.comp"}};
         static GLuint filledVoxels = 0;
         if (filledVoxels == 0) {
                 glCreateTextures(GL_TEXTURE_3D, 1, &filledVoxels);
@@ -853,7 +1248,7 @@ void Application::render(float dt) {
                 glTextureStorage3D(filledVoxels, 1, GL_RGBA8, vct.voxelDim, vct.voxelDim, vct.voxelDim);
         }
 
-        fillHoles.bind();
+        fillHolesProgram.bind();
         glBindImageTexture(0, vct.voxelRadiance, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA8);
         glBindImageTexture(1, filledVoxels, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
 
@@ -862,7 +1257,7 @@ void Application::render(float dt) {
 
         glBindImageTexture(0, 0, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA8);
         glBindImageTexture(1, 0, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
-        fillHoles.unbind();
+        fillHolesProgram.unbind();
 
         glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
         glCopyImageSubData(
@@ -875,7 +1270,10 @@ void Application::render(float dt) {
     }
 
     mipmapTimer.start();
-    {
+    if (voxelOctree()) {
+        octree.filter();
+    }
+    else {
         // glGenerateTextureMipmap(vct.voxelColor);
         // glGenerateTextureMipmap(vct.voxelNormal);
         // glGenerateTextureMipmap(vct.voxelRadiance);
@@ -883,15 +1281,19 @@ void Application::render(float dt) {
         glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 
         mipmapProgram.bind();
+        mipmapProgram.setUniform3iv("dstOffset", glm::ivec3(0));
 
+        // Radiance is injected anew every frame, as the shadow of a moved mesh reaches past the voxels it
+        // covered. Color only changed within the revoxelized regions.
         int dim = vct.voxelDim;
         const int local_size = 8;
         for (int level = 0; level < vct.voxelLevels; level++) {
             glBindImageTexture(0, vct.voxelRadiance, level, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA8);
             glBindImageTexture(1, vct.voxelRadiance, level + 1, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
 
+            // The cascades are stacked along z and filtered together, each level of a cascade is a whole number of texels
             GLuint num_groups = ((dim >> 1) + local_size - 1) / local_size;
-            glDispatchCompute(num_groups, num_groups, num_groups);
+            glDispatchCompute(num_groups, num_groups, (((dim >> 1) * voxelCascades) + local_size - 1) / local_size);
 
             glBindImageTexture(0, 0, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA8);
             glBindImageTexture(1, 0, 1, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
@@ -900,20 +1302,16 @@ void Application::render(float dt) {
 
             dim >>= 1;
         }
-        dim = vct.voxelDim;
-        for (int level = 0; level < vct.voxelLevels; level++) {
-            glBindImageTexture(0, vct.voxelColor, level, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA8);
-            glBindImageTexture(1, vct.voxelColor, level + 1, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
-
-            GLuint num_groups = ((dim >> 1) + local_size - 1) / local_size;
-            glDispatchCompute(num_groups, num_groups, num_groups);
-
-            glBindImageTexture(0, 0, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA8);
-            glBindImageTexture(1, 0, 1, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
-
-            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-
-            dim >>= 1;
+        // With the static split color is merged anew every frame too
+        if (split) {
+            for (int cascade = 0; cascade < voxelCascades; cascade++) {
+                filterVoxelRegion(vct.voxelColor, { cascade, glm::ivec3(0), glm::ivec3(vct.voxelDim) });
+            }
+        }
+        else {
+            for (const VoxelRegion &region : voxelRegions) {
+                filterVoxelRegion(vct.voxelColor, region);
+            }
         }
 
         mipmapProgram.unbind();
@@ -922,7 +1320,8 @@ void Application::render(float dt) {
 
     glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 
-    if (settings.debugVoxels) {
+    // The voxel debug views read the dense volumes
+    if (settings.debugVoxels && !voxelOctree() && debugVoxelsProgram.isReady() && debugVoxelsProgram.isLinked()) {
         glm::mat4 mvp = projection * view;
         debugVoxels(settings.drawRadiance ? vct.voxelRadiance : vct.voxelColor, mvp);
     }
@@ -956,7 +1355,20 @@ void Application::render(float dt) {
             ditherProgram.setUniformMatrix4fv("projection", projection);
             ditherProgram.setUniformMatrix4fv("view", view);
 
-            scene->draw(ditherProgram);
+            if (settings.occlusionCulling && occlusionCullingReady) {
+                // Draws visible in the last frame's depth pyramid, then the ones the new pyramid reveals
+                occlusionCulling.cull(scene->getDrawList(), projection * view, cameraFrustum, OcclusionCulling::FIRST_PHASE);
+                ditherProgram.bind();
+                scene->drawIndirect(ditherProgram, occlusionCulling.getVisibleCommands());
+
+                occlusionCulling.buildPyramid(width, height);
+                occlusionCulling.cull(scene->getDrawList(), projection * view, cameraFrustum, OcclusionCulling::SECOND_PHASE);
+                ditherProgram.bind();
+                scene->drawIndirect(ditherProgram, occlusionCulling.getNewCommands());
+            }
+            else {
+                scene->draw(ditherProgram, GL_TRIANGLES, cull ? &cameraFrustum : nullptr);
+            }
 
             ditherProgram.unbind();
 
@@ -964,6 +1376,15 @@ void Application::render(float dt) {
             GL_DEBUG_POP()
         }
 
+        lightCullingTimer.start();
+        if (settings.clusteredLighting) {
+            GL_DEBUG_PUSH("Light Culling")
+            scene->bindLightSSBO(3);
+            lightClusters.cull(view, projection, near, far, width, height);
+            GL_DEBUG_POP()
+        }
+        lightCullingTimer.stop();
+
         renderTimer.start();
         // Render scene
         {
@@ -979,81 +1400,45 @@ void Application::render(float dt) {
             glEnable(GL_CULL_FACE);
             glPolygonMode(GL_FRONT_AND_BACK, settings.drawWireframe ? GL_LINE : GL_FILL);
 
-            program.bind();
-            program.setUniformMatrix4fv("projection", projection);
-            program.setUniformMatrix4fv("view", view);
-            program.setUniform3fv("eye", camera.position);
-            program.setUniformMatrix4fv("ls", ls);
+            phongProgram.bind();
 
             GLuint shadowmap = shadowmapFBO.getTexture(0);
             glBindTextureUnit(6, shadowmap);
 
-            program.setUniform1i("voxelize", settings.drawVoxels);
-            program.setUniform1i("normals", settings.drawNormals);
-            program.setUniform1i("dominant_axis", settings.drawDominantAxis);
-            program.setUniform1i("radiance", settings.drawRadiance);
-            program.setUniform1i("drawWarpSlope", settings.drawWarpSlope);
-            program.setUniform1i("drawOcclusion", settings.drawOcclusion);
-            program.setUniform1i("debugOcclusion", settings.debugOcclusion);
-            program.setUniform1i("debugIndirect", settings.debugIndirect);
-            program.setUniform1i("debugReflections", settings.debugReflections);
-            program.setUniform1i("debugMaterialDiffuse", settings.debugMaterialDiffuse);
-            program.setUniform1i("debugMaterialRoughness", settings.debugMaterialRoughness);
-            program.setUniform1i("debugMaterialMetallic", settings.debugMaterialMetallic);
-            program.setUniform1i("debugWarpTexture", settings.debugWarpTexture);
-            program.setUniform1i("toggle", settings.toggle);
-
-            program.setUniform1i("cooktorrance", settings.cooktorrance);
-            program.setUniform1i("enablePostprocess", settings.enablePostprocess);
-            program.setUniform1i("enableShadows", settings.enableShadows);
-            program.setUniform1i("enableNormalMap", settings.enableNormalMap);
-            program.setUniform1i("enableIndirect", settings.enableIndirect);
-            program.setUniform1i("enableDiffuse", settings.enableDiffuse);
-            program.setUniform1i("enableSpecular", settings.enableSpecular);
-            program.setUniform1i("enableReflections", settings.enableReflections);
-            program.setUniform1f("ambientScale", settings.ambientScale);
-            program.setUniform1f("reflectScale", settings.reflectScale);
-
-            program.setUniform1f("miplevel", settings.miplevel);
-
-            program.setUniform1i("warpVoxels", settings.warpVoxels);
-            program.setUniform1i("warpTexture", settings.warpTexture);
-            program.setUniform1i("voxelizeTesselationWarp", settings.voxelizeTesselationWarp);
-            program.setUniformMatrix4fv("pv", pv);
-            program.setUniform1i("voxelDim", vct.voxelDim);
-            program.setUniform3fv("voxelMin", vct.min);
-            program.setUniform3fv("voxelMax", vct.max);
-            program.setUniform3fv("voxelCenter", vct.center);
-            glBindTextureUnit(2, vct.voxelColor);
-            glBindTextureUnit(3, vct.voxelNormal);
-            glBindTextureUnit(4, vct.voxelRadiance);
-
-            program.setUniform1i("vctSteps", settings.diffuseConeSettings.steps);
-            program.setUniform1f("vctBias", settings.diffuseConeSettings.bias);
-            program.setUniform1f("vctConeAngle", settings.diffuseConeSettings.coneAngle);
-            program.setUniform1f("vctConeInitialHeight", settings.diffuseConeSettings.coneInitialHeight);
-            program.setUniform1f("vctLodOffset", settings.diffuseConeSettings.lodOffset);
-
-            program.setUniform1i("vctSpecularSteps", settings.specularConeSettings.steps);
-            program.setUniform1f("vctSpecularBias", settings.specularConeSettings.bias);
-            program.setUniform1f("vctSpecularConeAngle", settings.specularConeSettings.coneAngle);
-            program.setUniform1f("vctSpecularConeInitialHeight", settings.specularConeSettings.coneInitialHeight);
-            program.setUniform1f("vctSpecularLodOffset", settings.specularConeSettings.lodOffset);
-            program.setUniform1i("vctSpecularConeAngleFromRoughness", settings.specularConeAngleFromRoughness);
-
+            if (voxelOctree()) {
+                octree.bind(2, 3, 4);
+            }
+            else {
+                glBindTextureUnit(2, vct.voxelColor);
+                glBindTextureUnit(3, vct.voxelNormal);
+                glBindTextureUnit(4, vct.voxelRadiance);
+            }
             glBindTextureUnit(10, warpmap);
 
             scene->bindLightSSBO(3);
+            if (settings.clusteredLighting) {
+                lightClusters.bind(phongProgram);
+            }
 
-            scene->draw(program);
+            if (settings.occlusionCulling && occlusionCullingReady) {
+                scene->drawIndirect(phongProgram, occlusionCulling.getVisibleCommands());
+                cullingInfo.render = occlusionCulling.getStats().visible;
+            }
+            else {
+                cullingInfo.render = scene->draw(phongProgram, GL_TRIANGLES, cull ? &cameraFrustum : nullptr);
+            }
 
+            lightClusters.unbind();
+            if (voxelOctree()) {
+                octree.unbind(2, 3, 4);
+            }
             glBindTextureUnit(1, 0);
             glBindTextureUnit(2, 0);
             glBindTextureUnit(3, 0);
             glBindTextureUnit(4, 0);
             glBindTextureUnit(6, 0);
             glBindTextureUnit(10, 0);
-            program.unbind();
+            phongProgram.unbind();
 
             glDisable(GL_MULTISAMPLE);
             glDepthFunc(GL_LESS);
@@ -1073,6 +1458,8 @@ void Application::render(float dt) {
     shadowmapTimer.getQueryResult();
     radianceTimer.getQueryResult();
     mipmapTimer.getQueryResult();
+    octreeBuildTimer.getQueryResult();
+    lightCullingTimer.getQueryResult();
     renderTimer.getQueryResult();
     totalTimer.getQueryResult();
 
@@ -1085,7 +1472,8 @@ void Application::render(float dt) {
 }
 
 // Create a 3D texture
-GLuint make3DTexture(GLsizei size, GLsizei levels, GLenum internalFormat, GLint minFilter, GLint magFilter) {
+// stacked textures of size^3 are laid out along z
+GLuint make3DTexture(GLsizei size, GLsizei levels, GLenum internalFormat, GLint minFilter, GLint magFilter, GLsizei stacked) {
     GLuint handle;
 
     glGenTextures(1, &handle);
@@ -1097,7 +1485,7 @@ GLuint make3DTexture(GLsizei size, GLsizei levels, GLenum internalFormat, GLint
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_BORDER);
 
-    glTexStorage3D(GL_TEXTURE_3D, levels, internalFormat, size, size, size);
+    glTexStorage3D(GL_TEXTURE_3D, levels, internalFormat, size, size, size * stacked);
 
     if (internalFormat == GL_R32UI) {
         glClearTexImage(handle, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, nullptr);
@@ -1194,7 +1582,6 @@ void Application::viewRaymarched() {
 
     glm::vec3 cameraRight = glm::normalize(glm::cross(camera.front, camera.up)) * ((float)width / height);
 
-    glUniform3fv(glGetUniformLocation(program, "eye"), 1, glm::value_ptr(camera.position));
     glUniform3fv(glGetUniformLocation(program, "viewForward"), 1, glm::value_ptr(camera.front));
     glUniform3fv(glGetUniformLocation(program, "viewRight"), 1, glm::value_ptr(cameraRight));
     glUniform3fv(glGetUniformLocation(program, "viewUp"), 1, glm::value_ptr(glm::normalize(glm::cross(cameraRight, camera.front))));
@@ -1202,14 +1589,6 @@ void Application::viewRaymarched() {
     glUniform1i(glGetUniformLocation(program, "height"), height);
     glUniform1f(glGetUniformLocation(program, "near"), near);
     glUniform1f(glGetUniformLocation(program, "far"), far);
-    glUniform1i(glGetUniformLocation(program, "voxelDim"), vct.voxelDim);
-    glUniform1i(glGetUniformLocation(program, "warpVoxels"), settings.warpVoxels);
-    glUniform1i(glGetUniformLocation(program, "warpTexture"), settings.warpTexture);
-    glUniform3fv(glGetUniformLocation(program, "voxelMin"), 1, glm::value_ptr(vct.min));
-    glUniform3fv(glGetUniformLocation(program, "voxelMax"), 1, glm::value_ptr(vct.max));
-    glUniform3fv(glGetUniformLocation(program, "voxelCenter"), 1, glm::value_ptr(vct.center));
-    glUniform1f(glGetUniformLocation(program, "lod"), settings.miplevel);
-    glUniform1i(glGetUniformLocation(program, "radiance"), settings.drawRadiance);
 
     GLQuad::draw();
 
@@ -1224,8 +1603,7 @@ void Application::viewRaymarched() {
 void Application::debugVoxels(GLuint texture_id, const glm::mat4 &mvp) {
     static const float point[] = { 0.0f, 0.0f, 0.0f };
     static GLuint vao = 0;
-    static GLShaderProgram *shader = nullptr;
-    if (!shader) {
+    if (vao == 0) {
         GLuint vbo;
         glGenVertexArrays(1, &vao);
         glGenBuffers(1, &vbo);
@@ -1236,10 +1614,6 @@ void Application::debugVoxels(GLuint texture_id, const glm::mat4 &mvp) {
         glEnableVertexAttribArray(0);
         glBindBuffer(GL_ARRAY_BUFFER, 0);
         glBindVertexArray(0);
-
-        shader = new GLShaderProgram();
-        shader->attachAndLink({SHADER_DIR "debugVoxels.vert", SHADER_DIR "debugVoxels.geom", SHADER_DIR "debugVoxels.frag"});
-        shader->setObjectLabel("Debug Voxels");
     }
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -1250,15 +1624,10 @@ void Application::debugVoxels(GLuint texture_id, const glm::mat4 &mvp) {
         glEnable(GL_BLEND);
     }
 
-    shader->bind();
+    debugVoxelsProgram.bind();
 
-    shader->setUniformMatrix4fv("mvp", mvp);
-    shader->setUniform1f("level", settings.miplevel);
-    shader->setUniform1f("voxelDim", vct.voxelDim);
-    shader->setUniform3fv("voxelMin", vct.min);
-    shader->setUniform3fv("voxelMax", vct.max);
-    shader->setUniform3fv("voxelCenter", vct.center);
-    shader->setUniform1i("debugOpacity", settings.debugVoxelOpacity);
+    debugVoxelsProgram.setUniformMatrix4fv("mvp", mvp);
+    debugVoxelsProgram.setUniform1i("debugOpacity", settings.debugVoxelOpacity);
 
     glBindTextureUnit(0, texture_id);
 
@@ -1268,7 +1637,7 @@ void Application::debugVoxels(GLuint texture_id, const glm::mat4 &mvp) {
 
     glBindTextureUnit(0, 0);
 
-    shader->unbind();
+    debugVoxelsProgram.unbind();
     glDisable(GL_DEPTH_TEST);
     glDisable(GL_CULL_FACE);
     if (settings.debugVoxelOpacity) {
@@ -22,6 +22,13 @@
 #include "Camera.h"
 #include "Scene.h"
 #include "Graphics/GLTimer.h"
+#include "Graphics/Frustum.h"
+#include "Graphics/LightClusters.h"
+#include "Graphics/OcclusionCulling.h"
+#include "Graphics/FrameConstants.h"
+#include "Graphics/SparseVoxelOctree.h"
+#include "Graphics/ProgramRegistry.h"
+#include "Graphics/ProgramVariants.h"
 
 #include "common.h"
 
@@ -58,6 +65,11 @@ struct Settings {
     int msaa = false;
     int alphatocoverage = false;
     int cooktorrance = true;
+    int clusteredLighting = true;
+    int frustumCulling = true;
+    int occlusionCulling = true;
+    int lightStressTest = false;
+    int lightStressCount = 4096;
     enum ConservativeRasterizeMode { OFF, MSAA, NV };
     ConservativeRasterizeMode conservativeRasterization = MSAA;
     int enablePostprocess = true;
@@ -84,6 +96,9 @@ struct Settings {
     int voxelizeLighting = true;
     int voxelizeAtomicMax = true;
     int voxelTrackCamera = false;
+    int voxelScrolling = false;     // toroidal addressing while tracking, only revoxelizes what the volume uncovers
+    int voxelizeStaticSplit = false;    // keeps static actors in their own volume, only dynamic ones are voxelized every frame
+    int voxelizeDirtyRegions = false;   // keeps the voxels, only revoxelizes around the meshes that moved
     float voxelizeMultiplier = 1.0f;
     int voxelizeDilate = false;
     int warpVoxels = false;
@@ -100,9 +115,11 @@ struct Settings {
     int voxelizeTesselation = true;
     int voxelizeTesselationDebug = false;
     int voxelizeTesselationWarp = false;
+
+    int voxelOctree = false;
 };
 
-GLuint make3DTexture(GLsizei size, GLsizei levels, GLenum internalFormat, GLint minFilter, GLint magFilter);
+GLuint make3DTexture(GLsizei size, GLsizei levels, GLenum internalFormat, GLint minFilter, GLint magFilter, GLsizei stacked = 1);
 
 class VCT {
 public:
@@ -115,10 +132,11 @@ public:
 
     ~VCT() { cleanup(); }
 
-    void remake(int dim, int levels) {
+    void remake(int dim, int levels, int cascades) {
         assert(dim > 0);
         voxelDim = dim;
         voxelLevels = glm::clamp<int>(levels, 0, std::log2(dim) + 1);
+        voxelCascades = glm::clamp(cascades, 1, MAX_CASCADES);
 
         if (voxelLevels != levels) {
             LOG_WARN("Attempted remaking VCT with invalid number of levels, clamped ", levels, " to ", voxelLevels);
@@ -130,8 +148,55 @@ public:
 
     glm::vec3 voxelWorldSize() const { return (max - min) / (float)voxelDim; }
 
-    int voxelDim = 256, voxelLevels = 6;
+    // Clipmap cascades, each covers twice the extent of the previous at the same voxelDim. They're stacked
+    // along z in the color, normal and radiance textures (see shaders/common.glsl).
+    static const int MAX_CASCADES = 4;
+    float cascadeScale(int cascade) const { return (float)(1 << cascade); }
+    glm::vec3 cascadeMin(int cascade) const { return center + min * cascadeScale(cascade); }
+    glm::vec3 cascadeMax(int cascade) const { return center + max * cascadeScale(cascade); }
+
+    // First voxel of a cascade in its own grid of voxels. With toroidal addressing voxels wrap around the
+    // textures, that first voxel is then at the scroll texel.
+    glm::ivec3 cascadeOrigin(int cascade) const {
+        return glm::ivec3(glm::round(cascadeMin(cascade) / (voxelWorldSize() * cascadeScale(cascade))));
+    }
+    glm::ivec3 cascadeScroll(int cascade) const {
+        return (cascadeOrigin(cascade) % voxelDim + voxelDim) % voxelDim;
+    }
+
+    void setWrap(GLint mode) {
+        if (mode == wrap) return;
+        for (GLuint texture : { voxelColor, voxelNormal, voxelRadiance }) {
+            glTextureParameteri(texture, GL_TEXTURE_WRAP_S, mode);
+            glTextureParameteri(texture, GL_TEXTURE_WRAP_T, mode);
+            glTextureParameteri(texture, GL_TEXTURE_WRAP_R, mode);
+        }
+        wrap = mode;
+    }
+
+    // Voxels of the static actors, laid out like voxelColor and voxelNormal without mips. Merged into those by
+    // transferVoxels.comp, only made while static and dynamic actors are voxelized apart.
+    void makeStatic() {
+        if (staticColor != 0) return;
+        staticColor = make3DTexture(voxelDim, 1, voxelFormat, GL_NEAREST, GL_NEAREST, voxelCascades);
+        staticNormal = make3DTexture(voxelDim, 1, voxelFormat, GL_NEAREST, GL_NEAREST, voxelCascades);
+        scrollValid = false;
+    }
+    void deleteStatic() {
+        if (staticColor == 0) return;
+        glDeleteTextures(1, &staticColor);
+        glDeleteTextures(1, &staticNormal);
+        staticColor = staticNormal = 0;
+        scrollValid = false;
+    }
+
+    // Whether the textures hold the cascades at scrollOrigin, kept by Application::updateVoxelScroll
+    bool scrollValid = false;
+    glm::ivec3 scrollOrigin[MAX_CASCADES];
+
+    int voxelDim = 256, voxelLevels = 6, voxelCascades = 1;
     GLuint voxelColor = 0, voxelNormal = 0, voxelRadiance = 0, voxelOccupancy = 0;
+    GLuint staticColor = 0, staticNormal = 0;
     bool useRGBA16f;
     GLenum voxelFormat;
     int voxelOccupancyDim = 32;
@@ -141,17 +206,22 @@ public:
 
 private:
     void make() {
-        voxelColor = make3DTexture(voxelDim, voxelLevels, voxelFormat, GL_LINEAR_MIPMAP_LINEAR, GL_NEAREST);
-        voxelNormal = make3DTexture(voxelDim, 1, voxelFormat, GL_NEAREST, GL_NEAREST);
-        voxelRadiance = make3DTexture(voxelDim, voxelLevels, GL_RGBA8, GL_LINEAR_MIPMAP_LINEAR, GL_NEAREST);
+        voxelColor = make3DTexture(voxelDim, voxelLevels, voxelFormat, GL_LINEAR_MIPMAP_LINEAR, GL_NEAREST, voxelCascades);
+        voxelNormal = make3DTexture(voxelDim, 1, voxelFormat, GL_NEAREST, GL_NEAREST, voxelCascades);
+        voxelRadiance = make3DTexture(voxelDim, voxelLevels, GL_RGBA8, GL_LINEAR_MIPMAP_LINEAR, GL_NEAREST, voxelCascades);
         voxelOccupancy = make3DTexture(voxelOccupancyDim, 1, GL_R32UI, GL_NEAREST, GL_NEAREST);
+        wrap = GL_CLAMP_TO_BORDER;
+        scrollValid = false;
     }
 
+    GLint wrap = GL_CLAMP_TO_BORDER;
+
     void cleanup() {
         glDeleteTextures(1, &voxelColor);
         glDeleteTextures(1, &voxelNormal);
         glDeleteTextures(1, &voxelRadiance);
         glDeleteTextures(1, &voxelOccupancy);
+        deleteStatic();
     }
 };
 
@@ -164,6 +234,8 @@ public:
     void init();
     void update(float dt);
     void render(float dt);
+    // Frees what outlives the application, before the context is destroyed
+    void shutdown();
 
 private:
     GLFWwindow *window = nullptr;
@@ -173,6 +245,7 @@ private:
     float near = 0.1f, far = 100.0f;
 
     std::unique_ptr<Scene> scene = nullptr;
+    ProgramRegistry programs;
     GLShaderProgram program;
 
     static const size_t warpDim = 32;
@@ -188,8 +261,36 @@ private:
 
     GLShaderProgram mipmapProgram, ditherProgram;
 
+    GLShaderProgram generateWarpmapProgram, warpWeightsProgram, blurProgram;
+    GLShaderProgram voxelizeTesselationProgram, voxelizeTesselationDebugProgram;
+    GLShaderProgram transferVoxelsProgram, fillHolesProgram, debugVoxelsProgram;
+
+    // Specialized to the settings of the frame, falling back to the programs above while compiling
+    ProgramVariants phongVariants {program, "Phong", {SHADER_DIR "phong.vert", SHADER_DIR "phong.frag"}};
+    ProgramVariants voxelizeVariants {voxelProgram, "Voxelize", {SHADER_DIR "voxelize.vert", SHADER_DIR "voxelize.frag", SHADER_DIR "voxelize.geom"}};
+    ProgramVariants injectRadianceVariants {injectRadianceProgram, "Inject Radiance", {SHADER_DIR "injectRadiance.comp"}};
+    ProgramVariants transferVoxelsVariants {transferVoxelsProgram, "Transfer Voxels", {SHADER_DIR "transferVoxels.comp"}};
+    ProgramVariants voxelizeTesselationVariants {voxelizeTesselationProgram, "Voxelize Tesselation", {
+        SHADER_DIR "simpleTesselated.vert",
+        SHADER_DIR "testTesselation.tesc",
+        SHADER_DIR "testTesselation.tese"
+    }};
+
+    LightClusters lightClusters;
+    OcclusionCulling occlusionCulling;
+    bool occlusionCullingReady = false;
+    SparseVoxelOctree octree;
+    bool octreeReady = false;
+    FrameConstants frameConstants;
+    size_t stressLightCount = 0;
+
+    // From middle clicking with a free cursor, -1 for none
+    int pickedActor = -1;
+    float pickedDistance = 0.0f;
+
     Settings settings;
-    GLBufferedTimer voxelizeTimer, shadowmapTimer, radianceTimer, mipmapTimer, renderTimer, totalTimer;
+    GLBufferedTimer voxelizeTimer, shadowmapTimer, radianceTimer, mipmapTimer, lightCullingTimer, renderTimer, totalTimer;
+    GLBufferedTimer octreeBuildTimer;
 
     // if voxelizeDilate is enabled then maxFragmentsPerVoxel is invalid
     struct VoxelizeInfo {
@@ -197,6 +298,36 @@ private:
     } voxelizeInfo;
     GLuint voxelizeInfoSSBO = 0;
 
+    // Draws submitted per pass after culling, out of total. With occlusion culling the render pass
+    // count is read back from the GPU a frame late.
+    struct CullingInfo {
+        size_t total = 0, shadowmap = 0, voxelize = 0, render = 0;
+        size_t voxelizePasses = 1;  // the voxelize pass draws once per region
+    } cullingInfo;
+
+    // Box of voxels of a cascade, relative to its first voxel
+    struct VoxelRegion {
+        int cascade;
+        glm::ivec3 min, max;
+    };
+    // Revoxelized this frame, whole cascades unless only scrolled or around meshes that moved. With the static
+    // split these are the regions of the static volume, the dynamic actors are voxelized over whole cascades every frame.
+    std::vector<VoxelRegion> voxelRegions;
+    uint64_t scrollFeatures = 0;
+    size_t scrollStaticChanges = 0;
+    Settings::ConservativeRasterizeMode scrollRasterization = Settings::ConservativeRasterizeMode::OFF;
+    float scrollMultiplier = 0.0f;
+
+    void updateStressLights();
+    void uploadFrameConstants(const glm::mat4 &projection, const glm::mat4 &view, const glm::mat4 &pv, const glm::mat4 &ls, const Light &mainlight);
+    bool voxelOctree() const;
+    bool voxelToroidal() const;
+    bool voxelStaticSplit() const;
+    bool voxelDirtyRegions() const;
+    void updateVoxelScroll(uint64_t features);
+    void addVoxelRegion(VoxelRegion region);
+    void clearVoxelRegion(const VoxelRegion &region, GLuint color, GLuint normal);
+    void filterVoxelRegion(GLuint texture, const VoxelRegion &region);
     void viewRaymarched();
     void debugVoxels(GLuint texture_id, const glm::mat4 &mvp);
 };
@@ -0,0 +1,329 @@
+#include "BVH.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+const float BVH::REBUILD_RATIO = 1.5f;
+
+// Leaves are not split below this many items
+static const uint32_t MAX_LEAF_ITEMS = 4;
+// Bounds the traversal stacks, deeper nodes become leaves whatever their size
+static const int MAX_DEPTH = 64;
+static const int SAH_BINS = 12;
+// Relative cost of visiting a node against testing an item
+static const float TRAVERSAL_COST = 1.0f;
+
+static float surfaceArea(const glm::vec3 &min, const glm::vec3 &max) {
+    glm::vec3 d = glm::max(max - min, glm::vec3(0.0f));
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+void BVH::build(const glm::vec3 *mins, const glm::vec3 *maxs, size_t count) {
+    itemMin.assign(mins, mins + count);
+    itemMax.assign(maxs, maxs + count);
+
+    items.resize(count);
+    vector<glm::vec3> centroids(count);
+    for (size_t i = 0; i < count; i++) {
+        items[i] = i;
+        centroids[i] = 0.5f * (mins[i] + maxs[i]);
+    }
+
+    nodes.clear();
+    nodes.reserve(2 * count);
+    nodes.push_back(Node());
+    if (count > 0) {
+        buildNode(0, 0, count, centroids, 1);
+    }
+    else {
+        nodes[0].min = nodes[0].max = glm::vec3(0.0f);
+        nodes[0].first = nodes[0].count = 0;
+    }
+
+    cost = buildCost = computeCost();
+}
+
+void BVH::buildNode(uint32_t nodeIndex, uint32_t first, uint32_t count, const vector<glm::vec3> &centroids, int depth) {
+    glm::vec3 centroidMin(numeric_limits<float>::max()), centroidMax(numeric_limits<float>::lowest());
+    glm::vec3 boundsMin(numeric_limits<float>::max()), boundsMax(numeric_limits<float>::lowest());
+    for (uint32_t i = first; i < first + count; i++) {
+        uint32_t item = items[i];
+        centroidMin = glm::min(centroidMin, centroids[item]);
+        centroidMax = glm::max(centroidMax, centroids[item]);
+        boundsMin = glm::min(boundsMin, itemMin[item]);
+        boundsMax = glm::max(boundsMax, itemMax[item]);
+    }
+
+    nodes[nodeIndex].min = boundsMin;
+    nodes[nodeIndex].max = boundsMax;
+    nodes[nodeIndex].first = first;
+    nodes[nodeIndex].count = count;
+    if (count <= MAX_LEAF_ITEMS || depth == MAX_DEPTH - 1) {
+        return;
+    }
+
+    // Binned SAH over every axis, Wald, "On fast Construction of SAH-based Bounding Volume Hierarchies"
+    struct Bin {
+        glm::vec3 min { numeric_limits<float>::max() }, max { numeric_limits<float>::lowest() };
+        uint32_t count = 0;
+    };
+
+    int bestAxis = -1, bestSplit = 0;
+    float bestCost = count * surfaceArea(boundsMin, boundsMax); // of not splitting
+    glm::vec3 extent = centroidMax - centroidMin;
+    for (int axis = 0; axis < 3; axis++) {
+        if (extent[axis] <= 0.0f) {
+            continue;
+        }
+
+        Bin bins[SAH_BINS];
+        float scale = SAH_BINS / extent[axis];
+        for (uint32_t i = first; i < first + count; i++) {
+            uint32_t item = items[i];
+            int b = min((int)((centroids[item][axis] - centroidMin[axis]) * scale), SAH_BINS - 1);
+            bins[b].min = glm::min(bins[b].min, itemMin[item]);
+            bins[b].max = glm::max(bins[b].max, itemMax[item]);
+            bins[b].count++;
+        }
+
+        // Area and count left of each split, swept from both ends
+        float leftArea[SAH_BINS - 1];
+        uint32_t leftCount[SAH_BINS - 1];
+        Bin left, right;
+        for (int b = 0; b < SAH_BINS - 1; b++) {
+            left.min = glm::min(left.min, bins[b].min);
+            left.max = glm::max(left.max, bins[b].max);
+            left.count += bins[b].count;
+            leftArea[b] = left.count ? surfaceArea(left.min, left.max) : 0.0f;
+            leftCount[b] = left.count;
+        }
+        for (int b = SAH_BINS - 1; b > 0; b--) {
+            right.min = glm::min(right.min, bins[b].min);
+            right.max = glm::max(right.max, bins[b].max);
+            right.count += bins[b].count;
+
+            float rightArea = right.count ? surfaceArea(right.min, right.max) : 0.0f;
+            float splitCost = TRAVERSAL_COST * surfaceArea(boundsMin, boundsMax)
+                            + leftCount[b - 1] * leftArea[b - 1] + right.count * rightArea;
+            if (leftCount[b - 1] > 0 && right.count > 0 && splitCost < bestCost) {
+                bestCost = splitCost;
+                bestAxis = axis;
+                bestSplit = b;
+            }
+        }
+    }
+
+    uint32_t middle;
+    if (bestAxis >= 0) {
+        float scale = SAH_BINS / extent[bestAxis];
+        uint32_t *split = partition(items.data() + first, items.data() + first + count, [&] (uint32_t item) {
+            return min((int)((centroids[item][bestAxis] - centroidMin[bestAxis]) * scale), SAH_BINS - 1) < bestSplit;
+        });
+        middle = split - items.data();
+    }
+    else if (count > 8 * MAX_LEAF_ITEMS) {
+        // Too many items on top of each other for a leaf, split them in half anyway
+        middle = first + count / 2;
+    }
+    else {
+        return;
+    }
+
+    // Children are allocated next to each other, after their parent
+    uint32_t leftChild = nodes.size();
+    nodes.push_back(Node());
+    nodes.push_back(Node());
+    nodes[nodeIndex].first = leftChild;
+    nodes[nodeIndex].count = 0;
+
+    buildNode(leftChild, first, middle - first, centroids, depth + 1);
+    buildNode(leftChild + 1, middle, first + count - middle, centroids, depth + 1);
+}
+
+bool BVH::refit(const glm::vec3 *mins, const glm::vec3 *maxs) {
+    copy(mins, mins + itemMin.size(), itemMin.begin());
+    copy(maxs, maxs + itemMax.size(), itemMax.begin());
+
+    if (itemMin.empty()) {
+        return true;
+    }
+
+    // Children always come after their parent
+    for (size_t i = nodes.size(); i-- > 0;) {
+        updateBounds(i);
+    }
+
+    cost = computeCost();
+    return cost <= REBUILD_RATIO * buildCost;
+}
+
+void BVH::updateBounds(uint32_t nodeIndex) {
+    Node &node = nodes[nodeIndex];
+    if (node.count > 0) {
+        node.min = glm::vec3(numeric_limits<float>::max());
+        node.max = glm::vec3(numeric_limits<float>::lowest());
+        for (uint32_t i = node.first; i < node.first + node.count; i++) {
+            node.min = glm::min(node.min, itemMin[items[i]]);
+            node.max = glm::max(node.max, itemMax[items[i]]);
+        }
+    }
+    else {
+        const Node &left = nodes[node.first], &right = nodes[node.first + 1];
+        node.min = glm::min(left.min, right.min);
+        node.max = glm::max(left.max, right.max);
+    }
+}
+
+// SAH cost of the whole tree relative to the root's area
+float BVH::computeCost() const {
+    float rootArea = surfaceArea(nodes[0].min, nodes[0].max);
+    if (rootArea <= 0.0f) {
+        return 0.0f;
+    }
+
+    float total = 0.0f;
+    for (const Node &node : nodes) {
+        total += surfaceArea(node.min, node.max) * (node.count > 0 ? node.count : TRAVERSAL_COST);
+    }
+    return total / rootArea;
+}
+
+void BVH::appendSubtree(uint32_t nodeIndex, vector<uint32_t> &result) const {
+    // Subtrees cover contiguous item ranges, so walk down to the outermost leaves
+    uint32_t first = nodeIndex, last = nodeIndex;
+    while (nodes[first].count == 0) {
+        first = nodes[first].first;
+    }
+    while (nodes[last].count == 0) {
+        last = nodes[last].first + 1;
+    }
+    result.insert(result.end(), items.begin() + nodes[first].first, items.begin() + nodes[last].first + nodes[last].count);
+}
+
+void BVH::queryFrustum(const Frustum &frustum, vector<uint32_t> &result) const {
+    if (itemMin.empty()) {
+        return;
+    }
+
+    uint32_t stack[MAX_DEPTH];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node &node = nodes[stack[--top]];
+
+        Frustum::Containment containment = frustum.classifyBox(node.min, node.max);
+        if (containment == Frustum::OUTSIDE) {
+            continue;
+        }
+        if (containment == Frustum::INSIDE) {
+            appendSubtree(&node - nodes.data(), result);
+            continue;
+        }
+
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                uint32_t item = items[i];
+                if (frustum.classifyBox(itemMin[item], itemMax[item]) != Frustum::OUTSIDE) {
+                    result.push_back(item);
+                }
+            }
+        }
+        else {
+            stack[top++] = node.first;
+            stack[top++] = node.first + 1;
+        }
+    }
+}
+
+void BVH::queryBox(const glm::vec3 &min, const glm::vec3 &max, vector<uint32_t> &result) const {
+    if (itemMin.empty()) {
+        return;
+    }
+
+    auto overlaps = [&] (const glm::vec3 &otherMin, const glm::vec3 &otherMax) {
+        return otherMin.x <= max.x && otherMin.y <= max.y && otherMin.z <= max.z
+            && otherMax.x >= min.x && otherMax.y >= min.y && otherMax.z >= min.z;
+    };
+
+    uint32_t stack[MAX_DEPTH];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node &node = nodes[stack[--top]];
+        if (!overlaps(node.min, node.max)) {
+            continue;
+        }
+
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                uint32_t item = items[i];
+                if (overlaps(itemMin[item], itemMax[item])) {
+                    result.push_back(item);
+                }
+            }
+        }
+        else {
+            stack[top++] = node.first;
+            stack[top++] = node.first + 1;
+        }
+    }
+}
+
+bool BVH::raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, uint32_t &item, float &distance) const {
+    if (itemMin.empty()) {
+        return false;
+    }
+
+    glm::vec3 inverse = 1.0f / direction;
+
+    // Slab test, returns the entry distance or infinity on a miss
+    auto intersect = [&] (const glm::vec3 &min, const glm::vec3 &max, float limit) {
+        glm::vec3 t0 = (min - origin) * inverse, t1 = (max - origin) * inverse;
+        glm::vec3 tmin = glm::min(t0, t1), tmax = glm::max(t0, t1);
+        float enter = std::max(std::max(tmin.x, tmin.y), std::max(tmin.z, 0.0f));
+        float exit = std::min(std::min(tmax.x, tmax.y), std::min(tmax.z, limit));
+        return enter <= exit ? enter : numeric_limits<float>::infinity();
+    };
+
+    bool hit = false;
+    distance = maxDistance;
+
+    uint32_t stack[MAX_DEPTH];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node &node = nodes[stack[--top]];
+        if (intersect(node.min, node.max, distance) == numeric_limits<float>::infinity()) {
+            continue;
+        }
+
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                float t = intersect(itemMin[items[i]], itemMax[items[i]], distance);
+                if (t != numeric_limits<float>::infinity() && (!hit || t < distance)) {
+                    distance = t;
+                    item = items[i];
+                    hit = true;
+                }
+            }
+        }
+        else {
+            // Nearer child on top of the stack
+            const Node &left = nodes[node.first], &right = nodes[node.first + 1];
+            float tLeft = intersect(left.min, left.max, distance), tRight = intersect(right.min, right.max, distance);
+            if (tLeft < tRight) {
+                stack[top++] = node.first + 1;
+                stack[top++] = node.first;
+            }
+            else {
+                stack[top++] = node.first;
+                stack[top++] = node.first + 1;
+            }
+        }
+    }
+
+    return hit;
+}
@@ -0,0 +1,58 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <Graphics/Frustum.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bounding volume hierarchy over axis aligned boxes, answering frustum, box and ray queries with
+// item indices. Built top down with a binned surface area heuristic, moved items are handled by
+// refitting the node bounds until the tree has degraded enough to warrant a rebuild.
+class BVH {
+public:
+    struct Node {
+        glm::vec3 min;
+        uint32_t first; // first child for inner nodes (the second follows it), first item for leaves
+        glm::vec3 max;
+        uint32_t count; // items in a leaf, 0 for inner nodes
+    };
+
+    BVH() {}
+
+    void build(const glm::vec3 *mins, const glm::vec3 *maxs, size_t count);
+    // Updates the bounds for the same items after some moved. Returns false when the tree has
+    // degraded past REBUILD_RATIO, the caller should build() again.
+    bool refit(const glm::vec3 *mins, const glm::vec3 *maxs);
+
+    // Appends the items intersecting the query volume, in no particular order
+    void queryFrustum(const Frustum &frustum, std::vector<uint32_t> &result) const;
+    void queryBox(const glm::vec3 &min, const glm::vec3 &max, std::vector<uint32_t> &result) const;
+    // Nearest item whose box is hit by the ray within maxDistance, direction need not be normalized
+    // (distances are then in units of its length)
+    bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, uint32_t &item, float &distance) const;
+
+    size_t getItemCount() const { return itemMin.size(); }
+    size_t getNodeCount() const { return nodes.size(); }
+    // Expected cost of a query relative to testing the root, see getCost()
+    float getCost() const { return cost; }
+
+    // Refits stop once the cost grows past this factor of the cost after the last build
+    static const float REBUILD_RATIO;
+
+private:
+    void buildNode(uint32_t nodeIndex, uint32_t first, uint32_t count, const std::vector<glm::vec3> &centroids, int depth);
+    void updateBounds(uint32_t nodeIndex);
+    void appendSubtree(uint32_t nodeIndex, std::vector<uint32_t> &result) const;
+    float computeCost() const;
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> items; // leaves reference ranges of this
+    std::vector<glm::vec3> itemMin, itemMax;
+
+    float cost = 0.0f, buildCost = 0.0f;
+};
+
+#endif
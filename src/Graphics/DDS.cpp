@@ -0,0 +1,164 @@
+#include "DDS.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+// https://docs.microsoft.com/en-us/windows/win32/direct3ddds/dds-header
+struct DDSPixelFormat {
+    uint32_t dwSize, dwFlags, dwFourCC, dwRGBBitCount;
+    uint32_t dwRBitMask, dwGBitMask, dwBBitMask, dwABitMask;
+};
+
+struct DDSHeader {
+    uint32_t dwSize, dwFlags, dwHeight, dwWidth, dwPitchOrLinearSize;
+    uint32_t dwDepth, dwMipMapCount, dwReserved1[11];
+    DDSPixelFormat ddspf;
+    uint32_t dwCaps, dwCaps2, dwCaps3, dwCaps4, dwReserved2;
+};
+
+struct DDSHeaderDX10 {
+    uint32_t dxgiFormat, resourceDimension, miscFlag, arraySize, miscFlags2;
+};
+
+static_assert(sizeof(DDSHeader) == 124, "DDS header must be 124 bytes");
+static_assert(sizeof(DDSHeaderDX10) == 20, "DDS DX10 header must be 20 bytes");
+
+static const uint32_t DDPF_FOURCC = 0x4;
+static const uint32_t DDSD_CAPS = 0x1, DDSD_HEIGHT = 0x2, DDSD_WIDTH = 0x4, DDSD_PIXELFORMAT = 0x1000;
+static const uint32_t DDSD_MIPMAPCOUNT = 0x20000, DDSD_LINEARSIZE = 0x80000;
+static const uint32_t DDSCAPS_COMPLEX = 0x8, DDSCAPS_TEXTURE = 0x1000, DDSCAPS_MIPMAP = 0x400000;
+static const uint32_t D3D10_RESOURCE_DIMENSION_TEXTURE2D = 3;
+
+static uint32_t fourCC(const char *code) {
+    uint32_t value;
+    memcpy(&value, code, 4);
+    return value;
+}
+
+static bool getFormat(uint32_t dxgiFormat, DDS::Format &format, GLenum &internalFormat) {
+    switch (dxgiFormat) {
+        case DDS::BC1: internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; break;
+        case DDS::BC2: internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT; break;
+        case DDS::BC3: internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; break;
+        case DDS::BC4: internalFormat = GL_COMPRESSED_RED_RGTC1; break;
+        case DDS::BC5: internalFormat = GL_COMPRESSED_RG_RGTC2; break;
+        case DDS::BC7: internalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM; break;
+        default: return false;
+    }
+
+    format = (DDS::Format)dxgiFormat;
+    return true;
+}
+
+bool DDS::parse(const unsigned char *data, size_t size, Image &image, std::string &err) {
+    if (size < 4 + sizeof(DDSHeader) || memcmp(data, "DDS ", 4) != 0) {
+        err = "not a dds file";
+        return false;
+    }
+
+    DDSHeader hdr;
+    memcpy(&hdr, data + 4, sizeof(hdr));
+    size_t offset = 4 + sizeof(DDSHeader);
+
+    uint32_t dxgiFormat = 0;
+    if (!(hdr.ddspf.dwFlags & DDPF_FOURCC)) {
+        err = "uncompressed dds files are not supported";
+        return false;
+    }
+    else if (hdr.ddspf.dwFourCC == fourCC("DX10")) {
+        if (size < offset + sizeof(DDSHeaderDX10)) {
+            err = "truncated DX10 header";
+            return false;
+        }
+
+        DDSHeaderDX10 dx10;
+        memcpy(&dx10, data + offset, sizeof(dx10));
+        offset += sizeof(DDSHeaderDX10);
+
+        if (dx10.resourceDimension != D3D10_RESOURCE_DIMENSION_TEXTURE2D || dx10.arraySize > 1) {
+            err = "only single 2D textures are supported";
+            return false;
+        }
+        dxgiFormat = dx10.dxgiFormat;
+    }
+    else if (hdr.ddspf.dwFourCC == fourCC("DXT1")) { dxgiFormat = BC1; }
+    else if (hdr.ddspf.dwFourCC == fourCC("DXT3")) { dxgiFormat = BC2; }
+    else if (hdr.ddspf.dwFourCC == fourCC("DXT5")) { dxgiFormat = BC3; }
+    else if (hdr.ddspf.dwFourCC == fourCC("ATI1") || hdr.ddspf.dwFourCC == fourCC("BC4U")) { dxgiFormat = BC4; }
+    else if (hdr.ddspf.dwFourCC == fourCC("ATI2") || hdr.ddspf.dwFourCC == fourCC("BC5U")) { dxgiFormat = BC5; }
+
+    if (!getFormat(dxgiFormat, image.format, image.internalFormat)) {
+        err = "unsupported compression format";
+        return false;
+    }
+
+    // Legacy DXT1 files were always loaded as opaque
+    if (hdr.ddspf.dwFourCC == fourCC("DXT1")) {
+        image.internalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    }
+
+    if (hdr.dwWidth == 0 || hdr.dwHeight == 0) {
+        err = "empty image";
+        return false;
+    }
+
+    image.width = hdr.dwWidth;
+    image.height = hdr.dwHeight;
+    image.levels.clear();
+
+    // Only keep the levels that are actually in the file
+    uint32_t levelCount = std::max(hdr.dwMipMapCount, 1u);
+    uint32_t width = hdr.dwWidth, height = hdr.dwHeight;
+    for (uint32_t level = 0; level < levelCount; level++) {
+        size_t levelSize = getLevelSize(image.format, width, height);
+        if (offset + levelSize > size) {
+            break;
+        }
+
+        image.levels.push_back(Level {offset, levelSize, (GLsizei)width, (GLsizei)height});
+        offset += levelSize;
+
+        if (width == 1 && height == 1) {
+            break;
+        }
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+    }
+
+    if (image.levels.empty()) {
+        err = "truncated image data";
+        return false;
+    }
+
+    return true;
+}
+
+std::vector<unsigned char> DDS::createHeader(Format format, uint32_t width, uint32_t height, uint32_t levelCount) {
+    DDSHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.dwSize = sizeof(DDSHeader);
+    hdr.dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE;
+    hdr.dwHeight = height;
+    hdr.dwWidth = width;
+    hdr.dwPitchOrLinearSize = (uint32_t)getLevelSize(format, width, height);
+    hdr.dwMipMapCount = levelCount;
+    hdr.ddspf.dwSize = sizeof(DDSPixelFormat);
+    hdr.ddspf.dwFlags = DDPF_FOURCC;
+    hdr.ddspf.dwFourCC = fourCC("DX10");
+    hdr.dwCaps = DDSCAPS_TEXTURE;
+    if (levelCount > 1) {
+        hdr.dwFlags |= DDSD_MIPMAPCOUNT;
+        hdr.dwCaps |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+    }
+
+    DDSHeaderDX10 dx10 = { format, D3D10_RESOURCE_DIMENSION_TEXTURE2D, 0, 1, 0 };
+
+    std::vector<unsigned char> header(4 + sizeof(hdr) + sizeof(dx10));
+    memcpy(header.data(), "DDS ", 4);
+    memcpy(header.data() + 4, &hdr, sizeof(hdr));
+    memcpy(header.data() + 4 + sizeof(hdr), &dx10, sizeof(dx10));
+
+    return header;
+}
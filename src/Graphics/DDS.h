@@ -0,0 +1,52 @@
+#ifndef DDS_H
+#define DDS_H
+
+#include <Graphics/opengl.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// DDS container with block compressed data. Reads the legacy DXT1/3/5 and ATI1/2 codes
+// as well as the DX10 extension header, writes DX10 headers.
+class DDS {
+public:
+    // DXGI_FORMAT_*_UNORM values used in the DX10 header
+    enum Format : uint32_t {
+        BC1 = 71,
+        BC2 = 74,
+        BC3 = 77,
+        BC4 = 80,
+        BC5 = 83,
+        BC7 = 98,
+    };
+
+    struct Level {
+        size_t offset, size; // offset from the start of the file
+        GLsizei width, height;
+    };
+
+    struct Image {
+        Format format;
+        GLenum internalFormat;
+        GLsizei width, height;
+        std::vector<Level> levels;
+    };
+
+    // Validates the header and lists the stored mip levels that are fully present
+    static bool parse(const unsigned char *data, size_t size, Image &image, std::string &err);
+
+    // Header (including the DX10 extension) for levelCount levels, the level data follows directly
+    static std::vector<unsigned char> createHeader(Format format, uint32_t width, uint32_t height, uint32_t levelCount);
+
+    static size_t getBlockSize(Format format) { return (format == BC1 || format == BC4) ? 8 : 16; }
+    static size_t getLevelSize(Format format, uint32_t width, uint32_t height) {
+        return ((width + 3) / 4) * ((height + 3) / 4) * getBlockSize(format);
+    }
+
+private:
+    DDS() {}
+};
+
+#endif
@@ -0,0 +1,338 @@
+#include "DrawList.h"
+
+#include <Graphics/GeometryArena.h>
+#include <Graphics/MaterialTable.h>
+#include <Graphics/Mesh.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+using namespace std;
+
+bool DrawList::useBVH = true;
+
+DrawList::~DrawList() {
+    GLuint buffers[] = { commandBuffer, drawDataSSBO, culledCommandBuffer, boundsSSBO };
+    glDeleteBuffers(4, buffers);
+}
+
+void DrawList::begin() {
+    addedMeshes = 0;
+}
+
+void DrawList::addMesh(const Mesh &mesh, const glm::mat4 &model, bool isDynamic) {
+    size_t t = addedMeshes++;
+    if (!meshesChanged && t < meshes.size() && meshes[t] == &mesh && dynamic[t] == isDynamic) {
+        if (transforms[t] != model) {
+            transforms[t] = model;
+            moved[t] = 1;
+            anyMoved = true;
+        }
+        return;
+    }
+
+    meshesChanged = true;
+    meshes.resize(t);
+    transforms.resize(t);
+    dynamic.resize(t);
+    meshes.push_back(&mesh);
+    transforms.push_back(model);
+    dynamic.push_back(isDynamic);
+}
+
+void DrawList::upload() {
+    if (addedMeshes != meshes.size()) {
+        meshesChanged = true;
+        meshes.resize(addedMeshes);
+        transforms.resize(addedMeshes);
+        dynamic.resize(addedMeshes);
+    }
+
+    movedBoxes.clear();
+    if (meshesChanged) {
+        build();
+    }
+    else if (anyMoved) {
+        updateMoved();
+    }
+
+    moved.assign(transforms.size(), 0);
+    meshesChanged = anyMoved = false;
+}
+
+uint64_t DrawList::makeKey(GLenum indexType, size_t mesh, size_t material, size_t part, size_t transform) {
+    // Only the index type must be exact, it splits the batches. The rest just orders the draws.
+    return (uint64_t)(indexType == GL_UNSIGNED_INT) << 63
+         | (uint64_t)(mesh & 0x3fff) << 49
+         | (uint64_t)(material & 0xfff) << 37
+         | (uint64_t)(part & 0x7fff) << 22
+         | (uint64_t)(transform & 0x3fffff);
+}
+
+// Least significant digit first radix sort of keys, order receives the sorted indices.
+// Bytes every key shares are skipped, which is most of them for small scenes.
+static void radixSort(vector<uint64_t> &keys, vector<uint32_t> &order, vector<uint64_t> &keyScratch, vector<uint32_t> &orderScratch) {
+    size_t count = keys.size();
+    order.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        order[i] = i;
+    }
+    keyScratch.resize(count);
+    orderScratch.resize(count);
+
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t offsets[256] = {};
+        for (size_t i = 0; i < count; i++) {
+            offsets[(keys[i] >> shift) & 0xff]++;
+        }
+        if (count == 0 || offsets[(keys[0] >> shift) & 0xff] == count) {
+            continue;
+        }
+
+        size_t sum = 0;
+        for (size_t &offset : offsets) {
+            size_t n = offset;
+            offset = sum;
+            sum += n;
+        }
+        for (size_t i = 0; i < count; i++) {
+            size_t dst = offsets[(keys[i] >> shift) & 0xff]++;
+            keyScratch[dst] = keys[i];
+            orderScratch[dst] = order[i];
+        }
+        keys.swap(keyScratch);
+        order.swap(orderScratch);
+    }
+}
+
+void DrawList::build() {
+    vector<Item> unsorted;
+    keys.clear();
+    unordered_map<const Mesh *, size_t> meshIds;
+    for (size_t t = 0; t < meshes.size(); t++) {
+        const Mesh &mesh = *meshes[t];
+        size_t meshId = meshIds.emplace(&mesh, meshIds.size()).first->second;
+        size_t part = 0;
+        for (const Drawable &d : mesh.getDrawables()) {
+            for (const DrawablePart &p : d.parts) {
+                unsorted.push_back({ &mesh, &d, &p, t });
+                keys.push_back(makeKey(d.indexType, meshId, d.material_id, part++, t));
+            }
+        }
+    }
+
+    radixSort(keys, order, sortScratch, orderScratch);
+    sorts++;
+    staticChanges++;
+
+    items.resize(unsorted.size());
+    for (size_t i = 0; i < items.size(); i++) {
+        items[i] = unsorted[order[i]];
+    }
+
+    batches.clear();
+    commands.resize(items.size());
+    drawData.resize(items.size());
+    size_t paddedCount = (items.size() + 3) & ~size_t(3);
+    for (int c = 0; c < 3; c++) {
+        boundsCenter[c].assign(paddedCount, 0.0f);
+        boundsExtent[c].assign(paddedCount, 0.0f);
+    }
+    boundsMin.resize(items.size());
+    boundsMax.resize(items.size());
+    gpuBounds.resize(2 * items.size());
+    for (size_t i = 0; i < items.size(); i++) {
+        const Mesh &mesh = *items[i].mesh;
+        const Drawable &d = *items[i].drawable;
+        const DrawablePart &part = *items[i].part;
+
+        commands[i].count = part.count;
+        commands[i].instanceCount = 1;
+        commands[i].firstIndex = d.firstIndex + part.firstIndex;
+        commands[i].baseVertex = mesh.getBaseVertex() + d.baseVertex;
+        commands[i].baseInstance = i;
+
+        drawData[i].model = transforms[items[i].transform];
+        drawData[i].vertexMin = mesh.getMin();
+        drawData[i].material = mesh.getMaterialBase() + d.material_id;
+        drawData[i].vertexExtent = mesh.getExtents();
+        drawData[i].compactVertices = mesh.hasCompactVertices();
+
+        if (batches.empty() || batches.back().indexType != d.indexType) {
+            batches.push_back({ d.indexType, i, 0 });
+        }
+        batches.back().count++;
+
+        computeBounds(i);
+    }
+
+    bvh.build(boundsMin.data(), boundsMax.data(), items.size());
+    bvhRebuilds++;
+
+    reserveBuffers();
+    if (!items.empty()) {
+        glNamedBufferSubData(commandBuffer, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+        glNamedBufferSubData(drawDataSSBO, 0, drawData.size() * sizeof(DrawData), drawData.data());
+        glNamedBufferSubData(boundsSSBO, 0, gpuBounds.size() * sizeof(glm::vec4), gpuBounds.data());
+    }
+}
+
+void DrawList::updateMoved() {
+    const uint32_t none = numeric_limits<uint32_t>::max();
+    movedBoxIndex.assign(transforms.size(), none);
+
+    size_t first = items.size(), last = 0;
+    for (size_t i = 0; i < items.size(); i++) {
+        const size_t t = items[i].transform;
+        if (moved[t]) {
+            // Grow the mesh's box by the part's bounds before and after moving
+            if (movedBoxIndex[t] == none) {
+                movedBoxIndex[t] = movedBoxes.size();
+                movedBoxes.push_back({ boundsMin[i], boundsMax[i], dynamic[t] != 0 });
+            }
+            MovedBox &box = movedBoxes[movedBoxIndex[t]];
+            box.min = glm::min(box.min, boundsMin[i]);
+            box.max = glm::max(box.max, boundsMax[i]);
+
+            drawData[i].model = transforms[t];
+            computeBounds(i);
+            box.min = glm::min(box.min, boundsMin[i]);
+            box.max = glm::max(box.max, boundsMax[i]);
+            first = min(first, i);
+            last = i;
+        }
+    }
+    if (first > last) {
+        return;
+    }
+
+    if (!bvh.refit(boundsMin.data(), boundsMax.data())) {
+        bvh.build(boundsMin.data(), boundsMax.data(), items.size());
+        bvhRebuilds++;
+    }
+
+    size_t count = last - first + 1;
+    glNamedBufferSubData(drawDataSSBO, first * sizeof(DrawData), count * sizeof(DrawData), &drawData[first]);
+    glNamedBufferSubData(boundsSSBO, 2 * first * sizeof(glm::vec4), 2 * count * sizeof(glm::vec4), &gpuBounds[2 * first]);
+}
+
+void DrawList::computeBounds(size_t i) {
+    const DrawablePart &part = *items[i].part;
+    const glm::mat4 &model = transforms[items[i].transform];
+
+    // Arvo, "Transforming Axis-Aligned Bounding Boxes"
+    glm::vec3 center = glm::vec3(model * glm::vec4(0.5f * (part.min + part.max), 1.0f));
+    glm::vec3 halfExtent = 0.5f * (part.max - part.min);
+    for (int c = 0; c < 3; c++) {
+        boundsCenter[c][i] = center[c];
+        boundsExtent[c][i] = abs(model[0][c]) * halfExtent.x + abs(model[1][c]) * halfExtent.y + abs(model[2][c]) * halfExtent.z;
+    }
+    glm::vec3 extent(boundsExtent[0][i], boundsExtent[1][i], boundsExtent[2][i]);
+    boundsMin[i] = center - extent;
+    boundsMax[i] = center + extent;
+    gpuBounds[2 * i] = glm::vec4(boundsMin[i], 1.0f);
+    gpuBounds[2 * i + 1] = glm::vec4(boundsMax[i], 1.0f);
+}
+
+void DrawList::reserveBuffers() {
+    if (items.size() <= capacity) {
+        return;
+    }
+
+    capacity = max(items.size(), capacity * 2);
+    if (commandBuffer == 0) {
+        glCreateBuffers(1, &commandBuffer);
+        glCreateBuffers(1, &drawDataSSBO);
+        glCreateBuffers(1, &culledCommandBuffer);
+        glCreateBuffers(1, &boundsSSBO);
+    }
+    glNamedBufferData(commandBuffer, capacity * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_DRAW);
+    glNamedBufferData(drawDataSSBO, capacity * sizeof(DrawData), nullptr, GL_DYNAMIC_DRAW);
+    glNamedBufferData(boundsSSBO, capacity * 2 * sizeof(glm::vec4), nullptr, GL_DYNAMIC_DRAW);
+}
+
+size_t DrawList::draw(GLShaderProgram &program, GLenum mode, const Frustum *frustum, Subset subset) {
+    if (commands.empty()) {
+        return 0;
+    }
+
+    if (frustum == nullptr && subset == ALL) {
+        submit(program, mode, commandBuffer, batches);
+        return commands.size();
+    }
+
+    visibleDraws.clear();
+    if (frustum == nullptr) {
+        for (size_t i = 0; i < commands.size(); i++) {
+            visibleDraws.push_back(i);
+        }
+    }
+    else if (useBVH) {
+        bvh.queryFrustum(*frustum, visibleDraws);
+        sort(visibleDraws.begin(), visibleDraws.end());
+    }
+    else {
+        const float *center[3] = { boundsCenter[0].data(), boundsCenter[1].data(), boundsCenter[2].data() };
+        const float *extent[3] = { boundsExtent[0].data(), boundsExtent[1].data(), boundsExtent[2].data() };
+        visible.resize(commands.size());
+        frustum->cullBoxes(center, extent, commands.size(), visible.data());
+        for (size_t i = 0; i < commands.size(); i++) {
+            if (visible[i]) {
+                visibleDraws.push_back(i);
+            }
+        }
+    }
+
+    // Compacted in order, so the draws stay grouped by index type
+    culledCommands.clear();
+    culledBatches.clear();
+    for (uint32_t i : visibleDraws) {
+        if (subset != ALL && dynamic[items[i].transform] != (subset == DYNAMIC)) {
+            continue;
+        }
+        GLenum indexType = items[i].drawable->indexType;
+        if (culledBatches.empty() || culledBatches.back().indexType != indexType) {
+            culledBatches.push_back({ indexType, culledCommands.size(), 0 });
+        }
+        culledBatches.back().count++;
+        culledCommands.push_back(commands[i]);
+    }
+
+    if (culledCommands.empty()) {
+        return 0;
+    }
+
+    // Orphaned, the previous pass may still be reading it
+    glNamedBufferData(culledCommandBuffer, capacity * sizeof(DrawElementsIndirectCommand), nullptr, GL_STREAM_DRAW);
+    glNamedBufferSubData(culledCommandBuffer, 0, culledCommands.size() * sizeof(DrawElementsIndirectCommand), culledCommands.data());
+
+    submit(program, mode, culledCommandBuffer, culledBatches);
+    return culledCommands.size();
+}
+
+void DrawList::drawIndirect(GLShaderProgram &program, GLuint indirectBuffer, GLenum mode) {
+    if (!commands.empty()) {
+        submit(program, mode, indirectBuffer, batches);
+    }
+}
+
+void DrawList::submit(GLShaderProgram &program, GLenum mode, GLuint indirectBuffer, const vector<Batch> &drawBatches) {
+    GeometryArena &arena = GeometryArena::getInstance();
+    arena.bind(commands.size());
+    MaterialTable &materials = MaterialTable::getInstance();
+    materials.bind(program);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, drawDataSSBO);
+
+    for (const Batch &batch : drawBatches) {
+        const void *offset = (const void *)(batch.first * sizeof(DrawElementsIndirectCommand));
+        glMultiDrawElementsIndirect(mode, batch.indexType, offset, batch.count, 0);
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, 0);
+    materials.unbind();
+    arena.unbind();
+}
@@ -0,0 +1,155 @@
+#ifndef DRAW_LIST_H
+#define DRAW_LIST_H
+
+#include <Graphics/opengl.h>
+#include <Graphics/GLShaderProgram.h>
+#include <Graphics/Frustum.h>
+#include <Graphics/BVH.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Mesh;
+struct Drawable;
+struct DrawablePart;
+
+// Per draw data read by shaders/vertex.glsl (std430, storage buffer binding 6)
+struct DrawData {
+    glm::mat4 model;
+    glm::vec3 vertexMin;
+    GLuint material;
+    glm::vec3 vertexExtent;
+    GLuint compactVertices;
+};
+static_assert(sizeof(DrawData) == 96, "DrawData must match the std430 layout in vertex.glsl");
+
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// Every drawable part in the scene as indirect commands into the GeometryArena. Materials come from the
+// MaterialTable, so draws are only grouped by index type, each group is one glMultiDrawElementsIndirect.
+// The list is retained: it is only rebuilt and sorted when the meshes added differ from the last frame,
+// otherwise only the draws of moved transforms are updated.
+// Passes can cull the parts against their own frustum by their world space bounding boxes, through a BVH
+// that is refit while the same draws only move and rebuilt when draws change or the refit tree degrades.
+class DrawList {
+public:
+    DrawList() {}
+    ~DrawList();
+
+    DrawList(const DrawList &other) = delete;
+    DrawList &operator=(const DrawList &other) = delete;
+
+    // Which draws a pass submits, by whether their mesh was added as dynamic
+    enum Subset { ALL, STATIC, DYNAMIC };
+
+    // World space box a mesh covered before and after moving
+    struct MovedBox {
+        glm::vec3 min, max;
+        bool dynamic;
+    };
+
+    // Starts adding the scene's meshes for this frame, in the same order every frame
+    void begin();
+    void addMesh(const Mesh &mesh, const glm::mat4 &model, bool dynamic = false);
+
+    // Rebuilds the draws if the meshes added changed, or updates the moved ones, once per frame after adding meshes
+    void upload();
+
+    // Draws the parts of subset intersecting frustum, or all of them without one. Returns the number of draws submitted.
+    size_t draw(GLShaderProgram &program, GLenum mode = GL_TRIANGLES, const Frustum *frustum = nullptr, Subset subset = ALL);
+    // Draws from commands written on the GPU, laid out like getCommandBuffer() (see OcclusionCulling)
+    void drawIndirect(GLShaderProgram &program, GLuint indirectBuffer, GLenum mode = GL_TRIANGLES);
+
+    size_t getDrawCount() const { return commands.size(); }
+    size_t getBatchCount() const { return batches.size(); }
+
+    // Over the world space bounds of the draws, for visibility and picking queries; items are draw indices
+    const BVH &getBVH() const { return bvh; }
+    size_t getBVHRebuildCount() const { return bvhRebuilds; }
+    // Times the draws were rebuilt and sorted
+    size_t getSortCount() const { return sorts; }
+    // Times the static draws changed other than by moving: the draws were rebuilt or invalidateStatic()
+    size_t getStaticChanges() const { return staticChanges; }
+    void invalidateStatic() { staticChanges++; }
+    // One per mesh that moved in the last upload(), none when it rebuilt the draws
+    const std::vector<MovedBox> &getMovedBoxes() const { return movedBoxes; }
+    // The addMesh call a draw came from, counted from the last begin()
+    size_t getDrawTransform(size_t draw) const { return items[draw].transform; }
+    // addMesh calls since the last begin(), the transforms are only trimmed to it by upload()
+    size_t getAddedMeshCount() const { return addedMeshes; }
+
+    // Every command in draw order, and their world space bounds as vec4 min, max pairs
+    GLuint getCommandBuffer() const { return commandBuffer; }
+    GLuint getBoundsBuffer() const { return boundsSSBO; }
+
+    // Cull through the BVH rather than testing every draw, read on each draw()
+    static bool useBVH;
+
+private:
+    struct Item {
+        const Mesh *mesh;
+        const Drawable *drawable;
+        const DrawablePart *part;
+        size_t transform;
+    };
+
+    struct Batch {
+        GLenum indexType;
+        size_t first, count;
+    };
+
+    // Sort key of a draw, most significant first: index type, mesh, material, part, transform
+    static uint64_t makeKey(GLenum indexType, size_t mesh, size_t material, size_t part, size_t transform);
+
+    void build();
+    void updateMoved();
+    void computeBounds(size_t draw);
+    void reserveBuffers();
+
+    // One per addMesh call
+    std::vector<const Mesh *> meshes;
+    std::vector<glm::mat4> transforms;
+    std::vector<uint8_t> moved, dynamic;
+    std::vector<MovedBox> movedBoxes;
+    std::vector<uint32_t> movedBoxIndex;
+    size_t addedMeshes = 0, staticChanges = 0;
+    bool meshesChanged = false, anyMoved = false;
+
+    std::vector<Item> items;
+    std::vector<uint64_t> keys, sortScratch;
+    std::vector<uint32_t> order, orderScratch;
+    size_t sorts = 0;
+
+    std::vector<Batch> batches;
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<DrawData> drawData;
+
+    // World space bounds of every draw, centers and half extents per component, padded to a multiple of 4
+    std::vector<float> boundsCenter[3], boundsExtent[3];
+    std::vector<glm::vec3> boundsMin, boundsMax;
+    std::vector<glm::vec4> gpuBounds;
+
+    BVH bvh;
+    size_t bvhRebuilds = 0;
+
+    // The draws of the last culled pass
+    std::vector<uint8_t> visible;
+    std::vector<uint32_t> visibleDraws;
+    std::vector<DrawElementsIndirectCommand> culledCommands;
+    std::vector<Batch> culledBatches;
+
+    void submit(GLShaderProgram &program, GLenum mode, GLuint indirectBuffer, const std::vector<Batch> &drawBatches);
+
+    GLuint commandBuffer = 0, drawDataSSBO = 0, culledCommandBuffer = 0, boundsSSBO = 0;
+    size_t capacity = 0;
+};
+
+#endif
@@ -0,0 +1,75 @@
+#include "FrameConstants.h"
+
+#include <cstring>
+#include <limits>
+
+using namespace std;
+
+static_assert(sizeof(FrameConstants::FrameData) == 368, "FrameData must match FrameBlock in shaders/frame.glsl");
+static_assert(sizeof(FrameConstants::VoxelData) == 320, "VoxelData must match VoxelBlock in shaders/frame.glsl");
+static_assert(sizeof(FrameConstants::SettingsData) == 192, "SettingsData must match SettingsBlock in shaders/frame.glsl");
+
+static GLintptr alignUp(GLintptr offset, GLintptr alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+FrameConstants::FrameConstants() {
+    memset(&frame, 0, sizeof(frame));
+    memset(&voxel, 0, sizeof(voxel));
+    memset(&settings, 0, sizeof(settings));
+}
+
+FrameConstants::~FrameConstants() {
+    for (GLsync fence : fences) {
+        if (fence) {
+            glDeleteSync(fence);
+        }
+    }
+    if (buffer) {
+        glUnmapNamedBuffer(buffer);
+        glDeleteBuffers(1, &buffer);
+    }
+}
+
+void FrameConstants::create() {
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+    voxelOffset = alignUp(sizeof(FrameData), alignment);
+    settingsOffset = alignUp(voxelOffset + sizeof(VoxelData), alignment);
+    slotSize = alignUp(settingsOffset + sizeof(SettingsData), alignment);
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glCreateBuffers(1, &buffer);
+    glObjectLabel(GL_BUFFER, buffer, -1, "Frame constants");
+    glNamedBufferStorage(buffer, RING_SIZE * slotSize, nullptr, flags);
+    mapped = (unsigned char *)glMapNamedBufferRange(buffer, 0, RING_SIZE * slotSize, flags);
+}
+
+void FrameConstants::upload() {
+    if (buffer == 0) {
+        create();
+    }
+
+    // The last slot is done being read once the commands of its frame are
+    if (slot >= 0) {
+        fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    slot = (slot + 1) % RING_SIZE;
+
+    if (fences[slot]) {
+        glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, numeric_limits<GLuint64>::max());
+        glDeleteSync(fences[slot]);
+        fences[slot] = nullptr;
+    }
+
+    GLintptr base = slot * slotSize;
+    memcpy(mapped + base, &frame, sizeof(FrameData));
+    memcpy(mapped + base + voxelOffset, &voxel, sizeof(VoxelData));
+    memcpy(mapped + base + settingsOffset, &settings, sizeof(SettingsData));
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_BINDING, buffer, base, sizeof(FrameData));
+    glBindBufferRange(GL_UNIFORM_BUFFER, VOXEL_BINDING, buffer, base + voxelOffset, sizeof(VoxelData));
+    glBindBufferRange(GL_UNIFORM_BUFFER, SETTINGS_BINDING, buffer, base + settingsOffset, sizeof(SettingsData));
+}
@@ -0,0 +1,104 @@
+#ifndef FRAME_CONSTANTS_H
+#define FRAME_CONSTANTS_H
+
+#include <Graphics/opengl.h>
+#include <glm/glm.hpp>
+
+// Frame, voxel and settings level constants shared by every program (shaders/frame.glsl). They are
+// written once per frame into a persistently mapped ring of uniform buffers and stay bound at fixed
+// binding points, so passes only set what is specific to them.
+class FrameConstants {
+public:
+    static const GLuint FRAME_BINDING = 0, VOXEL_BINDING = 1, SETTINGS_BINDING = 2;
+
+    // Frames in flight, a slot is only rewritten once the GPU is done with it
+    static const int RING_SIZE = 3;
+
+    // std140 layouts, must match shaders/frame.glsl. Booleans are GLint.
+    struct FrameData {
+        glm::mat4 projection;
+        glm::mat4 view;
+        glm::mat4 pv;
+        glm::mat4 ls;
+        glm::mat4 lsInverse;
+        glm::vec3 eye;
+        float pad0;
+        glm::vec3 lightPos;
+        float pad1;
+        glm::vec3 lightInt;
+        float pad2;
+    };
+
+    struct VoxelData {
+        glm::mat4 mvp_x, mvp_y, mvp_z;
+        glm::vec3 voxelMin;
+        GLint voxelDim;
+        glm::vec3 voxelMax;
+        GLint warpVoxels;
+        glm::vec3 voxelCenter;
+        GLint warpTexture;
+        GLint voxelizeTesselationWarp;
+        GLint voxelCascades, voxelLevels;
+        GLint voxelToroidal;
+        glm::ivec4 voxelScroll[4];  // VCT::MAX_CASCADES
+    };
+
+    struct SettingsData {
+        GLint voxelize, normals, dominant_axis, radiance;
+        GLint drawWarpSlope, drawOcclusion;
+        GLint debugOcclusion, debugIndirect, debugReflections;
+        GLint debugMaterialDiffuse, debugMaterialRoughness, debugMaterialMetallic;
+        GLint debugWarpTexture;
+        GLint toggle;
+
+        GLint cooktorrance;
+        GLint clusteredLighting;
+        GLint enablePostprocess, enableShadows, enableNormalMap, enableIndirect;
+        GLint enableDiffuse, enableSpecular, enableReflections;
+        GLfloat ambientScale, reflectScale;
+        GLfloat miplevel;
+
+        GLint vctSteps;
+        GLfloat vctConeAngle, vctBias, vctConeInitialHeight, vctLodOffset;
+        GLint vctSpecularSteps;
+        GLfloat vctSpecularConeAngle, vctSpecularBias, vctSpecularConeInitialHeight, vctSpecularLodOffset;
+        GLint vctSpecularConeAngleFromRoughness;
+
+        GLint axis_override;
+        GLint voxelizeDilate, voxelizeAtomicMax, voxelizeLighting;
+
+        GLint radianceLighting, radianceDilate, temporalFilterRadiance;
+        GLfloat temporalDecay;
+        GLfloat voxelSetOpacity;
+        GLint voxelOctree;
+        GLint pad;
+    };
+
+    FrameConstants();
+    ~FrameConstants();
+
+    FrameConstants(const FrameConstants &other) = delete;
+    FrameConstants &operator=(const FrameConstants &other) = delete;
+
+    // Filled in by the application before upload()
+    FrameData frame;
+    VoxelData voxel;
+    SettingsData settings;
+
+    // Writes the constants into the next slot of the ring and binds it
+    void upload();
+
+private:
+    void create();
+
+    GLuint buffer = 0;
+    unsigned char *mapped = nullptr;
+
+    // Offsets of each block within a slot and the size of a slot, aligned to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    GLintptr voxelOffset = 0, settingsOffset = 0, slotSize = 0;
+
+    GLsync fences[RING_SIZE] = {};
+    int slot = -1;
+};
+
+#endif
@@ -0,0 +1,105 @@
+#include "Frustum.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_SSE 1
+#include <xmmintrin.h>
+#endif
+
+#include <cmath>
+
+using namespace std;
+
+// Gribb and Hartmann, "Fast Extraction of Viewing Frustum Planes from the World-View-Projection Matrix"
+Frustum Frustum::fromMatrix(const glm::mat4 &viewProjection) {
+    glm::vec4 row[4];
+    for (int i = 0; i < 4; i++) {
+        row[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    }
+
+    Frustum frustum;
+    for (int i = 0; i < 3; i++) {
+        frustum.planes[2 * i] = row[3] + row[i];
+        frustum.planes[2 * i + 1] = row[3] - row[i];
+    }
+
+    // Normalized, so the box test compares actual distances
+    for (glm::vec4 &plane : frustum.planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+
+    return frustum;
+}
+
+Frustum Frustum::fromBox(const glm::vec3 &min, const glm::vec3 &max) {
+    Frustum frustum;
+    for (int i = 0; i < 3; i++) {
+        glm::vec3 normal(0.0f);
+        normal[i] = 1.0f;
+        frustum.planes[2 * i] = glm::vec4(normal, -min[i]);
+        frustum.planes[2 * i + 1] = glm::vec4(-normal, max[i]);
+    }
+    return frustum;
+}
+
+Frustum::Containment Frustum::classifyBox(const glm::vec3 &min, const glm::vec3 &max) const {
+    glm::vec3 center = 0.5f * (min + max), extent = 0.5f * (max - min);
+
+    Containment result = INSIDE;
+    for (const glm::vec4 &plane : planes) {
+        float distance = plane.w + glm::dot(glm::vec3(plane), center);
+        float radius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+        if (distance + radius < 0.0f) {
+            return OUTSIDE;
+        }
+        if (distance - radius < 0.0f) {
+            result = INTERSECTING;
+        }
+    }
+    return result;
+}
+
+// A box is outside a plane when its center is further behind it than the box's extent along the normal
+void Frustum::cullBoxes(const float *const center[3], const float *const extent[3], size_t count, uint8_t *visible) const {
+    size_t i = 0;
+#if FRUSTUM_SSE
+    __m128 planeNormal[6][3], planeAbsNormal[6][3], planeDistance[6];
+    for (int p = 0; p < 6; p++) {
+        for (int c = 0; c < 3; c++) {
+            planeNormal[p][c] = _mm_set1_ps(planes[p][c]);
+            planeAbsNormal[p][c] = _mm_set1_ps(abs(planes[p][c]));
+        }
+        planeDistance[p] = _mm_set1_ps(planes[p].w);
+    }
+
+    // Four boxes against all planes at a time
+    for (; i < count; i += 4) {
+        __m128 cx = _mm_loadu_ps(center[0] + i), cy = _mm_loadu_ps(center[1] + i), cz = _mm_loadu_ps(center[2] + i);
+        __m128 ex = _mm_loadu_ps(extent[0] + i), ey = _mm_loadu_ps(extent[1] + i), ez = _mm_loadu_ps(extent[2] + i);
+
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < 6; p++) {
+            __m128 distance = _mm_add_ps(planeDistance[p], _mm_add_ps(_mm_mul_ps(planeNormal[p][0], cx),
+                              _mm_add_ps(_mm_mul_ps(planeNormal[p][1], cy), _mm_mul_ps(planeNormal[p][2], cz))));
+            __m128 radius = _mm_add_ps(_mm_mul_ps(planeAbsNormal[p][0], ex),
+                            _mm_add_ps(_mm_mul_ps(planeAbsNormal[p][1], ey), _mm_mul_ps(planeAbsNormal[p][2], ez)));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+        }
+
+        int mask = _mm_movemask_ps(outside);
+        for (size_t j = 0; j < 4 && i + j < count; j++) {
+            visible[i + j] = !(mask & (1 << j));
+        }
+    }
+#endif
+
+    for (; i < count; i++) {
+        bool outside = false;
+        for (int p = 0; p < 6 && !outside; p++) {
+            const glm::vec4 &plane = planes[p];
+            float distance = plane.w + plane.x * center[0][i] + plane.y * center[1][i] + plane.z * center[2][i];
+            float radius = abs(plane.x) * extent[0][i] + abs(plane.y) * extent[1][i] + abs(plane.z) * extent[2][i];
+            outside = distance + radius < 0.0f;
+        }
+        visible[i] = !outside;
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+// Six planes bounding a view volume, normals point inwards: a point p is inside a plane when
+// dot(plane.xyz, p) + plane.w >= 0
+class Frustum {
+public:
+    enum Containment { OUTSIDE, INTERSECTING, INSIDE };
+
+    Frustum() {}
+
+    // The clip volume of a (perspective or orthographic) view projection matrix
+    static Frustum fromMatrix(const glm::mat4 &viewProjection);
+    // An axis aligned box, like the voxelization volume
+    static Frustum fromBox(const glm::vec3 &min, const glm::vec3 &max);
+
+    // Tests count boxes given by their centers and half extents, each component in its own array
+    // padded with readable values to a multiple of 4. Sets visible[i] to 1 for boxes intersecting
+    // the frustum and 0 for boxes entirely outside one of its planes.
+    void cullBoxes(const float *const center[3], const float *const extent[3], size_t count, uint8_t *visible) const;
+
+    // Whether a single box is outside, partially inside or entirely inside the frustum
+    Containment classifyBox(const glm::vec3 &min, const glm::vec3 &max) const;
+
+    glm::vec4 planes[6];
+};
+
+#endif
@@ -163,13 +163,14 @@ static void APIENTRY glDebugOutput(GLenum source, GLenum type, GLuint id, GLenum
 
 // Creates texture and loads it with data from provided image file.
 GLuint GLHelper::createTextureFromImage(const std::string &imagename) {
-    std::string file_extension = getExtension(imagename);
+    std::string filename = ResourceLoader::findCookedTexture(imagename);
+    std::string file_extension = getExtension(filename);
     if (file_extension == "dds") {
-        return ResourceLoader::loadDDS(imagename);
+        return ResourceLoader::loadDDS(filename);
     }
     else {
         int width, height, channels;
-        unsigned char *image = stbi_load(imagename.c_str(), &width, &height, &channels, STBI_default);
+        unsigned char *image = stbi_load(filename.c_str(), &width, &height, &channels, STBI_default);
         if (image == NULL) {
             LOG_ERROR("TEXTURE::LOAD_FAILED::", imagename);
         }
@@ -285,9 +286,19 @@ std::string &processGLSLInclude(std::string &s) {
 // Create a shader from the provided string.
 GLuint GLHelper::createShaderFromString(GLenum shaderType, std::string shaderString) {
     processGLSLInclude(shaderString);
+    return GLHelper::compileShader(shaderType, shaderString);
+}
+
+// Reads a shader file with its includes resolved, as it's passed to the compiler.
+std::string GLHelper::readShaderSource(const std::string &filename) {
+    std::string shaderString = GLHelper::readText(filename);
+    return processGLSLInclude(shaderString);
+}
 
+// Compile a shader from source with its includes already resolved.
+GLuint GLHelper::compileShader(GLenum shaderType, const std::string &source) {
     GLuint shader = glCreateShader(shaderType);
-    const char *shaderText = shaderString.c_str();
+    const char *shaderText = source.c_str();
     glShaderSource(shader, 1, &shaderText, NULL);
     glCompileShader(shader);
 
@@ -21,6 +21,8 @@ public:
     static std::string readText(const std::string &filename);
     static GLuint createShaderFromFile(GLenum shaderType, const std::string &filename);
     static GLuint createShaderFromString(GLenum shaderType, std::string shaderString);
+    static std::string readShaderSource(const std::string &filename);
+    static GLuint compileShader(GLenum shaderType, const std::string &source);
     static bool checkShaderStatus(GLuint shader);
     static bool checkShaderProgramStatus(GLuint program);
     static bool checkFramebufferComplete(GLuint fbo);
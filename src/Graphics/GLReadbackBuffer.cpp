@@ -0,0 +1,65 @@
+#include "GLReadbackBuffer.h"
+
+#include <cstring>
+
+GLReadbackBuffer::GLReadbackBuffer(const char *label, size_t size) : size(size) {
+    const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    for (Copy &copy : copies) {
+        glCreateBuffers(1, &copy.buffer);
+        glObjectLabel(GL_BUFFER, copy.buffer, -1, label);
+        glNamedBufferStorage(copy.buffer, size, nullptr, flags);
+        copy.ptr = glMapNamedBufferRange(copy.buffer, 0, size, flags);
+    }
+}
+
+GLReadbackBuffer::~GLReadbackBuffer() {
+    for (Copy &copy : copies) {
+        if (copy.fence != nullptr) {
+            glDeleteSync(copy.fence);
+        }
+        glUnmapNamedBuffer(copy.buffer);
+        glDeleteBuffers(1, &copy.buffer);
+    }
+}
+
+GLuint GLReadbackBuffer::beginWrite() {
+    // Only happens when nothing was read for a whole ring, the old copy isn't wanted anymore
+    Copy &copy = copies[head];
+    if (copy.fence != nullptr) {
+        glDeleteSync(copy.fence);
+        copy.fence = nullptr;
+    }
+    return copy.buffer;
+}
+
+void GLReadbackBuffer::endWrite() {
+    copies[head].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    head = (head + 1) % COPIES;
+}
+
+bool GLReadbackBuffer::read(void *data) {
+    // Newest first, fences signal in order so everything older than a finished copy is finished and stale
+    for (int i = 1; i <= COPIES; i++) {
+        Copy &copy = copies[(head + COPIES - i) % COPIES];
+        if (copy.fence == nullptr) {
+            continue;
+        }
+
+        GLenum status = glClientWaitSync(copy.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            continue;
+        }
+
+        memcpy(data, copy.ptr, size);
+        for (int j = i; j <= COPIES; j++) {
+            Copy &older = copies[(head + COPIES - j) % COPIES];
+            if (older.fence != nullptr) {
+                glDeleteSync(older.fence);
+                older.fence = nullptr;
+            }
+        }
+        return true;
+    }
+    return false;
+}
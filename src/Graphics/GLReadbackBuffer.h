@@ -0,0 +1,37 @@
+#ifndef GLREADBACK_BUFFER_H
+#define GLREADBACK_BUFFER_H
+
+#include <Graphics/opengl.h>
+#include <cstddef>
+
+// Reads small buffers written on the GPU back without stalling. Each write goes into the next of a ring
+// of persistently mapped buffers behind a fence, read() only takes copies whose fence has signaled.
+class GLReadbackBuffer {
+public:
+    static const int COPIES = 3;
+
+    GLReadbackBuffer(const char *label, size_t size);
+    ~GLReadbackBuffer();
+
+    GLReadbackBuffer(const GLReadbackBuffer &other) = delete;
+    GLReadbackBuffer &operator=(const GLReadbackBuffer &other) = delete;
+
+    // Returns the buffer to copy into, the copies must be issued before endWrite()
+    GLuint beginWrite();
+    void endWrite();
+
+    // Copies the newest finished write into data, returns false and leaves data alone if none finished
+    bool read(void *data);
+
+private:
+    struct Copy {
+        GLuint buffer = 0;
+        void *ptr = nullptr;
+        GLsync fence = nullptr;
+    };
+    Copy copies[COPIES];
+    int head = 0;
+    size_t size;
+};
+
+#endif
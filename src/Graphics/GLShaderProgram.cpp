@@ -3,8 +3,8 @@
 #include <string>
 #include <iostream>
 #include "GLShaderProgram.h"
-#include "GLShader.h"
 #include "GLHelper.h"
+#include "ShaderCache.h"
 #include <common.h>
 
 GLShaderProgram::GLShaderProgram() {
@@ -17,6 +17,9 @@ GLShaderProgram::GLShaderProgram(std::string label, std::initializer_list<const
 }
 
 GLShaderProgram::~GLShaderProgram() {
+    for (const auto &shader : compilingShaders) {
+        glDeleteShader(shader.second);
+    }
     glDeleteProgram(handle);
 }
 
@@ -24,31 +27,146 @@ GLShaderProgram &GLShaderProgram::attachShader(const std::string &shaderFile) {
     return attachShader(GLHelper::shaderTypeFromExtension(shaderFile), shaderFile);
 }
 
+// Shaders are compiled in linkProgram(), and only if the program isn't in the ShaderCache
 GLShaderProgram &GLShaderProgram::attachShader(GLenum shaderType, const std::string &shaderFile) {
-    GLShader shader { shaderType, shaderFile };
-    glAttachShader(handle, shader.getHandle());
+    pendingShaders.emplace_back(shaderType, shaderFile);
 
     return *this;
 }
 
 void GLShaderProgram::linkProgram() {
+    beginLink();
+    if (linking) {
+        finishLink();
+    }
+}
+
+// Only issues the compile and link, so with KHR_parallel_shader_compile the driver works on it in the
+// background until the status is queried
+void GLShaderProgram::beginLink() {
+    std::vector<ShaderCache::Source> sources;
+    for (const auto &shader : pendingShaders) {
+        sources.push_back(ShaderCache::Source {shader.first, shader.second, GLHelper::readShaderSource(shader.second)});
+
+        // Defines are part of the text, so the cache key covers them
+        std::string &text = sources.back().text;
+        size_t version = text.find("#version");
+        if (!defines.empty() && version != std::string::npos) {
+            text.insert(text.find('\n', version) + 1, defines);
+        }
+    }
+    pendingShaders.clear();
+
+    cacheKey = ShaderCache::computeKey(sources);
+    if (ShaderCache::load(handle, cacheKey)) {
+        linkStatus = true;
+        buildUniformTable();
+        return;
+    }
+
+    for (const ShaderCache::Source &source : sources) {
+        GLuint shader = glCreateShader(source.type);
+        const char *text = source.text.c_str();
+        glShaderSource(shader, 1, &text, NULL);
+        glCompileShader(shader);
+        glObjectLabel(GL_SHADER, shader, source.filename.size(), source.filename.c_str());
+        glAttachShader(handle, shader);
+        compilingShaders.emplace_back(source.filename, shader);
+    }
+
+    glProgramParameteri(handle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(handle);
+    linking = true;
+}
+
+bool GLShaderProgram::isReady() {
+    if (!linking) {
+        return true;
+    }
+
+    if (GLAD_GL_KHR_parallel_shader_compile || GLAD_GL_ARB_parallel_shader_compile) {
+        GLint completed = GL_FALSE;
+        glGetProgramiv(handle, GL_COMPLETION_STATUS_KHR, &completed);
+        if (!completed) {
+            return false;
+        }
+    }
+
+    finishLink();
+    return true;
+}
+
+void GLShaderProgram::finishLink() {
+    linking = false;
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(handle, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        for (const auto &shader : compilingShaders) {
+            if (!GLHelper::checkShaderStatus(shader.second)) {
+                LOG_ERROR("\tin shader ", shader.first);
+            }
+        }
+    }
     linkStatus = GLHelper::checkShaderProgramStatus(handle);
 
+    for (const auto &shader : compilingShaders) {
+        glDetachShader(handle, shader.second);
+        glDeleteShader(shader.second);
+    }
+    compilingShaders.clear();
+
     if (linkStatus) {
-        GLint uniformCount, uniformMaxLength;
-        glGetProgramiv(handle, GL_ACTIVE_UNIFORMS, &uniformCount);
-        glGetProgramiv(handle, GL_ACTIVE_UNIFORM_MAX_LENGTH, &uniformMaxLength);
-
-        for (int i = 0; i < uniformCount; i++) {
-            GLsizei length = 0;
-            GLint location = 0, size = 0;
-            GLenum type = GL_NONE;
-            std::vector<GLchar> name(uniformMaxLength);
-            glGetActiveUniform(handle, i, uniformMaxLength, &length, &size, &type, name.data());
-            location = glGetUniformLocation(handle, name.data());
-            uniforms[name.data()] = location;
+        ShaderCache::store(handle, cacheKey);
+        buildUniformTable();
+    }
+}
+
+void GLShaderProgram::buildUniformTable() {
+    GLint uniformCount, uniformMaxLength;
+    glGetProgramiv(handle, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(handle, GL_ACTIVE_UNIFORM_MAX_LENGTH, &uniformMaxLength);
+
+    std::vector<std::pair<std::string, GLint>> active;
+    std::vector<GLchar> name(uniformMaxLength);
+    for (int i = 0; i < uniformCount; i++) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = GL_NONE;
+        glGetActiveUniform(handle, i, uniformMaxLength, &length, &size, &type, name.data());
+
+        // Members of uniform blocks have no location
+        GLint location = glGetUniformLocation(handle, name.data());
+        if (location == -1) {
+            continue;
+        }
+
+        std::string uniform(name.data(), length);
+        active.emplace_back(uniform, location);
+
+        // Arrays are listed as "name[0]", they're also set by their name
+        if (uniform.size() > 3 && uniform.compare(uniform.size() - 3, 3, "[0]") == 0) {
+            active.emplace_back(uniform.substr(0, uniform.size() - 3), location);
+        }
+    }
+
+    size_t tableSize = 1;
+    while (tableSize < 2 * active.size()) {
+        tableSize *= 2;
+    }
+    uniformTable.assign(tableSize, UniformSlot {0, -1});
+
+    size_t mask = tableSize - 1;
+    for (const auto &uniform : active) {
+        uint64_t hash = UniformID::fnv1a(uniform.first.data(), uniform.first.size());
+        size_t i = hash & mask;
+        while (uniformTable[i].hash != 0 && uniformTable[i].hash != hash) {
+            i = (i + 1) & mask;
         }
+        if (uniformTable[i].hash == hash) {
+            LOG_ERROR("Uniform name hash collision for ", uniform.first);
+        }
+        uniformTable[i] = UniformSlot {hash, uniform.second};
     }
 }
 
@@ -75,12 +193,3 @@ void GLShaderProgram::setObjectLabel(const std::string &label) {
     glObjectLabel(GL_PROGRAM, handle, label.size(), label.c_str());
     this->label = label;
 }
-
-GLint GLShaderProgram::uniformLocation(const GLchar *name) const {
-    if (uniforms.count(name) == 0) {
-        // This should only happen for non-active uniforms (e.g. optimized out)
-        return -1;
-    }
-
-    return uniforms.at(name);
-}
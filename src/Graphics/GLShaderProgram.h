@@ -5,8 +5,37 @@
 #include <string>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <cstdint>
+#include <cstring>
 #include <initializer_list>
-#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Uniform name hashed with 64 bit FNV-1a. String literals convert implicitly and hash at compile time
+// when the UniformID is constexpr (and in practice whenever the call is inlined), so setting a uniform
+// doesn't allocate or hash strings at runtime.
+class UniformID {
+public:
+    template <size_t N>
+    constexpr UniformID(const char (&name)[N]) : hash(fnv1a(name, N - 1)) {}
+
+    // For names only known at runtime
+    static UniformID fromName(const char *name) { return UniformID(fnv1a(name, strlen(name)), 0); }
+
+    static constexpr uint64_t fnv1a(const char *s, size_t length) {
+        uint64_t h = 14695981039346656037ull;
+        for (size_t i = 0; i < length; i++) {
+            h = (h ^ (uint8_t)s[i]) * 1099511628211ull;
+        }
+        // 0 marks an empty slot in the uniform tables
+        return h != 0 ? h : 1;
+    }
+
+    uint64_t hash;
+
+private:
+    constexpr UniformID(uint64_t hash, int) : hash(hash) {}
+};
 
 class GLShaderProgram {
 public:
@@ -26,27 +55,91 @@ public:
     void attachAndLink(std::initializer_list<const std::string> shaderFiles);
     GLuint getHandle() const;
 
+    // Starts compiling and linking the attached shaders without waiting for the driver
+    void beginLink();
+    // True once the link started by beginLink() is done, whether it succeeded or not. Only blocks
+    // without KHR_parallel_shader_compile, where the completion can't be polled.
+    bool isReady();
+    bool isLinked() const { return linkStatus; }
+
+    // Preprocessor lines inserted after the #version of every shader at the next link
+    void setDefines(const std::string &defines) { this->defines = defines; }
+
     void bind() const;
     void unbind() const;
 
-    GLint uniformLocation(const GLchar *name) const;
+    // -1 for uniforms that aren't active (e.g. optimized out)
+    GLint uniformLocation(UniformID id) const {
+        if (uniformTable.empty()) {
+            return -1;
+        }
+        size_t mask = uniformTable.size() - 1;
+        for (size_t i = id.hash & mask; ; i = (i + 1) & mask) {
+            if (uniformTable[i].hash == id.hash) {
+                return uniformTable[i].location;
+            }
+            if (uniformTable[i].hash == 0) {
+                return -1;
+            }
+        }
+    }
 
-    void setUniform1f(const GLchar *name, GLfloat v) { glUniform1f(uniformLocation(name), v); }
-    void setUniform2f(const GLchar *name, GLfloat x, GLfloat y) { glUniform2f(uniformLocation(name), x, y); }
-    void setUniform1i(const GLchar *name, GLint v) { glUniform1i(uniformLocation(name), v); }
-    void setUniform1ui(const GLchar *name, GLuint v) { glUniform1ui(uniformLocation(name), v); }
-    void setUniform3fv(const GLchar *name, const glm::vec3 &v) { glUniform3fv(uniformLocation(name), 1, glm::value_ptr(v)); }
-    void setUniform3fv(const GLchar *name, GLsizei count, const GLfloat *v) { glUniform3fv(uniformLocation(name), count, v); }
-    void setUniformMatrix4fv(const GLchar *name, const glm::mat4 &v) { glUniformMatrix4fv(uniformLocation(name), 1, GL_FALSE, glm::value_ptr(v)); }
+    void setUniform1f(UniformID id, GLfloat v) { glUniform1f(uniformLocation(id), v); }
+    void setUniform2f(UniformID id, GLfloat x, GLfloat y) { glUniform2f(uniformLocation(id), x, y); }
+    void setUniform1i(UniformID id, GLint v) { glUniform1i(uniformLocation(id), v); }
+    void setUniform1ui(UniformID id, GLuint v) { glUniform1ui(uniformLocation(id), v); }
+    void setUniform3iv(UniformID id, const glm::ivec3 &v) { glUniform3iv(uniformLocation(id), 1, glm::value_ptr(v)); }
+    void setUniform3fv(UniformID id, const glm::vec3 &v) { glUniform3fv(uniformLocation(id), 1, glm::value_ptr(v)); }
+    void setUniform3fv(UniformID id, GLsizei count, const GLfloat *v) { glUniform3fv(uniformLocation(id), count, v); }
+    void setUniformMatrix4fv(UniformID id, const glm::mat4 &v) { glUniformMatrix4fv(uniformLocation(id), 1, GL_FALSE, glm::value_ptr(v)); }
 
     void setObjectLabel(const std::string &label);
     const std::string &getObjectLabel() const { return label; }
 
 private:
+    void finishLink();
+    void buildUniformTable();
+
     GLuint handle;
-    std::unordered_map<std::string, GLint> uniforms;
+
+    // Type and file of the shaders attached since the last link
+    std::vector<std::pair<GLenum, std::string>> pendingShaders;
+
+    // File and handle of the shaders of a link in progress
+    std::vector<std::pair<std::string, GLuint>> compilingShaders;
+    bool linking = false;
+    uint64_t cacheKey = 0;
+    std::string defines;
+
+    // Open addressing table of the active uniforms, filled at link. Its size is a power of two at
+    // least twice the uniform count, which keeps the probe sequences short.
+    struct UniformSlot {
+        uint64_t hash;
+        GLint location;
+    };
+    std::vector<UniformSlot> uniformTable;
     bool linkStatus = false;
     std::string label;
 };
 
+// Location of one uniform cached at the call site, for uniforms set every draw or dispatch.
+// Looked up again when used with another program.
+class CachedUniform {
+public:
+    constexpr CachedUniform(UniformID id) : id(id) {}
+
+    GLint get(const GLShaderProgram &program) {
+        if (program.getHandle() != handle) {
+            handle = program.getHandle();
+            location = program.uniformLocation(id);
+        }
+        return location;
+    }
+
+private:
+    UniformID id;
+    GLuint handle = 0;
+    GLint location = -1;
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "GeometryArena.h"
+
+#include <common.h>
+
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+static const size_t MIN_CAPACITY = 1 << 20;
+static const size_t MIN_DRAW_IDS = 1024;
+
+GeometryArena &GeometryArena::getInstance() {
+    static GeometryArena arena;
+    return arena;
+}
+
+GeometryArena::~GeometryArena() {
+    GLuint buffers[] = { vertexBuffer, indexBuffer, drawIDBuffer };
+    glDeleteBuffers(3, buffers);
+    glDeleteVertexArrays(1, &vao);
+}
+
+void GeometryArena::grow(GLuint &buffer, size_t &capacity, size_t used, size_t required) {
+    if (required <= capacity) {
+        return;
+    }
+
+    size_t newCapacity = max(max(required, capacity * 2), MIN_CAPACITY);
+    GLuint newBuffer = 0;
+    glCreateBuffers(1, &newBuffer);
+    glNamedBufferStorage(newBuffer, newCapacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+    if (buffer != 0) {
+        glCopyNamedBufferSubData(buffer, newBuffer, 0, 0, used);
+        glDeleteBuffers(1, &buffer);
+    }
+
+    buffer = newBuffer;
+    capacity = newCapacity;
+}
+
+GLint GeometryArena::addVertices(const void *data, size_t count, size_t stride) {
+    // aligned to the stride so the base vertex is exact
+    GLint baseVertex = (vertexUsed + stride - 1) / stride;
+    size_t offset = baseVertex * stride;
+
+    grow(vertexBuffer, vertexCapacity, vertexUsed, offset + count * stride);
+    glNamedBufferSubData(vertexBuffer, offset, count * stride, data);
+    vertexUsed = offset + count * stride;
+
+    return baseVertex;
+}
+
+GLuint GeometryArena::addIndices(const void *data, size_t count, GLenum type) {
+    size_t indexSize = type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+    GLuint firstIndex = (indexUsed + indexSize - 1) / indexSize;
+    size_t offset = firstIndex * indexSize;
+
+    GLuint previousBuffer = indexBuffer;
+    grow(indexBuffer, indexCapacity, indexUsed, offset + count * indexSize);
+    glNamedBufferSubData(indexBuffer, offset, count * indexSize, data);
+    indexUsed = offset + count * indexSize;
+
+    if (vao != 0 && indexBuffer != previousBuffer) {
+        glVertexArrayElementBuffer(vao, indexBuffer);
+    }
+
+    return firstIndex;
+}
+
+void GeometryArena::bind(size_t drawCount) {
+    if (vao == 0) {
+        glCreateVertexArrays(1, &vao);
+        glEnableVertexArrayAttrib(vao, 0);
+        glVertexArrayAttribIFormat(vao, 0, 1, GL_UNSIGNED_INT, 0);
+        glVertexArrayAttribBinding(vao, 0, 0);
+        glVertexArrayBindingDivisor(vao, 0, 1);
+        glVertexArrayElementBuffer(vao, indexBuffer);
+    }
+
+    // With a divisor of 1 the attribute reads element baseInstance, which is the index of the draw
+    if (drawCount > drawIDCapacity) {
+        drawIDCapacity = max(max(drawCount, drawIDCapacity * 2), MIN_DRAW_IDS);
+
+        vector<GLuint> ids(drawIDCapacity);
+        for (size_t i = 0; i < ids.size(); i++) {
+            ids[i] = i;
+        }
+
+        glDeleteBuffers(1, &drawIDBuffer);
+        glCreateBuffers(1, &drawIDBuffer);
+        glNamedBufferStorage(drawIDBuffer, ids.size() * sizeof(GLuint), ids.data(), 0);
+        glVertexArrayVertexBuffer(vao, 0, drawIDBuffer, 0, sizeof(GLuint));
+    }
+
+    glBindVertexArray(vao);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, vertexBuffer);
+}
+
+void GeometryArena::unbind() const {
+    glBindVertexArray(0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, 0);
+}
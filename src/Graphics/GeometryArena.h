@@ -0,0 +1,41 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <Graphics/opengl.h>
+
+#include <cstddef>
+
+// One vertex buffer and one index buffer shared by every loaded mesh, so a whole pass can be
+// drawn with glMultiDrawElementsIndirect. Meshes are never unloaded, allocations only grow
+// the buffers (by copying into a larger buffer).
+class GeometryArena {
+public:
+    static GeometryArena &getInstance();
+
+    ~GeometryArena();
+
+    GeometryArena(const GeometryArena &other) = delete;
+    GeometryArena &operator=(const GeometryArena &other) = delete;
+
+    // Returns the base vertex of the data, in units of stride (bytes, a multiple of 4)
+    GLint addVertices(const void *data, size_t count, size_t stride);
+    // Returns the first index of the data, in units of the index type (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT)
+    GLuint addIndices(const void *data, size_t count, GLenum type);
+
+    // Binds the vao and the vertex buffer (storage buffer binding 5) for indirect draws.
+    // The vao sources the instanced drawID attribute from an identity buffer of at least drawCount entries.
+    void bind(size_t drawCount);
+    void unbind() const;
+
+private:
+    GeometryArena() {}
+
+    static void grow(GLuint &buffer, size_t &capacity, size_t used, size_t required);
+
+    GLuint vao = 0, vertexBuffer = 0, indexBuffer = 0, drawIDBuffer = 0;
+    size_t vertexCapacity = 0, vertexUsed = 0;
+    size_t indexCapacity = 0, indexUsed = 0;
+    size_t drawIDCapacity = 0;
+};
+
+#endif
@@ -0,0 +1,58 @@
+#include "LightClusters.h"
+
+#include <cmath>
+
+LightClusters::LightClusters() : cullProgram {"Cull Lights", {SHADER_DIR "cullLights.comp"}} {
+    glCreateBuffers(1, &clusterSSBO);
+    glNamedBufferStorage(clusterSSBO, CLUSTER_COUNT * 2 * sizeof(GLuint), nullptr, 0);
+
+    // Worst case of every cluster full, after the counter
+    glCreateBuffers(1, &lightIndexSSBO);
+    glNamedBufferStorage(lightIndexSSBO, (1 + CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER) * sizeof(GLuint), nullptr, GL_DYNAMIC_STORAGE_BIT);
+}
+
+LightClusters::~LightClusters() {
+    GLuint buffers[] = { clusterSSBO, lightIndexSSBO };
+    glDeleteBuffers(2, buffers);
+}
+
+void LightClusters::cull(const glm::mat4 &view, const glm::mat4 &projection, float near, float far, int width, int height) {
+    this->near = near;
+    this->far = far;
+    tileSize = glm::vec2(std::ceil((float)width / CLUSTER_X), std::ceil((float)height / CLUSTER_Y));
+
+    glClearNamedBufferSubData(lightIndexSSBO, GL_R32UI, 0, sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+    cullProgram.bind();
+    cullProgram.setUniformMatrix4fv("view", view);
+    cullProgram.setUniformMatrix4fv("inverseProjection", glm::inverse(projection));
+    cullProgram.setUniform2f("screenSize", width, height);
+    setUniforms(cullProgram);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, clusterSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, lightIndexSSBO);
+
+    glDispatchCompute((CLUSTER_COUNT + 128 - 1) / 128, 1, 1);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, 0);
+    cullProgram.unbind();
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void LightClusters::bind(GLShaderProgram &program) const {
+    setUniforms(program);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, clusterSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, lightIndexSSBO);
+}
+
+void LightClusters::unbind() const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, 0);
+}
+
+void LightClusters::setUniforms(GLShaderProgram &program) const {
+    program.setUniform2f("clusterTileSize", tileSize.x, tileSize.y);
+    program.setUniform1f("clusterNear", near);
+    program.setUniform1f("clusterFar", far);
+}
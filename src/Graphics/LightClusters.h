@@ -0,0 +1,40 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <Graphics/opengl.h>
+#include <Graphics/GLShaderProgram.h>
+#include <glm/glm.hpp>
+
+// Bins the scene lights into view frustum clusters (shaders/cullLights.comp), so shading only loops
+// over the lights whose range reaches the cluster of a fragment (shaders/clusters.glsl).
+class LightClusters {
+public:
+    // Must match shaders/clusters.glsl and cullLights.comp
+    static const GLuint CLUSTER_X = 16, CLUSTER_Y = 9, CLUSTER_Z = 24;
+    static const GLuint CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+    static const GLuint MAX_LIGHTS_PER_CLUSTER = 128;
+
+    LightClusters();
+    ~LightClusters();
+
+    LightClusters(const LightClusters &other) = delete;
+    LightClusters &operator=(const LightClusters &other) = delete;
+
+    // Rebuilds the light lists of every cluster, expects the lights bound to storage buffer binding 3
+    void cull(const glm::mat4 &view, const glm::mat4 &projection, float near, float far, int width, int height);
+
+    // Binds the light lists (storage buffer bindings 8 and 9) and sets the cluster uniforms
+    void bind(GLShaderProgram &program) const;
+    void unbind() const;
+
+private:
+    void setUniforms(GLShaderProgram &program) const;
+
+    GLShaderProgram cullProgram;
+    GLuint clusterSSBO = 0, lightIndexSSBO = 0;
+
+    glm::vec2 tileSize { 1.0f };
+    float near = 0.1f, far = 100.0f;
+};
+
+#endif
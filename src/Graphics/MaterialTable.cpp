@@ -0,0 +1,209 @@
+#include "MaterialTable.h"
+
+#include <common.h>
+
+#include <algorithm>
+
+using namespace std;
+
+// Must match materialArrays in shaders/material.glsl
+static const size_t MATERIAL_ARRAY_COUNT = 8;
+static const GLuint FIRST_ARRAY_UNIT = 11;
+
+bool MaterialTable::useBindless = true;
+
+MaterialTable &MaterialTable::getInstance() {
+    static MaterialTable table;
+    return table;
+}
+
+MaterialTable::MaterialTable() {
+    bindless = useBindless && GLAD_GL_ARB_bindless_texture;
+
+    GLint maxUnits = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &maxUnits);
+    maxArrays = min(MATERIAL_ARRAY_COUNT, (size_t)max(maxUnits - (GLint)FIRST_ARRAY_UNIT, 0));
+
+    LOG_INFO("Material textures: ", bindless ? "bindless" : "texture arrays");
+}
+
+MaterialTable::~MaterialTable() {
+    for (GLuint64 handle : residentHandles) {
+        glMakeTextureHandleNonResidentARB(handle);
+    }
+    for (TextureArray &array : arrays) {
+        glDeleteTextures(1, &array.texture);
+    }
+    glDeleteBuffers(1, &ssbo);
+}
+
+GLuint MaterialTable::add(size_t count) {
+    GLuint first = materials.size();
+    materials.resize(materials.size() + count);
+    return first;
+}
+
+void MaterialTable::setMaterial(GLuint index, const Material &material) {
+    MaterialData &m = materials[index];
+    m.ambient = material.ambient;
+    m.shininess = material.shininess;
+    m.diffuse = material.diffuse;
+    m.roughness = material.roughness;
+    m.specular = material.specular;
+    m.metallic = material.metallic;
+
+    dirtyBegin = dirtyBegin == dirtyEnd ? index : min(dirtyBegin, (size_t)index);
+    dirtyEnd = max(dirtyEnd, (size_t)index + 1);
+}
+
+void MaterialTable::setTexture(GLuint index, TextureSlot slot, GLuint texture) {
+    materials[index].textures[slot] = texture != 0 ? getReference(texture) : glm::uvec2(0);
+
+    dirtyBegin = dirtyBegin == dirtyEnd ? index : min(dirtyBegin, (size_t)index);
+    dirtyEnd = max(dirtyEnd, (size_t)index + 1);
+}
+
+glm::uvec2 MaterialTable::getReference(GLuint texture) {
+    auto it = references.find(texture);
+    if (it != references.end()) {
+        return it->second;
+    }
+
+    glm::uvec2 reference;
+    if (bindless) {
+        // the texture's parameters are frozen from here on
+        GLuint64 handle = glGetTextureHandleARB(texture);
+        glMakeTextureHandleResidentARB(handle);
+        residentHandles.push_back(handle);
+        reference = glm::uvec2(handle & 0xffffffff, handle >> 32);
+    }
+    else {
+        reference = addToArray(texture);
+    }
+
+    references[texture] = reference;
+    return reference;
+}
+
+// Copies the texture into an array of the same format and size. Once every array unit is taken,
+// textures whose lower mip levels match an existing array are copied from that level on.
+glm::uvec2 MaterialTable::addToArray(GLuint texture) {
+    GLint width = 0, height = 0, format = 0, levels = 0;
+    glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_HEIGHT, &height);
+    glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+    glGetTextureParameteriv(texture, GL_TEXTURE_IMMUTABLE_LEVELS, &levels);
+
+    size_t best = arrays.size();
+    GLint bestSkip = levels;
+    for (size_t i = 0; i < arrays.size(); i++) {
+        const TextureArray &array = arrays[i];
+        if (array.format != (GLenum)format) {
+            continue;
+        }
+
+        for (GLint skip = 0; skip < bestSkip; skip++) {
+            if (max(width >> skip, 1) == array.width && max(height >> skip, 1) == array.height
+                && levels - skip >= array.levels) {
+                best = i;
+                bestSkip = skip;
+                break;
+            }
+        }
+    }
+
+    if (bestSkip > 0 && arrays.size() < maxArrays) {
+        TextureArray array;
+        array.format = format;
+        array.width = width;
+        array.height = height;
+        array.levels = levels;
+        arrays.push_back(array);
+
+        best = arrays.size() - 1;
+        bestSkip = 0;
+    }
+
+    if (best == arrays.size()) {
+        LOG_WARN("No texture array fits texture ", texture, " (", width, "x", height, "), it is not used");
+        return glm::uvec2(0);
+    }
+
+    TextureArray &array = arrays[best];
+    if (array.layers == array.capacity) {
+        growArray(array);
+    }
+
+    GLint layer = array.layers++;
+    for (GLint level = 0; level < array.levels; level++) {
+        glCopyImageSubData(texture, GL_TEXTURE_2D, level + bestSkip, 0, 0, 0,
+                           array.texture, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer,
+                           max(array.width >> level, 1), max(array.height >> level, 1), 1);
+    }
+
+    return glm::uvec2(best + 1, layer);
+}
+
+void MaterialTable::growArray(TextureArray &array) {
+    GLsizei capacity = max(array.capacity * 2, 4);
+
+    GLuint texture = 0;
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture);
+    glTextureStorage3D(texture, array.levels, array.format, array.width, array.height, capacity);
+
+    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTextureParameteri(texture, GL_TEXTURE_MAX_LEVEL, array.levels - 1);
+
+    if (GLAD_GL_EXT_texture_filter_anisotropic) {
+        float maxAnisotropy = 1.0f;
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &maxAnisotropy);
+        glTextureParameterf(texture, GL_TEXTURE_MAX_ANISOTROPY, maxAnisotropy);
+    }
+
+    if (array.texture != 0) {
+        for (GLint level = 0; level < array.levels; level++) {
+            glCopyImageSubData(array.texture, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+                               texture, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+                               max(array.width >> level, 1), max(array.height >> level, 1), array.layers);
+        }
+        glDeleteTextures(1, &array.texture);
+    }
+
+    array.texture = texture;
+    array.capacity = capacity;
+}
+
+void MaterialTable::bind(GLShaderProgram &program) {
+    if (materials.size() > capacity) {
+        capacity = max(materials.size(), capacity * 2);
+        if (ssbo == 0) {
+            glCreateBuffers(1, &ssbo);
+        }
+        glNamedBufferData(ssbo, capacity * sizeof(MaterialData), nullptr, GL_DYNAMIC_DRAW);
+
+        dirtyBegin = 0;
+        dirtyEnd = materials.size();
+    }
+
+    if (dirtyBegin < dirtyEnd) {
+        glNamedBufferSubData(ssbo, dirtyBegin * sizeof(MaterialData), (dirtyEnd - dirtyBegin) * sizeof(MaterialData),
+                             &materials[dirtyBegin]);
+        dirtyBegin = dirtyEnd = 0;
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, ssbo);
+    program.setUniform1i("bindlessMaterials", bindless);
+    for (size_t i = 0; i < arrays.size(); i++) {
+        glBindTextureUnit(FIRST_ARRAY_UNIT + i, arrays[i].texture);
+    }
+}
+
+void MaterialTable::unbind() const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, 0);
+    for (size_t i = 0; i < arrays.size(); i++) {
+        glBindTextureUnit(FIRST_ARRAY_UNIT + i, 0);
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef MATERIAL_TABLE_H
+#define MATERIAL_TABLE_H
+
+#include <Graphics/opengl.h>
+#include <Graphics/GLShaderProgram.h>
+#include <Graphics/Mesh.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+// Every material of every loaded mesh in one storage buffer (binding 7, shaders/material.glsl),
+// indexed by DrawData::material, so draws don't break on material changes.
+// Textures are referenced by ARB_bindless_texture handles when supported. Otherwise they are
+// copied into sampler2DArrays of same size and format, referenced by (array + 1, layer).
+class MaterialTable {
+public:
+    // Texture slots in the order of Mesh's MATERIAL_TEXTURE_SLOTS
+    enum TextureSlot { DIFFUSE, SPECULAR, NORMAL, ROUGHNESS, METALLIC, ALPHA, TEXTURE_SLOT_COUNT };
+
+    // Matches Material in shaders/material.glsl (std430)
+    struct MaterialData {
+        glm::vec3 ambient;
+        float shininess;
+        glm::vec3 diffuse;
+        float roughness;
+        glm::vec3 specular;
+        float metallic;
+        glm::uvec2 textures[TEXTURE_SLOT_COUNT];
+    };
+    static_assert(sizeof(MaterialData) == 96, "MaterialData must match the std430 layout in material.glsl");
+
+    static MaterialTable &getInstance();
+
+    ~MaterialTable();
+
+    MaterialTable(const MaterialTable &other) = delete;
+    MaterialTable &operator=(const MaterialTable &other) = delete;
+
+    // Reserves count materials, returns the index of the first
+    GLuint add(size_t count);
+    // Writes everything but the textures
+    void setMaterial(GLuint index, const Material &material);
+    // texture must be complete, 0 clears the slot
+    void setTexture(GLuint index, TextureSlot slot, GLuint texture);
+
+    // Uploads changed materials and binds the buffer and texture arrays
+    void bind(GLShaderProgram &program);
+    void unbind() const;
+
+    bool isBindless() const { return bindless; }
+
+    // Prefer bindless textures when the driver supports them, read when the table is created
+    static bool useBindless;
+
+private:
+    struct TextureArray {
+        GLuint texture = 0;
+        GLenum format = 0;
+        GLsizei width = 0, height = 0, levels = 0;
+        GLsizei layers = 0, capacity = 0;
+    };
+
+    MaterialTable();
+
+    glm::uvec2 getReference(GLuint texture);
+    glm::uvec2 addToArray(GLuint texture);
+    static void growArray(TextureArray &array);
+
+    bool bindless = false;
+    size_t maxArrays = 0;
+
+    std::vector<MaterialData> materials;
+    size_t dirtyBegin = 0, dirtyEnd = 0;
+
+    std::unordered_map<GLuint, glm::uvec2> references;
+    std::vector<GLuint64> residentHandles;
+    std::vector<TextureArray> arrays;
+
+    GLuint ssbo = 0;
+    size_t capacity = 0;
+};
+
+#endif
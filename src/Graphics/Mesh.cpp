@@ -12,22 +12,108 @@
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
 #include <chrono>
 #include <limits>
 
-#define TINYOBJLOADER_IMPLEMENTATION
+#include <sys/stat.h>
+
 #include <tiny_obj_loader.h>
 
 #include <stb_image.h>
 
-#include <unordered_map>
 #include <common.h>
+#include <MappedFile.h>
+#include <Graphics/VertexIndexMap.h>
+#include <Graphics/GeometryArena.h>
+#include <Graphics/MaterialTable.h>
+#include <Graphics/MeshOptimizer.h>
+#include <Graphics/ObjLoader.h>
+#include <Graphics/TextureStreamer.h>
+#include <ThreadPool.h>
 
 using namespace std;
 using namespace tinyobj;
 
 static const char *DEFAULT_TEXTURE = "default_texture.png";
 
+bool Mesh::useCompactVertices = true;
+
+// How much the ACMR may grow when sorting triangle clusters for overdraw, 0 disables the sort
+static const float OVERDRAW_THRESHOLD = 1.05f;
+
+// Cooked mesh layout: header, material libraries, materials, drawables, drawable parts, vertices, indices, string table.
+// Every section starts on a 16 byte boundary. Vertices and indices are stored as uploaded, packed and
+// narrowed, so the mapping is handed to the GeometryArena as is.
+static const char COOKED_MESH_MAGIC[4] = { 'V', 'C', 'T', 'M' };
+static const uint32_t COOKED_MESH_VERSION = 5;
+static const uint32_t COOKED_NO_STRING = 0xffffffff;
+
+struct CookedMeshHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t vertexSize; // sizeof(PackedVertex) or sizeof(Vertex) when cooked, catches layout changes
+    uint32_t compactVertices;
+    uint32_t materialLibraryCount, materialCount, drawableCount;
+    uint32_t vertexCount, partCount;
+    uint64_t indicesSize, stringsSize; // in bytes
+    uint64_t materialLibrariesOffset, materialsOffset, drawablesOffset, partsOffset, verticesOffset, indicesOffset, stringsOffset;
+    float min[3], max[3], radius;
+};
+
+// Texture names stored per material, in order
+static std::string material_t::* const COOKED_TEXTURE_SLOTS[] = {
+    &material_t::diffuse_texname, &material_t::specular_texname, &material_t::normal_texname,
+    &material_t::roughness_texname, &material_t::metallic_texname, &material_t::alpha_texname,
+};
+static const size_t COOKED_TEXTURE_SLOT_COUNT = sizeof(COOKED_TEXTURE_SLOTS) / sizeof(COOKED_TEXTURE_SLOTS[0]);
+
+// Texture handles for the names above, in the same order (and that of MaterialTable::TextureSlot)
+static GLuint Material::* const MATERIAL_TEXTURE_SLOTS[] = {
+    &Material::diffuse_map, &Material::specular_map, &Material::normal_map,
+    &Material::roughness_map, &Material::metallic_map, &Material::alpha_map,
+};
+
+// The .mtl files the materials were read from, the cook is stale once one of them changes
+struct CookedMaterialLibrary {
+    int64_t mtime;
+    uint32_t path;
+    uint32_t reserved;
+};
+
+struct CookedMaterial {
+    float ambient[3], diffuse[3], specular[3];
+    float shininess, roughness, metallic;
+    uint32_t name;
+    uint32_t textures[COOKED_TEXTURE_SLOT_COUNT];
+};
+
+struct CookedDrawable {
+    uint32_t materialId, count;
+    uint64_t indexOffset; // in bytes from the start of the indices, a multiple of 4
+    uint32_t indexType;
+    int32_t baseVertex;
+    float min[3], max[3];
+    uint32_t firstPart, partCount;
+};
+
+struct CookedDrawablePart {
+    uint32_t firstIndex, count;
+    float min[3], max[3];
+};
+
+static uint64_t alignCookedOffset(uint64_t offset) {
+    return (offset + 15) & ~uint64_t(15);
+}
+
+// Modification time of path, -1 if it doesn't exist
+static int64_t getModificationTime(const std::string &path) {
+    struct stat fileStat;
+    return stat(path.c_str(), &fileStat) == 0 ? (int64_t)fileStat.st_mtime : -1;
+}
+
 void convertPathFromWindows(std::string &str) {
 #ifndef _WIN32
     replace(begin(str), end(str), '\\', '/');
@@ -38,11 +124,91 @@ Mesh::Mesh(const std::string &meshname) {
     loadMesh(meshname);
 }
 
+void Mesh::loadMaterials() {
+    mats.clear();
+    mats.reserve(materials.size() + 1);
+
+    // Loaded synchronously, stands in for diffuse maps until they are resident
+    GLuint default_texture = GLHelper::createTextureFromImage(string(RESOURCE_DIR) + DEFAULT_TEXTURE);
+    textures.insert(make_pair(string(DEFAULT_TEXTURE), GLTexture2D {default_texture}));
+
+    // Load materials and store name->id map
+    for (material_t &mp : materials) {
+        Material m {mp};
+
+        for (size_t slot = 0; slot < COOKED_TEXTURE_SLOT_COUNT; slot++) {
+            const string &path = mp.*COOKED_TEXTURE_SLOTS[slot];
+            if (path.empty() || textures.find(path) != textures.end()) {
+                continue;
+            }
+
+            // storage is allocated once the streamer uploads the image, see requestTextures
+            textures.insert(make_pair(path, GLTexture2D {}));
+        }
+
+        if (!mp.diffuse_texname.empty()) { m.diffuse_map = default_texture; }
+
+        mats.push_back(m);
+    }
+
+    // Default material
+    {
+        material_t default_material;
+        default_material.name = "default";
+        default_material.diffuse_texname = DEFAULT_TEXTURE;
+        default_material.shininess = 1.0f;
+
+        materials.push_back(default_material);
+
+        Material m {default_material};
+        m.diffuse_map = default_texture;
+        mats.push_back(m);
+    }
+}
+
+// Called once the geometry is built, the decodes would otherwise queue on the ThreadPool ahead of it
+void Mesh::requestTextures(const std::string &basedir) {
+    for (auto &entry : textures) {
+        const string &path = entry.first;
+        if (path == DEFAULT_TEXTURE) {
+            continue;
+        }
+
+        string texture_name = path;
+        convertPathFromWindows(texture_name);
+
+        TextureStreamer::getInstance().request(basedir + texture_name, entry.second.handle, [this, path] (const string &, GLuint texture_id) {
+            onTextureResident(path, texture_id);
+        });
+    }
+}
+
+void Mesh::onTextureResident(const std::string &path, GLuint texture) {
+    LOG_INFO("loaded texture ", path);
+
+    for (size_t i = 0; i < mats.size(); i++) {
+        bool changed = false;
+        for (size_t slot = 0; slot < COOKED_TEXTURE_SLOT_COUNT; slot++) {
+            if (materials[i].*COOKED_TEXTURE_SLOTS[slot] == path) {
+                mats[i].*MATERIAL_TEXTURE_SLOTS[slot] = texture;
+                changed = true;
+            }
+        }
+
+        if (changed && materialsUploaded) {
+            writeMaterial(i);
+        }
+    }
+}
+
 // modified from https://github.com/syoyo/tinyobjloader/blob/master/examples/viewer/viewer.cc
-void Mesh::loadMesh(const std::string &meshname) {
+void Mesh::loadMesh(const std::string &meshname, const std::string &cookedname) {
+    typedef chrono::high_resolution_clock Clock;
+    auto parseStart = Clock::now();
+
     string err;
     string basedir = meshname.substr(0, meshname.find_last_of('/') + 1);
-    bool status = LoadObj(&attrib, &shapes, &materials, &err, meshname.c_str(), basedir.c_str());
+    bool status = ObjLoader::load(&attrib, &shapes, &materials, &err, meshname, basedir, &materialLibraries);
 
     if (!err.empty()) {
         LOG_ERROR(err);
@@ -52,123 +218,190 @@ void Mesh::loadMesh(const std::string &meshname) {
         LOG_ERROR("Failed to load mesh: ", meshname);
     }
     else {
-        auto start = chrono::high_resolution_clock::now();
-
-        mats.clear();
-        mats.reserve(materials.size() + 1);
-        // Load materials and store name->id map
-        for (material_t &mp : materials) {
-            Material m {mp};
-
-            auto loadImage = [&] (const std::string &path) {
-                if (textures.find(path) != textures.end()) {
-                    return textures[path].handle;
-                }
-
-                string texture_name = path;
-                convertPathFromWindows(texture_name);
+        auto start = Clock::now();
 
-                texture_name = basedir + texture_name;
-                GLuint texture_id = GLHelper::createTextureFromImage(texture_name);
-                GLTexture2D texture {texture_id};
+        loadMaterials();
 
-                textures.insert(make_pair(path, std::move(texture)));
+        auto dedupStart = Clock::now();
 
-                LOG_INFO("loaded texture ", path);
-                return texture_id;
-            };
+        ThreadPool &pool = ThreadPool::getInstance();
 
-            if (!mp.diffuse_texname.empty()) { m.diffuse_map = loadImage(mp.diffuse_texname); }
-            if (!mp.specular_texname.empty()) { m.specular_map = loadImage(mp.specular_texname); }
-            if (!mp.normal_texname.empty()) { m.normal_map = loadImage(mp.normal_texname); }
-            if (!mp.roughness_texname.empty()) { m.roughness_map = loadImage(mp.roughness_texname); }
-            if (!mp.metallic_texname.empty()) { m.metallic_map = loadImage(mp.metallic_texname); }
-            if (!mp.alpha_texname.empty()) { m.alpha_map = loadImage(mp.alpha_texname); }
-
-            mats.push_back(m);
+        const size_t drawableCount = materials.size();
+        drawables.resize(drawableCount);
+        for (size_t i = 0; i < drawableCount; i++) {
+            drawables[i].material_id = i;
+            drawables[i].min = glm::vec3(numeric_limits<float>::max());
+            drawables[i].max = glm::vec3(numeric_limits<float>::lowest());
         }
 
-        // Default material
-        {
-            material_t default_material;
-            default_material.name = "default";
-            default_material.diffuse_texname = DEFAULT_TEXTURE;
-            default_material.shininess = 1.0f;
-
-            materials.push_back(default_material);
-
-            GLuint texture_id = GLHelper::createTextureFromImage(string(RESOURCE_DIR) + default_material.diffuse_texname);
-            GLTexture2D texture {texture_id};
-            textures.insert(make_pair(default_material.diffuse_texname, std::move(texture)));
-
-            Material m {default_material};
-            m.diffuse_map = texture_id;
-            mats.push_back(m);
+        auto drawableIndex = [&] (int material_id) {
+            return material_id == -1 ? drawableCount - 1 : (size_t)material_id;
+        };
+
+        // Per-shape results, merged in shape order so the output matches a serial pass over all faces
+        struct ShapeGeometry {
+            vector<VertexKey> keys;       // unique keys in order of first use
+            vector<GLuint> localIndices;  // per face-vertex, into keys
+            vector<GLuint> remap;         // keys -> final vertex index
+            vector<size_t> drawableCounts, drawableOffsets;
+            vector<glm::vec3> drawableMin, drawableMax;
+            size_t faceVertexOffset;
+        };
+        vector<ShapeGeometry> shapeGeometry(shapes.size());
+
+        size_t faceVertexCount = 0;
+        for (size_t s = 0; s < shapes.size(); s++) {
+            shapeGeometry[s].faceVertexOffset = faceVertexCount;
+            faceVertexCount += shapes[s].mesh.indices.size();
         }
 
-        drawables.resize(materials.size());
-        for (size_t i = 0; i < drawables.size(); i++) {
-            drawables[i].material_id = i;
-        }
+        // Deduplicate within each shape
+        pool.parallelFor(shapes.size(), [&] (size_t s) {
+            const mesh_t &mesh = shapes[s].mesh;
+            ShapeGeometry &g = shapeGeometry[s];
 
-        min = glm::vec3(numeric_limits<float>::max());
-        max = glm::vec3(numeric_limits<float>::min());
+            VertexIndexMap shapeMap(mesh.indices.size());
+            g.keys.reserve(mesh.indices.size());
+            g.localIndices.resize(mesh.indices.size());
+            g.drawableCounts.assign(drawableCount, 0);
+            g.drawableMin.assign(drawableCount, glm::vec3(numeric_limits<float>::max()));
+            g.drawableMax.assign(drawableCount, glm::vec3(numeric_limits<float>::lowest()));
 
-        unordered_map<string, size_t> vertexMap;
-        vertexMap.clear();
-        vertices.clear();
-        for (const auto &shape : shapes) {
             size_t index_offset = 0;
 
             // Loop through each face
-            for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++) {
+            for (size_t f = 0; f < mesh.num_face_vertices.size(); f++) {
                 // Number of vertices per face (should always be 3 since triangulate=true)
-                unsigned char fv = shape.mesh.num_face_vertices[f];
+                unsigned char fv = mesh.num_face_vertices[f];
                 assert(fv == 3);
 
                 // Per face material_id
-                int material_id = shape.mesh.material_ids[f];
-                auto &d = drawables[material_id == -1 ? drawables.size() - 1 : material_id];
-
-                // Store pointers to each vertex so we can process per-face attributes later
-                vector<size_t> tri (fv, 0);
+                size_t d = drawableIndex(mesh.material_ids[f]);
+                g.drawableCounts[d] += fv;
 
                 // Loop through each vertex of the current face
                 for (size_t v = 0; v < fv; v++) {
-                    index_t index = shape.mesh.indices[index_offset + v];
-                    // assert(index.vertex_index == index.normal_index && index.normal_index == index.texcoord_index);
-                    string index_str =
-                        to_string(index.vertex_index) + string("_")
-                        + to_string(index.normal_index) + string("_")
-                        + to_string(index.texcoord_index);
-                    size_t vertIndex = 0;
-                    if (vertexMap.count(index_str) == 0) {
-                        // new vertex, add to map and load positions, normals, texcoords
-                        vertIndex = vertices.size();
-                        vertexMap.insert(make_pair(index_str, vertIndex));
-                        vertices.push_back(Vertex{});
-                        tri[v] = vertIndex;
-
-                        vertices[tri[v]].position[0] = attrib.vertices[3 * index.vertex_index];
-                        vertices[tri[v]].position[1] = attrib.vertices[3 * index.vertex_index + 1];
-                        vertices[tri[v]].position[2] = attrib.vertices[3 * index.vertex_index + 2];
-                        if (index.normal_index >= 0) {
-                            vertices[tri[v]].normal[0] = attrib.normals[3 * index.normal_index];
-                            vertices[tri[v]].normal[1] = attrib.normals[3 * index.normal_index + 1];
-                            vertices[tri[v]].normal[2] = attrib.normals[3 * index.normal_index + 2];
-                        }
-                        if (index.texcoord_index >= 0) {
-                            vertices[tri[v]].texcoord[0] = attrib.texcoords[2 * index.texcoord_index];
-                            vertices[tri[v]].texcoord[1] = 1.f - attrib.texcoords[2 * index.texcoord_index + 1];
-                        }
-                    }
-                    else {
-                        // existing vertex
-                        vertIndex = vertexMap.at(index_str);
-                        tri[v] = vertIndex;
+                    index_t index = mesh.indices[index_offset + v];
+                    VertexKey key { index.vertex_index, index.normal_index, index.texcoord_index };
+
+                    bool inserted = false;
+                    g.localIndices[index_offset + v] = shapeMap.findOrInsert(key, g.keys.size(), inserted);
+                    if (inserted) {
+                        g.keys.push_back(key);
                     }
-                    d.indices.push_back(vertIndex);
+
+                    glm::vec3 position(
+                        attrib.vertices[3 * index.vertex_index],
+                        attrib.vertices[3 * index.vertex_index + 1],
+                        attrib.vertices[3 * index.vertex_index + 2]
+                    );
+                    g.drawableMin[d] = glm::min(g.drawableMin[d], position);
+                    g.drawableMax[d] = glm::max(g.drawableMax[d], position);
+                }
+
+                index_offset += fv;
+            }
+        });
+
+        // Merge the shapes' unique vertices in order, new vertices keep their first-use order
+        size_t keyCount = 0;
+        for (const ShapeGeometry &g : shapeGeometry) {
+            keyCount += g.keys.size();
+        }
+
+        VertexIndexMap vertexMap(keyCount);
+        vector<VertexKey> vertexKeys;
+        vertexKeys.reserve(keyCount);
+        for (ShapeGeometry &g : shapeGeometry) {
+            g.remap.resize(g.keys.size());
+            for (size_t i = 0; i < g.keys.size(); i++) {
+                bool inserted = false;
+                g.remap[i] = vertexMap.findOrInsert(g.keys[i], vertexKeys.size(), inserted);
+                if (inserted) {
+                    vertexKeys.push_back(g.keys[i]);
+                }
+            }
+            g.keys = vector<VertexKey>();
+        }
+
+        // Each shape's slice of every drawable's index list, kept as a part for culling
+        vector<size_t> drawableCounts(drawableCount, 0);
+        for (ShapeGeometry &g : shapeGeometry) {
+            g.drawableOffsets.resize(drawableCount);
+            for (size_t d = 0; d < drawableCount; d++) {
+                g.drawableOffsets[d] = drawableCounts[d];
+                drawableCounts[d] += g.drawableCounts[d];
+
+                if (g.drawableCounts[d] > 0) {
+                    DrawablePart part;
+                    part.firstIndex = g.drawableOffsets[d];
+                    part.count = g.drawableCounts[d];
+                    part.min = g.drawableMin[d];
+                    part.max = g.drawableMax[d];
+                    drawables[d].parts.push_back(part);
+                }
+
+                drawables[d].min = glm::min(drawables[d].min, g.drawableMin[d]);
+                drawables[d].max = glm::max(drawables[d].max, g.drawableMax[d]);
+            }
+        }
+        for (size_t d = 0; d < drawableCount; d++) {
+            drawables[d].count = drawableCounts[d];
+            drawables[d].indices.resize(drawableCounts[d]);
+        }
+
+        vertices.clear();
+        vertices.resize(vertexKeys.size());
+        pool.parallelForBlocks(vertexKeys.size(), 4096, [&] (size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                const VertexKey &key = vertexKeys[i];
+                Vertex &vertex = vertices[i];
+
+                // load positions, normals, texcoords
+                vertex.position[0] = attrib.vertices[3 * key.vertex];
+                vertex.position[1] = attrib.vertices[3 * key.vertex + 1];
+                vertex.position[2] = attrib.vertices[3 * key.vertex + 2];
+                if (key.normal >= 0) {
+                    vertex.normal[0] = attrib.normals[3 * key.normal];
+                    vertex.normal[1] = attrib.normals[3 * key.normal + 1];
+                    vertex.normal[2] = attrib.normals[3 * key.normal + 2];
+                }
+                if (key.texcoord >= 0) {
+                    vertex.texcoord[0] = attrib.texcoords[2 * key.texcoord];
+                    vertex.texcoord[1] = 1.f - attrib.texcoords[2 * key.texcoord + 1];
+                }
+            }
+        });
+
+        // Deduplicated vertex per face-vertex, in file order, for the tangent pass
+        vector<GLuint> faceVertices(faceVertexCount);
+        pool.parallelFor(shapes.size(), [&] (size_t s) {
+            const mesh_t &mesh = shapes[s].mesh;
+            ShapeGeometry &g = shapeGeometry[s];
+            vector<size_t> &offsets = g.drawableOffsets;
+
+            for (size_t f = 0; f < mesh.num_face_vertices.size(); f++) {
+                Drawable &d = drawables[drawableIndex(mesh.material_ids[f])];
+                size_t &offset = offsets[&d - drawables.data()];
+
+                for (size_t v = 0; v < 3; v++) {
+                    GLuint vertIndex = g.remap[g.localIndices[3 * f + v]];
+                    d.indices[offset++] = vertIndex;
+                    faceVertices[g.faceVertexOffset + 3 * f + v] = vertIndex;
                 }
+            }
+
+            g = ShapeGeometry();
+        });
+
+        auto tangentStart = Clock::now();
+
+        // Face tangents in parallel, summed per vertex in face order so the result does not depend on scheduling
+        size_t faceCount = faceVertexCount / 3;
+        vector<glm::vec3> faceTangents(2 * faceCount);
+        pool.parallelForBlocks(faceCount, 4096, [&] (size_t begin, size_t end) {
+            for (size_t f = begin; f < end; f++) {
+                const GLuint *tri = &faceVertices[3 * f];
 
                 // https://learnopengl.com/Advanced-Lighting/Normal-Mapping
                 glm::vec3 edge1 = vertices[tri[1]].position - vertices[tri[0]].position;
@@ -176,81 +409,105 @@ void Mesh::loadMesh(const std::string &meshname) {
                 glm::vec2 deltaUV1 = vertices[tri[1]].texcoord - vertices[tri[0]].texcoord;
                 glm::vec2 deltaUV2 = vertices[tri[2]].texcoord - vertices[tri[0]].texcoord;
                 float invDeterminant = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-                glm::vec3 tangent, bitangent;
+                glm::vec3 &tangent = faceTangents[2 * f];
+                glm::vec3 &bitangent = faceTangents[2 * f + 1];
                 tangent.x = invDeterminant * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
                 tangent.y = invDeterminant * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
                 tangent.z = invDeterminant * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
                 bitangent.x = invDeterminant * (deltaUV2.x * edge1.x - deltaUV1.x * edge2.x);
                 bitangent.y = invDeterminant * (deltaUV2.x * edge1.y - deltaUV1.x * edge2.y);
                 bitangent.z = invDeterminant * (deltaUV2.x * edge1.z - deltaUV1.x * edge2.z);
-                for (size_t v = 0; v < 3; v++) {
-                    vertices[tri[v]].tangent += tangent;
-                    vertices[tri[v]].bitangent += bitangent;
-                }
+            }
+        });
 
-                index_offset += fv;
+        for (size_t f = 0; f < faceCount; f++) {
+            for (size_t v = 0; v < 3; v++) {
+                Vertex &vertex = vertices[faceVertices[3 * f + v]];
+                vertex.tangent += faceTangents[2 * f];
+                vertex.bitangent += faceTangents[2 * f + 1];
             }
         }
 
-        for (Vertex &v : vertices) {
-            v.tangent = glm::normalize(v.tangent);
-            v.bitangent = glm::normalize(v.bitangent);
+        const size_t vertexBlockSize = 16384;
+        size_t vertexBlockCount = (vertices.size() + vertexBlockSize - 1) / vertexBlockSize;
+        vector<glm::vec3> blockMin(vertexBlockCount, glm::vec3(numeric_limits<float>::max()));
+        vector<glm::vec3> blockMax(vertexBlockCount, glm::vec3(numeric_limits<float>::lowest()));
+        pool.parallelForBlocks(vertices.size(), vertexBlockSize, [&] (size_t begin, size_t end) {
+            size_t block = begin / vertexBlockSize;
+            for (size_t i = begin; i < end; i++) {
+                Vertex &v = vertices[i];
+                v.tangent = glm::normalize(v.tangent);
+                v.bitangent = glm::normalize(v.bitangent);
+
+                blockMin[block] = glm::min(blockMin[block], v.position);
+                blockMax[block] = glm::max(blockMax[block], v.position);
+            }
+        });
 
-            min = glm::min(min, v.position);
-            max = glm::max(max, v.position);
+        min = glm::vec3(numeric_limits<float>::max());
+        max = glm::vec3(numeric_limits<float>::lowest());
+        for (size_t block = 0; block < vertexBlockCount; block++) {
+            min = glm::min(min, blockMin[block]);
+            max = glm::max(max, blockMax[block]);
         }
 
         glm::vec3 extents = max - min;
         radius = glm::max(glm::max(extents.x, extents.y), extents.z) / 2.0f;
 
-        for (Drawable &d : drawables) {
-            glGenBuffers(1, &d.ebo);
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, d.ebo);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, d.indices.size() * sizeof(GLuint), d.indices.data(), GL_STATIC_DRAW);
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-        }
-
-        GLuint buf = 0;
-        glGenVertexArrays(1, &vao);
-        glGenBuffers(1, &buf);
+        auto optimizeStart = Clock::now();
 
-        glBindVertexArray(vao);
-        glBindBuffer(GL_ARRAY_BUFFER, buf);
+        // Triangle order per drawable part, so parts stay contiguous, then vertex order over the whole buffer
+        vector<MeshOptimizer::CacheStats> statsBefore(drawables.size()), statsAfter(drawables.size());
+        pool.parallelFor(drawables.size(), [&] (size_t i) {
+            vector<GLuint> &indices = drawables[i].indices;
+            statsBefore[i] = MeshOptimizer::analyzeVertexCache(indices.data(), indices.size());
 
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
-
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid *)offsetof(Vertex, position));
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid *)offsetof(Vertex, normal));
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid *)offsetof(Vertex, texcoord));
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid *)offsetof(Vertex, tangent));
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid *)offsetof(Vertex, bitangent));
-        glEnableVertexAttribArray(0);
-        glEnableVertexAttribArray(1);
-        glEnableVertexAttribArray(2);
-        glEnableVertexAttribArray(3);
-        glEnableVertexAttribArray(4);
+            for (const DrawablePart &part : drawables[i].parts) {
+                GLuint *partIndices = indices.data() + part.firstIndex;
+                MeshOptimizer::optimizeVertexCache(partIndices, part.count);
+                MeshOptimizer::optimizeOverdraw(partIndices, part.count, vertices.data(), OVERDRAW_THRESHOLD);
+            }
 
-        glBindVertexArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+            statsAfter[i] = MeshOptimizer::analyzeVertexCache(indices.data(), indices.size());
+        });
+        MeshOptimizer::optimizeVertexFetch(vertices, drawables);
 
-        {
-            glGenBuffers(1, &materialUBO);
-            glBindBuffer(GL_UNIFORM_BUFFER, materialUBO);
-            glBufferData(GL_UNIFORM_BUFFER, Material::getAlignment() * mats.size(), nullptr, GL_STATIC_DRAW);
+        MeshOptimizer::CacheStats before, after;
+        for (size_t i = 0; i < drawables.size(); i++) {
+            before += statsBefore[i];
+            after += statsAfter[i];
+        }
 
-            for (const auto &d : drawables) {
-                const auto &m = mats[d.material_id];
+        auto uploadStart = Clock::now();
 
-                GLuint materialOffset = Material::getAlignment() * d.material_id;
+        // In the layout they are uploaded and cooked in
+        compactVertices = useCompactVertices;
+        if (compactVertices) {
+            packVertices();
+        }
+        pool.parallelFor(drawables.size(), [&] (size_t i) {
+            narrowIndices(drawables[i]);
+        });
 
-                m.writeUBO(materialOffset);
-            }
+        if (!cookedname.empty() && writeCookedMesh(cookedname)) {
+            LOG_INFO("Wrote cooked mesh ", cookedname);
+        }
 
-            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        for (Drawable &d : drawables) {
+            uploadIndices(d, d.indexType == GL_UNSIGNED_SHORT ? (const void *)d.shortIndices.data() : (const void *)d.indices.data());
         }
+        uploadVertices(compactVertices ? (const void *)packedVertices.data() : (const void *)vertices.data(), vertices.size());
+        requestTextures(basedir);
+        uploadMaterials();
 
-        auto end = chrono::high_resolution_clock::now();
+        auto end = Clock::now();
         chrono::duration<double> diff = end - start;
+        chrono::duration<double> parseTime = start - parseStart;
+        chrono::duration<double> materialTime = dedupStart - start;
+        chrono::duration<double> dedupTime = tangentStart - dedupStart;
+        chrono::duration<double> tangentTime = optimizeStart - tangentStart;
+        chrono::duration<double> optimizeTime = uploadStart - optimizeStart;
+        chrono::duration<double> uploadTime = end - uploadStart;
         LOG_INFO(
             "\n\tLoaded mesh ", meshname, " in ", diff.count(), " seconds",
             "\n\t# of vertices  = ", (int)(attrib.vertices.size()) / 3,
@@ -258,117 +515,434 @@ void Mesh::loadMesh(const std::string &meshname) {
             "\n\t# of texcoords = ", (int)(attrib.texcoords.size()) / 2,
             "\n\t# of materials = ", (int)materials.size(),
             "\n\t# of shapes    = ", (int)shapes.size(),
+            "\n\t# of unique vertices = ", (int)vertices.size(),
             "\n\tmin = ", glm::to_string(min),
             "\n\tmax = ", glm::to_string(max),
-            "\n\tradius = ", radius
+            "\n\tradius = ", radius,
+            "\n\tACMR = ", before.getACMR(), " -> ", after.getACMR(),
+            "\n\tATVR = ", before.getATVR(), " -> ", after.getATVR(),
+            "\n\tparse     = ", parseTime.count(), " seconds",
+            "\n\tmaterials = ", materialTime.count(), " seconds",
+            "\n\tdedup     = ", dedupTime.count(), " seconds",
+            "\n\ttangents  = ", tangentTime.count(), " seconds",
+            "\n\toptimize  = ", optimizeTime.count(), " seconds",
+            "\n\tupload    = ", uploadTime.count(), " seconds"
         );
+
+        releaseCPUData();
     }
 }
 
-void Mesh::draw(GLShaderProgram &program, GLenum mode) const {
-    if (program.getObjectLabel() == "Phong") {
-        GLuint uboIndex = glGetUniformBlockIndex(program.getHandle(), "MaterialBlock");
-        // LOG_DEBUG("uboIndex: ", uboIndex);
-        glUniformBlockBinding(program.getHandle(), uboIndex, 0);
-    }
-
-#if 0
-    static GLuint ubo = 0;
-    if (ubo == 0 && program.getObjectLabel() == "Phong") {
-        LOG_DEBUG("Initializing ubo");
-        GLint maxUBOs;
-        glGetIntegerv(GL_MAX_UNIFORM_BUFFER_BINDINGS, &maxUBOs);
-        LOG_DEBUG("Max ubos: ", maxUBOs);
-
-        glGenBuffers(1, &ubo);
-        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
-        glBufferData(GL_UNIFORM_BUFFER, 72, nullptr, GL_STREAM_DRAW);
-        glBindBuffer(GL_UNIFORM_BUFFER, 0);
-
-        GLuint uboIndex = glGetUniformBlockIndex(program.getHandle(), "MaterialBlock");
-        LOG_DEBUG("uboIndex: ", uboIndex);
-        glUniformBlockBinding(program.getHandle(), uboIndex, 0);
-        glBindBufferBase(GL_UNIFORM_BUFFER, 0, ubo);
-        // glBindBufferRange(GL_UNIFORM_BUFFER, 0, ubo, 0, 72);
-
-        GLint numBlocks = 0;
-        glGetProgramInterfaceiv(program.getHandle(), GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &numBlocks);
-        const GLenum blockProperties[1] = {GL_NUM_ACTIVE_VARIABLES};
-        const GLenum activeUnifProp[1] = {GL_ACTIVE_VARIABLES};
-        const GLenum unifProperties[3] = {GL_NAME_LENGTH, GL_TYPE, GL_OFFSET};
-
-        LOG_DEBUG("# Uniform blocks:", numBlocks);
-        for(int blockIx = 0; blockIx < numBlocks; ++blockIx) {
-            GLint numActiveUnifs = 0;
-            glGetProgramResourceiv(program.getHandle(), GL_UNIFORM_BLOCK, blockIx, 1, blockProperties, 1, NULL, &numActiveUnifs);
-
-            if(!numActiveUnifs)
-                continue;
+bool Mesh::loadCookedMesh(const std::string &meshname, const std::string &cookedname) {
+    auto start = chrono::high_resolution_clock::now();
 
-            LOG_DEBUG("# Active uniforms: ", numActiveUnifs);
-            std::vector<GLint> blockUnifs(numActiveUnifs);
-            glGetProgramResourceiv(program.getHandle(), GL_UNIFORM_BLOCK, blockIx, 1, activeUnifProp, numActiveUnifs, NULL, &blockUnifs[0]);
+    MappedFile file;
+    if (!file.open(cookedname)) {
+        return false;
+    }
 
-            for(int unifIx = 0; unifIx < numActiveUnifs; ++unifIx) {
-                GLint values[3];
-                glGetProgramResourceiv(program.getHandle(), GL_UNIFORM, blockUnifs[unifIx], 3, unifProperties, 3, NULL, values);
+    const unsigned char *data = file.data();
+    const size_t size = file.size();
 
-                // Get the name. Must use a std::vector rather than a std::string for C++03 standards issues.
-                // C++11 would let you use a std::string directly.
-                std::vector<char> nameData(values[0]);
-                glGetProgramResourceName(program.getHandle(), GL_UNIFORM, blockUnifs[unifIx], nameData.size(), NULL, &nameData[0]);
-                std::string name(nameData.begin(), nameData.end() - 1);
+    CookedMeshHeader header;
+    if (size < sizeof(header)) {
+        LOG_WARN("Ignoring truncated cooked mesh ", cookedname);
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+
+    // Cooked in the other vertex layout counts as stale, it is recooked in the current one
+    const size_t vertexSize = useCompactVertices ? sizeof(PackedVertex) : sizeof(Vertex);
+    if (memcmp(header.magic, COOKED_MESH_MAGIC, sizeof(header.magic)) != 0
+        || header.version != COOKED_MESH_VERSION
+        || header.compactVertices != (uint32_t)useCompactVertices
+        || header.vertexSize != vertexSize) {
+        LOG_WARN("Ignoring stale cooked mesh ", cookedname);
+        return false;
+    }
 
-                LOG_DEBUG(name, " ", values[0], " ", values[1], " ", values[2]);
+    auto sectionFits = [&] (uint64_t offset, uint64_t count, uint64_t elementSize) {
+        return offset <= size && count <= (size - offset) / elementSize;
+    };
+
+    if (!sectionFits(header.materialLibrariesOffset, header.materialLibraryCount, sizeof(CookedMaterialLibrary))
+        || !sectionFits(header.materialsOffset, header.materialCount, sizeof(CookedMaterial))
+        || !sectionFits(header.drawablesOffset, header.drawableCount, sizeof(CookedDrawable))
+        || !sectionFits(header.partsOffset, header.partCount, sizeof(CookedDrawablePart))
+        || !sectionFits(header.verticesOffset, header.vertexCount, vertexSize)
+        || !sectionFits(header.indicesOffset, header.indicesSize, 1)
+        || !sectionFits(header.stringsOffset, header.stringsSize, 1)
+        || header.stringsSize == 0 || data[header.stringsOffset + header.stringsSize - 1] != '\0'
+        || header.drawableCount != header.materialCount + 1) {
+        LOG_WARN("Ignoring corrupt cooked mesh ", cookedname);
+        return false;
+    }
+
+    const CookedMaterialLibrary *cookedLibraries = reinterpret_cast<const CookedMaterialLibrary *>(data + header.materialLibrariesOffset);
+    const CookedMaterial *cookedMaterials = reinterpret_cast<const CookedMaterial *>(data + header.materialsOffset);
+    const CookedDrawable *cookedDrawables = reinterpret_cast<const CookedDrawable *>(data + header.drawablesOffset);
+    const CookedDrawablePart *cookedParts = reinterpret_cast<const CookedDrawablePart *>(data + header.partsOffset);
+    const unsigned char *cookedVertices = data + header.verticesOffset;
+    const unsigned char *cookedIndices = data + header.indicesOffset;
+    const char *strings = reinterpret_cast<const char *>(data + header.stringsOffset);
+
+    for (uint32_t i = 0; i < header.drawableCount; i++) {
+        const CookedDrawable &cd = cookedDrawables[i];
+        const uint64_t indexSize = cd.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(GLuint);
+        if (cd.materialId >= header.drawableCount || (cd.indexType != GL_UNSIGNED_SHORT && cd.indexType != GL_UNSIGNED_INT)
+            || cd.indexOffset % 4 != 0 || cd.indexOffset > header.indicesSize || cd.count > (header.indicesSize - cd.indexOffset) / indexSize
+            || cd.firstPart > header.partCount || cd.partCount > header.partCount - cd.firstPart) {
+            LOG_WARN("Ignoring corrupt cooked mesh ", cookedname);
+            return false;
+        }
+        for (uint32_t p = cd.firstPart; p < cd.firstPart + cd.partCount; p++) {
+            if (cookedParts[p].firstIndex > cd.count || cookedParts[p].count > cd.count - cookedParts[p].firstIndex) {
+                LOG_WARN("Ignoring corrupt cooked mesh ", cookedname);
+                return false;
             }
         }
     }
-#endif
 
-    glBindVertexArray(vao);
-    for (const auto &d : drawables) {
-        const auto &m = mats[d.material_id];
-
-        GLuint default_texture = textures.at(DEFAULT_TEXTURE).handle;
-        bool hasDiffuseMap = m.diffuse_map != 0;
-        bool hasSpecularMap = m.specular_map != 0;
-        bool hasNormalMap = m.normal_map != 0;
-        bool hasRoughnessMap = m.roughness_map != 0;
-        bool hasMetallicMap = m.ambient_map != 0;
-        bool hasAlphaMap = m.alpha_map != 0;
-
-        glBindTextureUnit(0, m.diffuse_map);
-        glBindTextureUnit(1, m.specular_map);
-        glBindTextureUnit(5, m.normal_map);
-        glBindTextureUnit(7, m.roughness_map);
-        glBindTextureUnit(8, m.metallic_map);
-        glBindTextureUnit(9, m.alpha_map);
-
-        if (program.getObjectLabel() == "Phong") {
-            glBindBufferRange(GL_UNIFORM_BUFFER, 0, materialUBO, Material::getAlignment() * d.material_id, Material::glslSize);
+    auto getString = [&] (uint32_t offset) {
+        return offset < header.stringsSize ? string(strings + offset) : string();
+    };
+
+    // ResourceLoader only compares against the .obj, an edited .mtl is caught here
+    for (uint32_t i = 0; i < header.materialLibraryCount; i++) {
+        if (getModificationTime(getString(cookedLibraries[i].path)) != cookedLibraries[i].mtime) {
+            LOG_WARN("Ignoring stale cooked mesh ", cookedname);
+            return false;
+        }
+    }
+
+    materials.clear();
+    materials.reserve(header.materialCount + 1);
+    for (uint32_t i = 0; i < header.materialCount; i++) {
+        const CookedMaterial &cm = cookedMaterials[i];
+
+        material_t mp;
+        mp.name = getString(cm.name);
+        for (int c = 0; c < 3; c++) {
+            mp.ambient[c] = cm.ambient[c];
+            mp.diffuse[c] = cm.diffuse[c];
+            mp.specular[c] = cm.specular[c];
+        }
+        mp.shininess = cm.shininess;
+        mp.roughness = cm.roughness;
+        mp.metallic = cm.metallic;
+        for (size_t slot = 0; slot < COOKED_TEXTURE_SLOT_COUNT; slot++) {
+            mp.*COOKED_TEXTURE_SLOTS[slot] = getString(cm.textures[slot]);
+        }
+
+        materials.push_back(mp);
+    }
+
+    string basedir = meshname.substr(0, meshname.find_last_of('/') + 1);
+    loadMaterials();
+
+    drawables.resize(header.drawableCount);
+    for (uint32_t i = 0; i < header.drawableCount; i++) {
+        const CookedDrawable &cd = cookedDrawables[i];
+        Drawable &d = drawables[i];
+
+        d.material_id = cd.materialId;
+        d.count = cd.count;
+        d.min = glm::vec3(cd.min[0], cd.min[1], cd.min[2]);
+        d.max = glm::vec3(cd.max[0], cd.max[1], cd.max[2]);
+
+        d.parts.resize(cd.partCount);
+        for (uint32_t p = 0; p < cd.partCount; p++) {
+            const CookedDrawablePart &cp = cookedParts[cd.firstPart + p];
+            d.parts[p].firstIndex = cp.firstIndex;
+            d.parts[p].count = cp.count;
+            d.parts[p].min = glm::vec3(cp.min[0], cp.min[1], cp.min[2]);
+            d.parts[p].max = glm::vec3(cp.max[0], cp.max[1], cp.max[2]);
+        }
+
+        d.indexType = cd.indexType;
+        d.baseVertex = cd.baseVertex;
+        uploadIndices(d, cookedIndices + cd.indexOffset);
+    }
+    // the compact vertex layout is relative to the bounds
+    min = glm::vec3(header.min[0], header.min[1], header.min[2]);
+    max = glm::vec3(header.max[0], header.max[1], header.max[2]);
+    radius = header.radius;
+
+    compactVertices = header.compactVertices != 0;
+    uploadVertices(cookedVertices, header.vertexCount);
+    requestTextures(basedir);
+    uploadMaterials();
+
+    auto end = chrono::high_resolution_clock::now();
+    chrono::duration<double> diff = end - start;
+    LOG_INFO(
+        "\n\tLoaded cooked mesh ", cookedname, " in ", diff.count(), " seconds",
+        "\n\t# of vertices  = ", header.vertexCount,
+        "\n\tindex bytes    = ", header.indicesSize,
+        "\n\t# of materials = ", (int)materials.size(),
+        "\n\tmin = ", glm::to_string(min),
+        "\n\tmax = ", glm::to_string(max),
+        "\n\tradius = ", radius
+    );
+
+    return true;
+}
+
+bool Mesh::writeCookedMesh(const std::string &cookedname) const {
+    // The default material is appended on load and not stored
+    assert(!materials.empty() && drawables.size() == materials.size());
+    uint32_t materialCount = materials.size() - 1;
+
+    string strings;
+    auto addString = [&] (const string &str) {
+        if (str.empty()) {
+            return COOKED_NO_STRING;
+        }
+        uint32_t offset = strings.size();
+        strings.append(str);
+        strings.push_back('\0');
+        return offset;
+    };
+    // the string table is never empty, so a valid table always ends in '\0'
+    strings.push_back('\0');
+
+    vector<CookedMaterialLibrary> cookedLibraries(materialLibraries.size());
+    for (size_t i = 0; i < materialLibraries.size(); i++) {
+        cookedLibraries[i].mtime = getModificationTime(materialLibraries[i]);
+        cookedLibraries[i].path = addString(materialLibraries[i]);
+        cookedLibraries[i].reserved = 0;
+    }
+
+    vector<CookedMaterial> cookedMaterials(materialCount);
+    for (uint32_t i = 0; i < materialCount; i++) {
+        const material_t &mp = materials[i];
+        CookedMaterial &cm = cookedMaterials[i];
+
+        for (int c = 0; c < 3; c++) {
+            cm.ambient[c] = mp.ambient[c];
+            cm.diffuse[c] = mp.diffuse[c];
+            cm.specular[c] = mp.specular[c];
+        }
+        cm.shininess = mp.shininess;
+        cm.roughness = mp.roughness;
+        cm.metallic = mp.metallic;
+        cm.name = addString(mp.name);
+        for (size_t slot = 0; slot < COOKED_TEXTURE_SLOT_COUNT; slot++) {
+            cm.textures[slot] = addString(mp.*COOKED_TEXTURE_SLOTS[slot]);
+        }
+    }
+
+    uint64_t indicesSize = 0;
+    vector<CookedDrawable> cookedDrawables(drawables.size());
+    vector<CookedDrawablePart> cookedParts;
+    for (size_t i = 0; i < drawables.size(); i++) {
+        const Drawable &d = drawables[i];
+        CookedDrawable &cd = cookedDrawables[i];
+
+        cd.materialId = d.material_id;
+        cd.count = d.indices.size();
+        cd.indexOffset = indicesSize;
+        cd.indexType = d.indexType;
+        cd.baseVertex = d.baseVertex;
+        for (int c = 0; c < 3; c++) {
+            cd.min[c] = d.min[c];
+            cd.max[c] = d.max[c];
+        }
+        // Keeps every drawable's indices 4 byte aligned in the mapping
+        const size_t indexSize = d.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(GLuint);
+        indicesSize += (d.indices.size() * indexSize + 3) & ~size_t(3);
+
+        cd.firstPart = cookedParts.size();
+        cd.partCount = d.parts.size();
+        for (const DrawablePart &part : d.parts) {
+            CookedDrawablePart cp;
+            cp.firstIndex = part.firstIndex;
+            cp.count = part.count;
+            for (int c = 0; c < 3; c++) {
+                cp.min[c] = part.min[c];
+                cp.max[c] = part.max[c];
+            }
+            cookedParts.push_back(cp);
+        }
+    }
+
+    CookedMeshHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, COOKED_MESH_MAGIC, sizeof(header.magic));
+    header.version = COOKED_MESH_VERSION;
+    const size_t vertexSize = compactVertices ? sizeof(PackedVertex) : sizeof(Vertex);
+    header.vertexSize = vertexSize;
+    header.compactVertices = compactVertices;
+    header.materialLibraryCount = cookedLibraries.size();
+    header.materialCount = materialCount;
+    header.drawableCount = drawables.size();
+    header.vertexCount = vertices.size();
+    header.partCount = cookedParts.size();
+    header.indicesSize = indicesSize;
+    header.stringsSize = strings.size();
+    header.materialLibrariesOffset = alignCookedOffset(sizeof(header));
+    header.materialsOffset = alignCookedOffset(header.materialLibrariesOffset + cookedLibraries.size() * sizeof(CookedMaterialLibrary));
+    header.drawablesOffset = alignCookedOffset(header.materialsOffset + cookedMaterials.size() * sizeof(CookedMaterial));
+    header.partsOffset = alignCookedOffset(header.drawablesOffset + cookedDrawables.size() * sizeof(CookedDrawable));
+    header.verticesOffset = alignCookedOffset(header.partsOffset + cookedParts.size() * sizeof(CookedDrawablePart));
+    header.indicesOffset = alignCookedOffset(header.verticesOffset + vertices.size() * vertexSize);
+    header.stringsOffset = alignCookedOffset(header.indicesOffset + indicesSize);
+    for (int c = 0; c < 3; c++) {
+        header.min[c] = min[c];
+        header.max[c] = max[c];
+    }
+    header.radius = radius;
+
+    vector<unsigned char> buffer(header.stringsOffset + header.stringsSize, 0);
+    memcpy(buffer.data(), &header, sizeof(header));
+    memcpy(buffer.data() + header.materialLibrariesOffset, cookedLibraries.data(), cookedLibraries.size() * sizeof(CookedMaterialLibrary));
+    memcpy(buffer.data() + header.materialsOffset, cookedMaterials.data(), cookedMaterials.size() * sizeof(CookedMaterial));
+    memcpy(buffer.data() + header.drawablesOffset, cookedDrawables.data(), cookedDrawables.size() * sizeof(CookedDrawable));
+    memcpy(buffer.data() + header.partsOffset, cookedParts.data(), cookedParts.size() * sizeof(CookedDrawablePart));
+    memcpy(buffer.data() + header.verticesOffset, compactVertices ? (const void *)packedVertices.data() : (const void *)vertices.data(), vertices.size() * vertexSize);
+    for (size_t i = 0; i < drawables.size(); i++) {
+        const Drawable &d = drawables[i];
+        unsigned char *dst = buffer.data() + header.indicesOffset + cookedDrawables[i].indexOffset;
+        if (d.indexType == GL_UNSIGNED_SHORT) {
+            memcpy(dst, d.shortIndices.data(), d.shortIndices.size() * sizeof(uint16_t));
         }
         else {
-            program.setUniform3fv("material.ambient", m.ambient);
-            program.setUniform3fv("material.diffuse", m.diffuse);
-            program.setUniform3fv("material.specular", m.specular);
-            program.setUniform1f("material.shininess", m.shininess);
-            program.setUniform1i("material.hasAmbientMap", false);
-            program.setUniform1i("material.hasDiffuseMap", hasDiffuseMap);
-            program.setUniform1i("material.hasSpecularMap", hasSpecularMap);
-            program.setUniform1i("material.hasAlphaMap", hasAlphaMap);
-            program.setUniform1i("material.hasNormalMap", hasNormalMap);
-            program.setUniform1i("material.hasRoughnessMap", hasRoughnessMap);
-            program.setUniform1i("material.hasMetallicMap", hasMetallicMap);
-            program.setUniform1i("material.hasAlphaMap", hasAlphaMap);
+            memcpy(dst, d.indices.data(), d.indices.size() * sizeof(GLuint));
+        }
+    }
+    memcpy(buffer.data() + header.stringsOffset, strings.data(), strings.size());
+
+    // Write to a temporary file first so an interrupted cook never leaves a truncated file behind
+    string tmpname = cookedname + ".tmp";
+    FILE *fp = fopen(tmpname.c_str(), "wb");
+    if (fp == nullptr) {
+        LOG_WARN("Failed to write cooked mesh ", cookedname, ": ", strerror(errno));
+        return false;
+    }
+
+    bool written = fwrite(buffer.data(), 1, buffer.size(), fp) == buffer.size();
+    written = (fclose(fp) == 0) && written;
+
+    remove(cookedname.c_str());
+    if (!written || rename(tmpname.c_str(), cookedname.c_str()) != 0) {
+        LOG_WARN("Failed to write cooked mesh ", cookedname, ": ", strerror(errno));
+        remove(tmpname.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// Octahedral mapping of a unit vector onto [-1, 1]^2, degenerate vectors map to +z
+static glm::vec2 encodeOctahedral(const glm::vec3 &v) {
+    float l1 = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+    if (!(l1 > 0.0f)) {
+        return glm::vec2(0.0f);
+    }
+
+    glm::vec3 n = v / l1;
+    glm::vec2 e(n.x, n.y);
+    if (n.z < 0.0f) {
+        glm::vec2 s(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+        e = (glm::vec2(1.0f) - glm::abs(glm::vec2(n.y, n.x))) * s;
+    }
+    return e;
+}
+
+static PackedVertex packVertex(const Vertex &v, const glm::vec3 &min, const glm::vec3 &scale) {
+    glm::vec3 position = glm::clamp((v.position - min) * scale, 0.0f, 1.0f);
+    uint32_t positionZ = glm::packUnorm2x16(glm::vec2(position.z, 0.0f));
+    if (glm::dot(glm::cross(v.normal, v.tangent), v.bitangent) < 0.0f) {
+        positionZ |= 0x10000;
+    }
+
+    PackedVertex packed;
+    packed.data[0] = glm::packUnorm2x16(glm::vec2(position.x, position.y));
+    packed.data[1] = positionZ;
+    packed.data[2] = glm::packSnorm2x16(encodeOctahedral(v.normal));
+    packed.data[3] = glm::packSnorm2x16(encodeOctahedral(v.tangent));
+    packed.data[4] = glm::packHalf2x16(v.texcoord);
+    return packed;
+}
+
+// Vertices are pulled from the GeometryArena vertex buffer in the vertex shader (shaders/vertex.glsl).
+// Compact vertices are 20 bytes instead of 56:
+//   position   unorm16 x3 relative to the mesh bounds
+//   normal     octahedral snorm16 x2
+//   tangent    octahedral snorm16 x2, the bitangent is cross(normal, tangent) times a sign bit stored with position.z
+//   texcoord   half float x2
+void Mesh::packVertices() {
+    glm::vec3 extents = max - min, scale;
+    for (int i = 0; i < 3; i++) {
+        scale[i] = extents[i] > 0.0f ? 1.0f / extents[i] : 0.0f;
+    }
+
+    packedVertices.resize(vertices.size());
+    ThreadPool::getInstance().parallelForBlocks(vertices.size(), 64 * 1024, [&] (size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            packedVertices[i] = packVertex(vertices[i], min, scale);
         }
+    });
+}
+
+// Drawables referencing fewer than 65536 distinct vertex slots get 16 bit indices offset by a base vertex
+void Mesh::narrowIndices(Drawable &d) {
+    GLuint lo = numeric_limits<GLuint>::max(), hi = 0;
+    for (GLuint index : d.indices) {
+        lo = std::min(lo, index);
+        hi = std::max(hi, index);
+    }
+
+    if (d.indices.empty() || hi - lo > numeric_limits<uint16_t>::max()) {
+        d.indexType = GL_UNSIGNED_INT;
+        d.baseVertex = 0;
+        return;
+    }
+
+    d.shortIndices.resize(d.indices.size());
+    for (size_t i = 0; i < d.indices.size(); i++) {
+        d.shortIndices[i] = (uint16_t)(d.indices[i] - lo);
+    }
+    d.indexType = GL_UNSIGNED_SHORT;
+    d.baseVertex = lo;
+}
+
+// data is laid out as PackedVertex if compactVertices, Vertex otherwise
+void Mesh::uploadVertices(const void *data, size_t count) {
+    baseVertex = GeometryArena::getInstance().addVertices(data, count, compactVertices ? sizeof(PackedVertex) : sizeof(Vertex));
+}
+
+// data is d.count indices of d.indexType
+void Mesh::uploadIndices(Drawable &d, const void *data) {
+    d.firstIndex = GeometryArena::getInstance().addIndices(data, d.count, d.indexType);
+}
+
+void Mesh::uploadMaterials() {
+    materialBase = MaterialTable::getInstance().add(mats.size());
+    materialsUploaded = true;
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, d.ebo);
-        glDrawElements(mode, d.indices.size(), GL_UNSIGNED_INT, 0);
+    for (size_t i = 0; i < mats.size(); i++) {
+        writeMaterial(i);
     }
+}
 
-    glBindTextureUnit(0, 0);
-    glBindTextureUnit(1, 0);
-    glBindTextureUnit(5, 0);
-    glBindVertexArray(0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+void Mesh::writeMaterial(size_t i) {
+    MaterialTable &table = MaterialTable::getInstance();
+    table.setMaterial(materialBase + i, mats[i]);
+    for (size_t slot = 0; slot < COOKED_TEXTURE_SLOT_COUNT; slot++) {
+        table.setTexture(materialBase + i, (MaterialTable::TextureSlot)slot, mats[i].*MATERIAL_TEXTURE_SLOTS[slot]);
+    }
+}
+
+void Mesh::releaseCPUData() {
+    // assign empty containers, clear() keeps the capacity around
+    attrib = attrib_t();
+    shapes = vector<shape_t>();
+    materialLibraries = vector<string>();
+    vertices = vector<Vertex>();
+    packedVertices = vector<PackedVertex>();
+    for (Drawable &d : drawables) {
+        d.indices = vector<GLuint>();
+        d.shortIndices = vector<uint16_t>();
+    }
 }
@@ -10,6 +10,7 @@
 #include <vector>
 #include <map>
 #include <algorithm>
+#include <cstdint>
 
 #include <tiny_obj_loader.h>
 #include <common.h>
@@ -41,32 +42,6 @@ struct Material {
         this->roughness = roughness;
         this->metallic = metallic;
     }
-
-    void writeUBO(unsigned int offset) const {
-        glBufferSubData(GL_UNIFORM_BUFFER, offset +  0, 12, &ambient);
-        glBufferSubData(GL_UNIFORM_BUFFER, offset + 16, 12, &diffuse);
-        glBufferSubData(GL_UNIFORM_BUFFER, offset + 32, 12, &specular);
-        glBufferSubData(GL_UNIFORM_BUFFER, offset + 44,  4, &shininess);
-        glBufferSubData(GL_UNIFORM_BUFFER, offset + 48,  4, &ambient_map);
-        glBufferSubData(GL_UNIFORM_BUFFER, offset + 52,  4, &diffuse_map);
-        glBufferSubData(GL_UNIFORM_BUFFER, offset + 56,  4, &specular_map);
-        glBufferSubData(GL_UNIFORM_BUFFER, offset + 60,  4, &alpha_map);
-        glBufferSubData(GL_UNIFORM_BUFFER, offset + 64,  4, &normal_map);
-        glBufferSubData(GL_UNIFORM_BUFFER, offset + 68,  4, &roughness_map);
-        glBufferSubData(GL_UNIFORM_BUFFER, offset + 72,  4, &metallic_map);
-    }
-
-    static GLint getAlignment() {
-        static GLint uboOffsetAlignment = 0;
-        if (uboOffsetAlignment == 0) {
-            glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uboOffsetAlignment);
-            LOG_DEBUG("uboOffsetAlignment: ", uboOffsetAlignment);
-        }
-
-        return std::max((GLint)Material::glslSize, uboOffsetAlignment);
-    }
-
-    static const unsigned int glslSize = 80;
 };
 
 struct Vertex {
@@ -75,39 +50,85 @@ struct Vertex {
     glm::vec3 tangent, bitangent;
 };
 
+// Compact vertex read by shaders/vertex.glsl, see Mesh::uploadVertices for the layout
+struct PackedVertex {
+    uint32_t data[5];
+};
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex must match the stride in vertex.glsl");
+
+// The triangles of one shape within a drawable, the unit of culling
+struct DrawablePart {
+    GLuint firstIndex = 0; // relative to the first index of the drawable
+    GLsizei count = 0;
+    glm::vec3 min, max;
+};
+
 struct Drawable {
     size_t material_id;
-    std::vector<GLuint> indices;
-    GLuint ebo;
+    std::vector<GLuint> indices; // released once uploaded
+    std::vector<uint16_t> shortIndices; // indices narrowed to 16 bits if they fit, released once uploaded
+    GLsizei count = 0;
+    glm::vec3 min, max;
+    std::vector<DrawablePart> parts; // in index order, covering every index
+    GLuint firstIndex = 0; // in the GeometryArena index buffer, in units of indexType
+    GLenum indexType = GL_UNSIGNED_INT;
+    GLint baseVertex = 0; // 16 bit indices are relative to the smallest vertex they reference
 };
 
 class Mesh {
 public:
+    Mesh() {}
     Mesh(const std::string &meshname);
 
-    void draw(GLShaderProgram &program, GLenum mode = GL_TRIANGLES) const;
-
-    void loadMesh(const std::string &meshname);
+    // Parses the OBJ and, if cookedname is given, writes the cooked binary for the next launch
+    void loadMesh(const std::string &meshname, const std::string &cookedname = "");
+    // Maps a cooked mesh and uploads straight from the mapping, returns false if it is missing or stale
+    bool loadCookedMesh(const std::string &meshname, const std::string &cookedname);
 
     const glm::vec3 &getMin() const { return min; }
     const glm::vec3 &getMax() const { return max; }
     glm::vec3 getExtents() const { return max - min; }
     float getRadius() const { return radius; }
 
+    const std::vector<Drawable> &getDrawables() const { return drawables; }
+    GLint getBaseVertex() const { return baseVertex; }
+    GLuint getMaterialBase() const { return materialBase; }
+    bool hasCompactVertices() const { return compactVertices; }
+
+    // Upload vertices as PackedVertex instead of full floats, read when a mesh is loaded
+    static bool useCompactVertices;
+
 private:
+    void loadMaterials();
+    void requestTextures(const std::string &basedir);
+    void onTextureResident(const std::string &path, GLuint texture);
+    void packVertices();
+    static void narrowIndices(Drawable &d);
+    void uploadVertices(const void *data, size_t count);
+    void uploadIndices(Drawable &d, const void *data);
+    void uploadMaterials();
+    void writeMaterial(size_t i);
+    bool writeCookedMesh(const std::string &cookedname) const;
+    void releaseCPUData();
+
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
     std::vector<tinyobj::material_t> materials;
+    std::vector<std::string> materialLibraries; // .mtl files read by loadMesh, stored in the cook
     std::vector<Material> mats; // TODO temporary, will remove material_t
 
     std::map<std::string, GLTexture2D> textures;
     std::vector<Drawable> drawables;
     std::vector<Vertex> vertices;
+    std::vector<PackedVertex> packedVertices; // when compactVertices, released once uploaded
 
     glm::vec3 min, max;
     float radius;
 
-    GLuint vao, materialUBO;
+    GLuint materialBase = 0; // of the first material in the MaterialTable
+    bool materialsUploaded = false;
+    GLint baseVertex = 0; // of the first vertex in the GeometryArena
+    bool compactVertices = false;
 };
 
 #endif
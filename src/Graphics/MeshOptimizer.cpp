@@ -0,0 +1,339 @@
+#include "MeshOptimizer.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+using namespace std;
+
+static const int FORSYTH_CACHE_SIZE = 32;
+static const unsigned int FORSYTH_VALENCE_TABLE_SIZE = 32;
+
+static const unsigned int OVERDRAW_CACHE_SIZE = 16;
+
+// Maps an index list to dense local vertex ids so per-vertex arrays scale with the list, not the whole mesh
+static size_t compactIndices(const GLuint *indices, size_t indexCount, vector<GLuint> &local) {
+    vector<GLuint> unique(indices, indices + indexCount);
+    sort(unique.begin(), unique.end());
+    unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+
+    local.resize(indexCount);
+    for (size_t i = 0; i < indexCount; i++) {
+        local[i] = (GLuint)(lower_bound(unique.begin(), unique.end(), indices[i]) - unique.begin());
+    }
+
+    return unique.size();
+}
+
+MeshOptimizer::CacheStats &MeshOptimizer::CacheStats::operator+=(const CacheStats &other) {
+    triangles += other.triangles;
+    vertices += other.vertices;
+    transformed += other.transformed;
+    return *this;
+}
+
+MeshOptimizer::CacheStats MeshOptimizer::analyzeVertexCache(const GLuint *indices, size_t indexCount, unsigned int cacheSize) {
+    CacheStats stats;
+    vector<GLuint> local;
+    stats.vertices = compactIndices(indices, indexCount, local);
+    stats.triangles = indexCount / 3;
+
+    // A vertex stays in the FIFO until cacheSize other vertices have been pushed after it
+    vector<size_t> pushedAt(stats.vertices, 0);
+    size_t time = cacheSize + 1;
+    for (size_t i = 0; i < indexCount; i++) {
+        if (time - pushedAt[local[i]] > cacheSize) {
+            pushedAt[local[i]] = time++;
+            stats.transformed++;
+        }
+    }
+
+    return stats;
+}
+
+struct ForsythTables {
+    float cache[FORSYTH_CACHE_SIZE];
+    float valence[FORSYTH_VALENCE_TABLE_SIZE];
+
+    ForsythTables() {
+        // The last triangle's vertices get a fixed score so the next triangle doesn't just reuse its edge
+        for (int i = 0; i < FORSYTH_CACHE_SIZE; i++) {
+            cache[i] = i < 3 ? 0.75f : powf(1.0f - (i - 3) / (float)(FORSYTH_CACHE_SIZE - 3), 1.5f);
+        }
+
+        // Boost vertices with few triangles left so they get finished off
+        valence[0] = 0.0f;
+        for (unsigned int i = 1; i < FORSYTH_VALENCE_TABLE_SIZE; i++) {
+            valence[i] = 2.0f / sqrtf((float)i);
+        }
+    }
+
+    float score(int cachePosition, unsigned int remaining) const {
+        if (remaining == 0) {
+            return -1.0f;
+        }
+
+        float score = cachePosition >= 0 ? cache[cachePosition] : 0.0f;
+        score += remaining < FORSYTH_VALENCE_TABLE_SIZE ? valence[remaining] : 2.0f / sqrtf((float)remaining);
+        return score;
+    }
+};
+
+void MeshOptimizer::optimizeVertexCache(GLuint *indices, size_t indexCount) {
+    static const ForsythTables tables;
+
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2) {
+        return;
+    }
+
+    vector<GLuint> local;
+    size_t vertexCount = compactIndices(indices, indexCount, local);
+
+    // Triangles using each vertex, the first remaining[v] entries are the ones not emitted yet
+    vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < indexCount; i++) {
+        offsets[local[i] + 1]++;
+    }
+    for (size_t v = 0; v < vertexCount; v++) {
+        offsets[v + 1] += offsets[v];
+    }
+
+    vector<uint32_t> remaining(vertexCount, 0);
+    vector<uint32_t> adjacency(offsets.back());
+    for (size_t t = 0; t < triangleCount; t++) {
+        for (int k = 0; k < 3; k++) {
+            GLuint v = local[t * 3 + k];
+            adjacency[offsets[v] + remaining[v]++] = (uint32_t)t;
+        }
+    }
+
+    vector<int> cachePosition(vertexCount, -1);
+    vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        vertexScore[v] = tables.score(-1, remaining[v]);
+    }
+
+    vector<bool> emitted(triangleCount, false);
+    vector<GLuint> output;
+    output.reserve(triangleCount * 3);
+
+    GLuint cache[FORSYTH_CACHE_SIZE + 3];
+    int cacheCount = 0;
+
+    size_t cursor = 0;
+    size_t best = 0;
+    while (output.size() < triangleCount * 3) {
+        // Nothing in the cache has triangles left, continue with the next one in input order
+        if (best == numeric_limits<size_t>::max()) {
+            while (emitted[cursor]) {
+                cursor++;
+            }
+            best = cursor;
+        }
+
+        emitted[best] = true;
+        GLuint triangle[3];
+        for (int k = 0; k < 3; k++) {
+            triangle[k] = local[best * 3 + k];
+            output.push_back(indices[best * 3 + k]);
+
+            // swap the triangle out of the vertex's remaining range
+            GLuint v = triangle[k];
+            uint32_t *begin = &adjacency[offsets[v]];
+            uint32_t *it = find(begin, begin + remaining[v], (uint32_t)best);
+            swap(*it, begin[--remaining[v]]);
+        }
+
+        // The emitted vertices move to the front, everything else shifts back
+        GLuint nextCache[FORSYTH_CACHE_SIZE + 3];
+        int nextCount = 0;
+        for (int k = 0; k < 3; k++) {
+            if (find(nextCache, nextCache + nextCount, triangle[k]) == nextCache + nextCount) {
+                nextCache[nextCount++] = triangle[k];
+            }
+        }
+        for (int i = 0; i < cacheCount; i++) {
+            if (find(nextCache, nextCache + nextCount, cache[i]) == nextCache + nextCount) {
+                nextCache[nextCount++] = cache[i];
+            }
+        }
+
+        for (int i = FORSYTH_CACHE_SIZE; i < nextCount; i++) {
+            cachePosition[nextCache[i]] = -1;
+            vertexScore[nextCache[i]] = tables.score(-1, remaining[nextCache[i]]);
+        }
+
+        cacheCount = std::min(nextCount, FORSYTH_CACHE_SIZE);
+        for (int i = 0; i < cacheCount; i++) {
+            cache[i] = nextCache[i];
+            cachePosition[cache[i]] = i;
+            vertexScore[cache[i]] = tables.score(i, remaining[cache[i]]);
+        }
+
+        // Only triangles touching the cache changed score, pick the best of them
+        float bestScore = -1.0f;
+        best = numeric_limits<size_t>::max();
+        for (int i = 0; i < cacheCount; i++) {
+            GLuint v = cache[i];
+            for (uint32_t j = 0; j < remaining[v]; j++) {
+                uint32_t t = adjacency[offsets[v] + j];
+                float score = vertexScore[local[t * 3]] + vertexScore[local[t * 3 + 1]] + vertexScore[local[t * 3 + 2]];
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+    }
+
+    copy(output.begin(), output.end(), indices);
+}
+
+void MeshOptimizer::optimizeOverdraw(GLuint *indices, size_t indexCount, const Vertex *vertices, float threshold) {
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2 || threshold <= 0.0f) {
+        return;
+    }
+
+    vector<GLuint> local;
+    size_t vertexCount = compactIndices(indices, indexCount, local);
+
+    vector<size_t> pushedAt(vertexCount, 0);
+    size_t time = OVERDRAW_CACHE_SIZE + 1;
+    auto countMisses = [&] (size_t t) {
+        size_t misses = 0;
+        for (int k = 0; k < 3; k++) {
+            GLuint v = local[t * 3 + k];
+            if (time - pushedAt[v] > OVERDRAW_CACHE_SIZE) {
+                pushedAt[v] = time++;
+                misses++;
+            }
+        }
+        return misses;
+    };
+    auto flushCache = [&] { time += OVERDRAW_CACHE_SIZE + 1; };
+
+    // Hard boundaries where a triangle misses the cache entirely, the order there doesn't matter for the cache
+    vector<size_t> hardClusters;
+    for (size_t t = 0; t < triangleCount; t++) {
+        if (countMisses(t) == 3 || t == 0) {
+            hardClusters.push_back(t);
+        }
+    }
+    hardClusters.push_back(triangleCount);
+
+    // Soft boundaries inside each, once the cluster (starting from an empty cache) is within threshold
+    // of the ACMR of the whole hard cluster, so moving it around costs little
+    vector<size_t> clusters;
+    for (size_t h = 0; h + 1 < hardClusters.size(); h++) {
+        size_t begin = hardClusters[h], end = hardClusters[h + 1];
+
+        flushCache();
+        size_t hardMisses = 0;
+        for (size_t t = begin; t < end; t++) {
+            hardMisses += countMisses(t);
+        }
+        float targetACMR = threshold * hardMisses / (end - begin);
+
+        flushCache();
+        size_t clusterStart = begin, clusterMisses = 0;
+        clusters.push_back(begin);
+        for (size_t t = begin; t < end; t++) {
+            clusterMisses += countMisses(t);
+            if ((float)clusterMisses / (t + 1 - clusterStart) <= targetACMR && t + 1 < end) {
+                clusters.push_back(t + 1);
+                clusterStart = t + 1;
+                clusterMisses = 0;
+                flushCache();
+            }
+        }
+    }
+    clusters.erase(std::unique(clusters.begin(), clusters.end()), clusters.end());
+    clusters.push_back(triangleCount);
+
+    size_t clusterCount = clusters.size() - 1;
+    if (clusterCount < 2) {
+        return;
+    }
+
+    // Area weighted centroid and normal per cluster
+    vector<glm::vec3> centroids(clusterCount), normals(clusterCount);
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusterCount; c++) {
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+            const glm::vec3 &p0 = vertices[indices[t * 3]].position;
+            const glm::vec3 &p1 = vertices[indices[t * 3 + 1]].position;
+            const glm::vec3 &p2 = vertices[indices[t * 3 + 2]].position;
+
+            glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+            float a = glm::length(n);
+            centroid += (p0 + p1 + p2) * (a / 3.0f);
+            normal += n;
+            area += a;
+        }
+
+        if (area > 0.0f) {
+            centroids[c] = centroid / area;
+        }
+        else {
+            const glm::vec3 &p = vertices[indices[clusters[c] * 3]].position;
+            centroids[c] = p;
+        }
+        float length = glm::length(normal);
+        normals[c] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+
+        meshCentroid += centroids[c] * area;
+        meshArea += area;
+    }
+    if (meshArea > 0.0f) {
+        meshCentroid /= meshArea;
+    }
+
+    // Clusters facing away from the center are likely to occlude the rest, draw them first
+    vector<float> sortKeys(clusterCount);
+    vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++) {
+        sortKeys[c] = glm::dot(centroids[c] - meshCentroid, normals[c]);
+        order[c] = c;
+    }
+    stable_sort(order.begin(), order.end(), [&] (size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    vector<GLuint> output;
+    output.reserve(triangleCount * 3);
+    for (size_t c : order) {
+        output.insert(output.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+    }
+
+    copy(output.begin(), output.end(), indices);
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<Drawable> &drawables) {
+    const GLuint unused = numeric_limits<GLuint>::max();
+
+    vector<GLuint> remap(vertices.size(), unused);
+    GLuint next = 0;
+    for (Drawable &d : drawables) {
+        for (GLuint &index : d.indices) {
+            if (remap[index] == unused) {
+                remap[index] = next++;
+            }
+            index = remap[index];
+        }
+    }
+
+    vector<Vertex> reordered(next);
+    for (size_t v = 0; v < vertices.size(); v++) {
+        if (remap[v] != unused) {
+            reordered[remap[v]] = vertices[v];
+        }
+    }
+
+    vertices.swap(reordered);
+}
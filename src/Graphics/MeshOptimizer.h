@@ -0,0 +1,40 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <Graphics/Mesh.h>
+
+#include <cstddef>
+#include <vector>
+
+// Triangle and vertex reordering run before a mesh is uploaded or cooked
+class MeshOptimizer {
+public:
+    // Post-transform cache behaviour of an index list, simulated with a FIFO cache
+    struct CacheStats {
+        size_t triangles = 0, vertices = 0, transformed = 0;
+
+        CacheStats &operator+=(const CacheStats &other);
+
+        // average cache miss ratio, transformed vertices per triangle (0.5 is ideal for large grids)
+        float getACMR() const { return triangles ? (float)transformed / triangles : 0.0f; }
+        // average transform to vertex ratio, 1.0 is ideal
+        float getATVR() const { return vertices ? (float)transformed / vertices : 0.0f; }
+    };
+
+    static CacheStats analyzeVertexCache(const GLuint *indices, size_t indexCount, unsigned int cacheSize = 16);
+
+    // Reorders triangles for post-transform cache locality (Forsyth, "Linear-Speed Vertex Cache Optimisation")
+    static void optimizeVertexCache(GLuint *indices, size_t indexCount);
+
+    // Splits the cache optimized order into clusters and draws outward facing clusters first.
+    // A cluster ends once its ACMR is within threshold times the ACMR of the stretch it was cut from.
+    static void optimizeOverdraw(GLuint *indices, size_t indexCount, const Vertex *vertices, float threshold);
+
+    // Reorders vertices by first use over all drawables and remaps their indices, drops unreferenced vertices
+    static void optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<Drawable> &drawables);
+
+private:
+    MeshOptimizer() {}
+};
+
+#endif
@@ -0,0 +1,403 @@
+#include "ObjLoader.h"
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+// The chunk parser reuses tinyobj's number and token parsing so the results are bit for bit identical
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+#include <MappedFile.h>
+#include <ThreadPool.h>
+#include <common.h>
+
+using namespace std;
+using namespace tinyobj;
+
+// Chunks smaller than this are not worth a task
+static const size_t MIN_CHUNK_SIZE = 1 << 20;
+
+// Set on a face-vertex component that was given as a negative (relative) index
+static const unsigned char RELATIVE_V = 1, RELATIVE_VN = 2, RELATIVE_VT = 4;
+
+struct ObjCommand {
+    enum Type { FACES, USEMTL, MTLLIB, GROUP, OBJECT };
+
+    Type type;
+    size_t faceCount; // FACES: number of consecutive faces
+    string arg;
+};
+
+struct ObjChunk {
+    const char *begin, *end;
+
+    vector<real_t> v, vn, vt;
+    vector<vertex_index> faceVertices;
+    vector<unsigned char> relative;
+    vector<unsigned int> faceSizes;
+    vector<ObjCommand> commands;
+};
+
+// tinyobj::fixIndex, except negative indices are resolved against the chunk's own counts and flagged
+static inline int fixIndexLocal(int idx, int n, unsigned char flag, unsigned char &relative) {
+    if (idx > 0) return idx - 1;
+    if (idx == 0) return 0;
+    relative |= flag;
+    return n + idx;
+}
+
+// tinyobj::parseTriple using fixIndexLocal
+static vertex_index parseTripleLocal(const char **token, int vsize, int vnsize, int vtsize, unsigned char &relative) {
+    vertex_index vi(-1);
+
+    vi.v_idx = fixIndexLocal(atoi((*token)), vsize, RELATIVE_V, relative);
+    (*token) += strcspn((*token), "/ \t\r");
+    if ((*token)[0] != '/') {
+        return vi;
+    }
+    (*token)++;
+
+    // i//k
+    if ((*token)[0] == '/') {
+        (*token)++;
+        vi.vn_idx = fixIndexLocal(atoi((*token)), vnsize, RELATIVE_VN, relative);
+        (*token) += strcspn((*token), "/ \t\r");
+        return vi;
+    }
+
+    // i/j/k or i/j
+    vi.vt_idx = fixIndexLocal(atoi((*token)), vtsize, RELATIVE_VT, relative);
+    (*token) += strcspn((*token), "/ \t\r");
+    if ((*token)[0] != '/') {
+        return vi;
+    }
+
+    // i/j/k
+    (*token)++;
+    vi.vn_idx = fixIndexLocal(atoi((*token)), vnsize, RELATIVE_VN, relative);
+    (*token) += strcspn((*token), "/ \t\r");
+    return vi;
+}
+
+static string scanName(const char *token) {
+    char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
+    namebuf[0] = '\0';
+#ifdef _MSC_VER
+    sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
+#else
+    sscanf(token, "%s", namebuf);
+#endif
+    return string(namebuf);
+}
+
+// Line handling follows tinyobj::LoadObj, state changes are recorded as commands for the merge
+static void parseChunk(ObjChunk &chunk) {
+    string linebuf;
+
+    const char *p = chunk.begin;
+    while (p < chunk.end) {
+        const char *lineEnd = p;
+        while (lineEnd < chunk.end && *lineEnd != '\n' && *lineEnd != '\r') {
+            lineEnd++;
+        }
+
+        // "\r\n" shows up as an extra empty line, which is skipped like any other
+        linebuf.assign(p, lineEnd);
+        p = lineEnd + 1;
+
+        if (linebuf.empty()) {
+            continue;
+        }
+
+        // Skip leading space.
+        const char *token = linebuf.c_str();
+        token += strspn(token, " \t");
+
+        if (token[0] == '\0') continue;  // empty line
+
+        if (token[0] == '#') continue;  // comment line
+
+        // vertex
+        if (token[0] == 'v' && IS_SPACE((token[1]))) {
+            token += 2;
+            real_t x, y, z;
+            parseReal3(&x, &y, &z, &token);
+            chunk.v.push_back(x);
+            chunk.v.push_back(y);
+            chunk.v.push_back(z);
+            continue;
+        }
+
+        // normal
+        if (token[0] == 'v' && token[1] == 'n' && IS_SPACE((token[2]))) {
+            token += 3;
+            real_t x, y, z;
+            parseReal3(&x, &y, &z, &token);
+            chunk.vn.push_back(x);
+            chunk.vn.push_back(y);
+            chunk.vn.push_back(z);
+            continue;
+        }
+
+        // texcoord
+        if (token[0] == 'v' && token[1] == 't' && IS_SPACE((token[2]))) {
+            token += 3;
+            real_t x, y;
+            parseReal2(&x, &y, &token);
+            chunk.vt.push_back(x);
+            chunk.vt.push_back(y);
+            continue;
+        }
+
+        // face
+        if (token[0] == 'f' && IS_SPACE((token[1]))) {
+            token += 2;
+            token += strspn(token, " \t");
+
+            unsigned int faceSize = 0;
+            while (!IS_NEW_LINE(token[0])) {
+                unsigned char relative = 0;
+                vertex_index vi = parseTripleLocal(&token,
+                                                   static_cast<int>(chunk.v.size() / 3),
+                                                   static_cast<int>(chunk.vn.size() / 3),
+                                                   static_cast<int>(chunk.vt.size() / 2),
+                                                   relative);
+                chunk.faceVertices.push_back(vi);
+                chunk.relative.push_back(relative);
+                faceSize++;
+                token += strspn(token, " \t\r");
+            }
+            chunk.faceSizes.push_back(faceSize);
+
+            if (chunk.commands.empty() || chunk.commands.back().type != ObjCommand::FACES) {
+                chunk.commands.push_back(ObjCommand { ObjCommand::FACES, 0, string() });
+            }
+            chunk.commands.back().faceCount++;
+            continue;
+        }
+
+        // use mtl
+        if ((0 == strncmp(token, "usemtl", 6)) && IS_SPACE((token[6]))) {
+            chunk.commands.push_back(ObjCommand { ObjCommand::USEMTL, 0, scanName(token + 7) });
+            continue;
+        }
+
+        // load mtl
+        if ((0 == strncmp(token, "mtllib", 6)) && IS_SPACE((token[6]))) {
+            chunk.commands.push_back(ObjCommand { ObjCommand::MTLLIB, 0, string(token + 7) });
+            continue;
+        }
+
+        // group name
+        if (token[0] == 'g' && IS_SPACE((token[1]))) {
+            vector<string> names;
+            while (!IS_NEW_LINE(token[0])) {
+                names.push_back(parseString(&token));
+                token += strspn(token, " \t\r");  // skip tag
+            }
+
+            // names[0] must be 'g', so skip the 0th element.
+            chunk.commands.push_back(ObjCommand { ObjCommand::GROUP, 0, names.size() > 1 ? names[1] : string() });
+            continue;
+        }
+
+        // object name
+        if (token[0] == 'o' && IS_SPACE((token[1]))) {
+            chunk.commands.push_back(ObjCommand { ObjCommand::OBJECT, 0, scanName(token + 2) });
+            continue;
+        }
+
+        // Ignore tags and unknown commands.
+    }
+}
+
+bool ObjLoader::load(attrib_t *attrib, vector<shape_t> *shapes, vector<material_t> *materials, string *err,
+                     const string &filename, const string &basedir, vector<string> *mtlFiles) {
+    attrib->vertices.clear();
+    attrib->normals.clear();
+    attrib->texcoords.clear();
+    shapes->clear();
+
+    MappedFile file;
+    if (!file.open(filename)) {
+        if (err) {
+            (*err) = "Cannot open file [" + filename + "]\n";
+        }
+        return false;
+    }
+
+    ThreadPool &pool = ThreadPool::getInstance();
+
+    // Split into chunks that start right after a line break
+    const char *data = reinterpret_cast<const char *>(file.data());
+    const char *dataEnd = data + file.size();
+    size_t chunkCount = min(max<size_t>(file.size() / MIN_CHUNK_SIZE, 1), pool.getThreadCount() * 4);
+    vector<ObjChunk> chunks(chunkCount);
+    const char *chunkBegin = data;
+    for (size_t i = 0; i < chunkCount; i++) {
+        const char *chunkEnd = (i + 1 == chunkCount) ? dataEnd : max(chunkBegin, data + file.size() * (i + 1) / chunkCount);
+        while (chunkEnd < dataEnd && chunkEnd > data && chunkEnd[-1] != '\n') {
+            chunkEnd++;
+        }
+
+        chunks[i].begin = chunkBegin;
+        chunks[i].end = chunkEnd;
+        chunkBegin = chunkEnd;
+    }
+
+    pool.parallelFor(chunkCount, [&] (size_t i) {
+        parseChunk(chunks[i]);
+    });
+
+    // Resolve relative indices against everything before the chunk and gather the attributes
+    vector<size_t> vBase(chunkCount), vnBase(chunkCount), vtBase(chunkCount);
+    size_t vCount = 0, vnCount = 0, vtCount = 0;
+    for (size_t i = 0; i < chunkCount; i++) {
+        vBase[i] = vCount;
+        vnBase[i] = vnCount;
+        vtBase[i] = vtCount;
+        vCount += chunks[i].v.size();
+        vnCount += chunks[i].vn.size();
+        vtCount += chunks[i].vt.size();
+    }
+
+    attrib->vertices.resize(vCount);
+    attrib->normals.resize(vnCount);
+    attrib->texcoords.resize(vtCount);
+
+    pool.parallelFor(chunkCount, [&] (size_t i) {
+        ObjChunk &chunk = chunks[i];
+
+        copy(chunk.v.begin(), chunk.v.end(), attrib->vertices.begin() + vBase[i]);
+        copy(chunk.vn.begin(), chunk.vn.end(), attrib->normals.begin() + vnBase[i]);
+        copy(chunk.vt.begin(), chunk.vt.end(), attrib->texcoords.begin() + vtBase[i]);
+        chunk.v = vector<real_t>();
+        chunk.vn = vector<real_t>();
+        chunk.vt = vector<real_t>();
+
+        for (size_t j = 0; j < chunk.faceVertices.size(); j++) {
+            unsigned char relative = chunk.relative[j];
+            vertex_index &vi = chunk.faceVertices[j];
+            if (relative & RELATIVE_V) vi.v_idx += static_cast<int>(vBase[i] / 3);
+            if (relative & RELATIVE_VN) vi.vn_idx += static_cast<int>(vnBase[i] / 3);
+            if (relative & RELATIVE_VT) vi.vt_idx += static_cast<int>(vtBase[i] / 2);
+        }
+        chunk.relative = vector<unsigned char>();
+    });
+
+    // Replay the recorded commands in file order. Faces go straight into the current shape,
+    // which is equivalent to tinyobj's face group that is flushed on every material change.
+    MaterialFileReader matFileReader(basedir);
+    map<string, int> material_map;
+    int material = -1;
+    string name;
+    shape_t shape;
+    size_t groupFaces = 0; // faces since the last flush
+
+    auto flushGroup = [&] () {
+        bool hadFaces = groupFaces > 0;
+        if (hadFaces) {
+            shape.name = name;
+        }
+        groupFaces = 0;
+        return hadFaces;
+    };
+
+    for (ObjChunk &chunk : chunks) {
+        size_t face = 0, faceVertex = 0;
+
+        for (const ObjCommand &command : chunk.commands) {
+            switch (command.type) {
+            case ObjCommand::FACES:
+                for (size_t n = 0; n < command.faceCount; n++, face++) {
+                    const vertex_index *fv = &chunk.faceVertices[faceVertex];
+                    size_t faceSize = chunk.faceSizes[face];
+                    faceVertex += faceSize;
+
+                    // Polygon -> triangle fan conversion
+                    for (size_t k = 2; k < faceSize; k++) {
+                        const vertex_index *tri[3] = { &fv[0], &fv[k - 1], &fv[k] };
+                        for (const vertex_index *vi : tri) {
+                            index_t idx;
+                            idx.vertex_index = vi->v_idx;
+                            idx.normal_index = vi->vn_idx;
+                            idx.texcoord_index = vi->vt_idx;
+                            shape.mesh.indices.push_back(idx);
+                        }
+
+                        shape.mesh.num_face_vertices.push_back(3);
+                        shape.mesh.material_ids.push_back(material);
+                    }
+                }
+                groupFaces += command.faceCount;
+                break;
+
+            case ObjCommand::USEMTL: {
+                auto it = material_map.find(command.arg);
+                int newMaterialId = it != material_map.end() ? it->second : -1;
+                if (newMaterialId != material) {
+                    // Per-face material, the shape is not finished yet
+                    flushGroup();
+                    material = newMaterialId;
+                }
+                break;
+            }
+
+            case ObjCommand::MTLLIB: {
+                vector<string> filenames;
+                SplitString(command.arg, ' ', filenames);
+
+                if (filenames.empty()) {
+                    if (err) {
+                        (*err) += "WARN: Looks like empty filename for mtllib. Use default material. \n";
+                    }
+                }
+                else {
+                    bool found = false;
+                    for (const string &mtlname : filenames) {
+                        string err_mtl;
+                        bool ok = matFileReader(mtlname.c_str(), materials, &material_map, &err_mtl);
+                        if (err && !err_mtl.empty()) {
+                            (*err) += err_mtl;
+                        }
+
+                        if (ok) {
+                            if (mtlFiles) {
+                                mtlFiles->push_back(basedir + mtlname);
+                            }
+                            found = true;
+                            break;
+                        }
+                    }
+
+                    if (!found && err) {
+                        (*err) += "WARN: Failed to load material file(s). Use default material.\n";
+                    }
+                }
+                break;
+            }
+
+            case ObjCommand::GROUP:
+            case ObjCommand::OBJECT:
+                // Only shapes with faces since the last flush are kept, as in tinyobj
+                if (flushGroup()) {
+                    shapes->push_back(std::move(shape));
+                }
+                shape = shape_t();
+                name = command.arg;
+                break;
+            }
+        }
+
+        chunk = ObjChunk();
+    }
+
+    if (flushGroup() || shape.mesh.indices.size()) {
+        shapes->push_back(std::move(shape));
+    }
+
+    return true;
+}
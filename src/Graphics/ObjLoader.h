@@ -0,0 +1,24 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include <string>
+#include <vector>
+
+#include <tiny_obj_loader.h>
+
+// Parallel drop-in for tinyobj::LoadObj (with triangulation). The file is mapped and
+// split into line-aligned chunks that are parsed concurrently, then merged in file
+// order so attrib, shapes and materials come out the same as from tinyobj.
+// Tag ('t') lines are ignored. The paths of the .mtl files that were read go to mtlFiles if given.
+class ObjLoader {
+public:
+    static bool load(tinyobj::attrib_t *attrib, std::vector<tinyobj::shape_t> *shapes,
+                     std::vector<tinyobj::material_t> *materials, std::string *err,
+                     const std::string &filename, const std::string &basedir,
+                     std::vector<std::string> *mtlFiles = nullptr);
+
+private:
+    ObjLoader() {}
+};
+
+#endif
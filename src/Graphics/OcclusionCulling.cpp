@@ -0,0 +1,177 @@
+#include "OcclusionCulling.h"
+
+#include <common.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// The depth buffer is copied with a blit, which needs the same format and sample count as the default framebuffer
+static GLenum getDefaultDepthFormat() {
+    GLint depthBits = 0, stencilBits = 0, componentType = GL_NONE;
+    glGetNamedFramebufferAttachmentParameteriv(0, GL_DEPTH, GL_FRAMEBUFFER_ATTACHMENT_DEPTH_SIZE, &depthBits);
+    glGetNamedFramebufferAttachmentParameteriv(0, GL_STENCIL, GL_FRAMEBUFFER_ATTACHMENT_STENCIL_SIZE, &stencilBits);
+    glGetNamedFramebufferAttachmentParameteriv(0, GL_DEPTH, GL_FRAMEBUFFER_ATTACHMENT_COMPONENT_TYPE, &componentType);
+
+    if (componentType == GL_FLOAT) {
+        return stencilBits > 0 ? GL_DEPTH32F_STENCIL8 : GL_DEPTH_COMPONENT32F;
+    }
+    if (depthBits <= 16) {
+        return GL_DEPTH_COMPONENT16;
+    }
+    return stencilBits > 0 ? GL_DEPTH24_STENCIL8 : GL_DEPTH_COMPONENT24;
+}
+
+OcclusionCulling::OcclusionCulling() {
+    glCreateBuffers(1, &counterBuffer);
+    glNamedBufferStorage(counterBuffer, sizeof(Stats), nullptr, GL_DYNAMIC_STORAGE_BIT);
+}
+
+OcclusionCulling::~OcclusionCulling() {
+    GLuint buffers[] = { visibleCommands, newCommands, counterBuffer };
+    glDeleteBuffers(3, buffers);
+    GLuint textures[] = { depthCopy, pyramid };
+    glDeleteTextures(2, textures);
+    glDeleteFramebuffers(1, &depthCopyFBO);
+}
+
+void OcclusionCulling::addPrograms(ProgramRegistry &programs) {
+    programs.add(cullProgram, "Cull Occlusion", {SHADER_DIR "cullOcclusion.comp"}, ProgramRegistry::OPTIONAL);
+    programs.add(pyramidProgram, "Build Depth Pyramid", {SHADER_DIR "buildDepthPyramid.comp"}, ProgramRegistry::OPTIONAL);
+}
+
+bool OcclusionCulling::isReady() {
+    return cullProgram.isReady() && cullProgram.isLinked() && pyramidProgram.isReady() && pyramidProgram.isLinked();
+}
+
+void OcclusionCulling::cull(const DrawList &drawList, const glm::mat4 &viewProjection, const Frustum &frustum, Phase phase) {
+    size_t drawCount = drawList.getDrawCount();
+
+    if (phase == FIRST_PHASE) {
+        // Keeps the last stats until a newer frame's copy is done
+        statsReadback.read(&stats);
+        glClearNamedBufferData(counterBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    }
+
+    if (drawCount == 0) {
+        return;
+    }
+
+    if (drawCount > capacity) {
+        capacity = max(drawCount, capacity * 2);
+        if (visibleCommands == 0) {
+            glCreateBuffers(1, &visibleCommands);
+            glCreateBuffers(1, &newCommands);
+        }
+        glNamedBufferData(visibleCommands, capacity * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_COPY);
+        glNamedBufferData(newCommands, capacity * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_COPY);
+    }
+
+    // Only the instance counts are written, the rest comes from the draw list
+    GLuint target = phase == FIRST_PHASE ? visibleCommands : newCommands;
+    glCopyNamedBufferSubData(drawList.getCommandBuffer(), target, 0, 0, drawCount * sizeof(DrawElementsIndirectCommand));
+
+    // Before the first pyramid is built the first phase culls everything, the second phase then draws it
+    cullProgram.bind();
+    cullProgram.setUniformMatrix4fv("viewProjection", viewProjection);
+    glUniform4fv(cullProgram.uniformLocation("frustumPlanes"), 6, &frustum.planes[0].x);
+    cullProgram.setUniform1ui("drawCount", drawCount);
+    cullProgram.setUniform1i("secondPhase", phase == SECOND_PHASE);
+
+    glBindTextureUnit(0, pyramid);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, drawList.getBoundsBuffer());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, visibleCommands);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, newCommands);
+    glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, counterBuffer);
+
+    glDispatchCompute((drawCount + 64 - 1) / 64, 1, 1);
+
+    glBindTextureUnit(0, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, 0);
+    glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, 0);
+    cullProgram.unbind();
+
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    if (phase == SECOND_PHASE) {
+        glCopyNamedBufferSubData(counterBuffer, statsReadback.beginWrite(), 0, 0, sizeof(Stats));
+        statsReadback.endWrite();
+    }
+}
+
+void OcclusionCulling::buildPyramid(int width, int height) {
+    if (width != this->width || height != this->height) {
+        resize(width, height);
+    }
+
+    glBlitNamedFramebuffer(0, depthCopyFBO, 0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+    pyramidProgram.bind();
+    pyramidProgram.setUniform1i("multisampled", depthSamples > 0);
+    pyramidProgram.setUniform1i("samples", depthSamples);
+    glBindTextureUnit(depthSamples > 0 ? 1 : 0, depthCopy);
+
+    static CachedUniform levelUniform {"level"};
+    for (GLint level = 0; level < pyramidLevels; level++) {
+        GLuint levelWidth = max(width >> level, 1), levelHeight = max(height >> level, 1);
+        glUniform1i(levelUniform.get(pyramidProgram), level);
+        if (level > 0) {
+            glBindImageTexture(0, pyramid, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        }
+        glBindImageTexture(1, pyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+        glDispatchCompute((levelWidth + 8 - 1) / 8, (levelHeight + 8 - 1) / 8, 1);
+
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+
+    glBindTextureUnit(depthSamples > 0 ? 1 : 0, 0);
+    glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(1, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    pyramidProgram.unbind();
+
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void OcclusionCulling::resize(int width, int height) {
+    this->width = width;
+    this->height = height;
+
+    GLuint textures[] = { depthCopy, pyramid };
+    glDeleteTextures(2, textures);
+    if (depthCopyFBO == 0) {
+        glCreateFramebuffers(1, &depthCopyFBO);
+        glNamedFramebufferDrawBuffer(depthCopyFBO, GL_NONE);
+        glNamedFramebufferReadBuffer(depthCopyFBO, GL_NONE);
+    }
+
+    GLenum depthFormat = getDefaultDepthFormat();
+    depthSamples = 0;
+    glGetNamedFramebufferParameteriv(0, GL_SAMPLES, &depthSamples);
+    if (depthSamples > 0) {
+        glCreateTextures(GL_TEXTURE_2D_MULTISAMPLE, 1, &depthCopy);
+        glTextureStorage2DMultisample(depthCopy, depthSamples, depthFormat, width, height, GL_TRUE);
+    }
+    else {
+        glCreateTextures(GL_TEXTURE_2D, 1, &depthCopy);
+        glTextureStorage2D(depthCopy, 1, depthFormat, width, height);
+        glTextureParameteri(depthCopy, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTextureParameteri(depthCopy, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+
+    GLenum attachment = depthFormat == GL_DEPTH24_STENCIL8 || depthFormat == GL_DEPTH32F_STENCIL8
+                      ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+    glNamedFramebufferTexture(depthCopyFBO, attachment, depthCopy, 0);
+    if (glCheckNamedFramebufferStatus(depthCopyFBO, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        LOG_ERROR("Failed to create the depth copy framebuffer for occlusion culling");
+    }
+
+    pyramidLevels = (GLint)floor(log2((float)max(width, height))) + 1;
+    glCreateTextures(GL_TEXTURE_2D, 1, &pyramid);
+    glTextureStorage2D(pyramid, pyramidLevels, GL_R32F, width, height);
+    glTextureParameteri(pyramid, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTextureParameteri(pyramid, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
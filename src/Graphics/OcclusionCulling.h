@@ -0,0 +1,71 @@
+#ifndef OCCLUSION_CULLING_H
+#define OCCLUSION_CULLING_H
+
+#include <Graphics/opengl.h>
+#include <Graphics/GLReadbackBuffer.h>
+#include <Graphics/GLShaderProgram.h>
+#include <Graphics/DrawList.h>
+#include <Graphics/Frustum.h>
+#include <Graphics/ProgramRegistry.h>
+#include <glm/glm.hpp>
+
+// Two phase occlusion culling against a hierarchical depth pyramid built from the depth prepass
+// (shaders/buildDepthPyramid.comp, cullOcclusion.comp). The first phase culls the draws against the
+// pyramid of the last frame, those are drawn into the depth buffer and the pyramid is rebuilt from it.
+// The second phase tests the draws again against the new pyramid, which catches the draws that became
+// visible this frame, so they're drawn late instead of popping in a frame later.
+// Culled draws keep their command with an instance count of 0, so each list is laid out like the
+// DrawList's command buffer and drawn with DrawList::drawIndirect.
+class OcclusionCulling {
+public:
+    enum Phase { FIRST_PHASE, SECOND_PHASE };
+
+    OcclusionCulling();
+    ~OcclusionCulling();
+
+    OcclusionCulling(const OcclusionCulling &other) = delete;
+    OcclusionCulling &operator=(const OcclusionCulling &other) = delete;
+
+    // The programs compile with the others as OPTIONAL, nothing can be culled until isReady()
+    void addPrograms(ProgramRegistry &programs);
+    bool isReady();
+
+    // The first phase writes getVisibleCommands(). The second phase writes the draws it found
+    // visible which the first phase missed to getNewCommands(), and every visible draw to getVisibleCommands().
+    void cull(const DrawList &drawList, const glm::mat4 &viewProjection, const Frustum &frustum, Phase phase);
+
+    // Rebuilds the pyramid from the depth buffer of the default framebuffer
+    void buildPyramid(int width, int height);
+
+    GLuint getVisibleCommands() const { return visibleCommands; }
+    GLuint getNewCommands() const { return newCommands; }
+    GLuint getPyramid() const { return pyramid; }
+
+    // Draws passing each phase and in the end, read back a few frames late
+    struct Stats {
+        GLuint firstPhase = 0, secondPhase = 0, visible = 0;
+    };
+    const Stats &getStats() const { return stats; }
+
+private:
+    void resize(int width, int height);
+
+    GLShaderProgram cullProgram, pyramidProgram;
+
+    GLuint visibleCommands = 0, newCommands = 0;
+    size_t capacity = 0;
+
+    // Counters of the frame being culled, copied out after the second phase and read once the copy is done
+    GLuint counterBuffer = 0;
+    GLReadbackBuffer statsReadback {"Occlusion culling stats", sizeof(Stats)};
+    Stats stats;
+
+    // Copy of the default framebuffer's depth, which compute shaders can't read directly
+    GLuint depthCopyFBO = 0, depthCopy = 0;
+    GLint depthSamples = 0;
+    GLuint pyramid = 0;
+    GLint pyramidLevels = 0;
+    int width = 0, height = 0;
+};
+
+#endif
@@ -0,0 +1,63 @@
+#include "ProgramRegistry.h"
+
+#include <common.h>
+
+using namespace std;
+
+ProgramRegistry::ProgramRegistry() {
+    // Let the driver use as many compiler threads as it likes
+    if (GLAD_GL_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    }
+    else if (GLAD_GL_ARB_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+    }
+}
+
+void ProgramRegistry::add(GLShaderProgram &program, const string &label, initializer_list<const string> shaderFiles, Priority priority) {
+    for (const string &file : shaderFiles) {
+        program.attachShader(file);
+    }
+    program.beginLink();
+    program.setObjectLabel(label);
+
+    Entry entry {&program, label, priority};
+    if (program.isReady()) {
+        // Loaded from the shader cache
+        finished(entry);
+        return;
+    }
+
+    pending.push_back(entry);
+    if (priority == REQUIRED) {
+        pendingRequired++;
+    }
+}
+
+void ProgramRegistry::update() {
+    for (size_t i = 0; i < pending.size();) {
+        if (pending[i].program->isReady()) {
+            if (pending[i].priority == REQUIRED) {
+                pendingRequired--;
+            }
+            finished(pending[i]);
+            pending[i] = pending.back();
+            pending.pop_back();
+        }
+        else {
+            i++;
+        }
+    }
+}
+
+void ProgramRegistry::finish() {
+    while (!pending.empty()) {
+        update();
+    }
+}
+
+void ProgramRegistry::finished(const Entry &entry) {
+    if (!entry.program->isLinked()) {
+        LOG_ERROR("Failed to link program ", entry.label);
+    }
+}
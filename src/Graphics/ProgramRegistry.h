@@ -0,0 +1,44 @@
+#ifndef PROGRAM_REGISTRY_H
+#define PROGRAM_REGISTRY_H
+
+#include <Graphics/GLShaderProgram.h>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+// Programs declared up front at init. Their compiles are all issued at once so the driver can run them
+// in parallel (KHR_parallel_shader_compile), and update() only picks up the ones that are done, so a
+// frame never waits on a compile. Rendering waits for the REQUIRED programs, passes with an OPTIONAL
+// program skip or fall back until it is ready.
+class ProgramRegistry {
+public:
+    enum Priority { REQUIRED, OPTIONAL };
+
+    ProgramRegistry();
+
+    ProgramRegistry(const ProgramRegistry &other) = delete;
+    ProgramRegistry &operator=(const ProgramRegistry &other) = delete;
+
+    void add(GLShaderProgram &program, const std::string &label, std::initializer_list<const std::string> shaderFiles, Priority priority = REQUIRED);
+
+    // Polls the programs still compiling, never blocks with the parallel compile extension
+    void update();
+    // Blocks until every program is linked
+    void finish();
+
+    bool requiredReady() const { return pendingRequired == 0; }
+    size_t getPendingCount() const { return pending.size(); }
+
+private:
+    struct Entry {
+        GLShaderProgram *program;
+        std::string label;
+        Priority priority;
+    };
+    std::vector<Entry> pending;
+    size_t pendingRequired = 0;
+
+    void finished(const Entry &entry);
+};
+
+#endif
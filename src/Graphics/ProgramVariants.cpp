@@ -0,0 +1,176 @@
+#include "ProgramVariants.h"
+
+#include <Graphics/GLHelper.h>
+#include <common.h>
+
+#include <cctype>
+#include <cstdio>
+
+using namespace std;
+
+bool ProgramVariants::enabled = true;
+
+// Must match the SPECIALIZE_ list at the end of shaders/frame.glsl
+struct Feature {
+    const char *name;
+    GLint FrameConstants::VoxelData::*voxel;
+    GLint FrameConstants::SettingsData::*settings;
+};
+
+#define VOXEL_FEATURE(name) { #name, &FrameConstants::VoxelData::name, nullptr }
+#define SETTINGS_FEATURE(name) { #name, nullptr, &FrameConstants::SettingsData::name }
+
+static const Feature FEATURES[] = {
+    VOXEL_FEATURE(warpVoxels),
+    VOXEL_FEATURE(warpTexture),
+    VOXEL_FEATURE(voxelizeTesselationWarp),
+    SETTINGS_FEATURE(voxelize),
+    SETTINGS_FEATURE(normals),
+    SETTINGS_FEATURE(dominant_axis),
+    SETTINGS_FEATURE(radiance),
+    SETTINGS_FEATURE(drawWarpSlope),
+    SETTINGS_FEATURE(drawOcclusion),
+    SETTINGS_FEATURE(debugOcclusion),
+    SETTINGS_FEATURE(debugIndirect),
+    SETTINGS_FEATURE(debugReflections),
+    SETTINGS_FEATURE(debugMaterialDiffuse),
+    SETTINGS_FEATURE(debugMaterialRoughness),
+    SETTINGS_FEATURE(debugMaterialMetallic),
+    SETTINGS_FEATURE(debugWarpTexture),
+    SETTINGS_FEATURE(toggle),
+    SETTINGS_FEATURE(cooktorrance),
+    SETTINGS_FEATURE(clusteredLighting),
+    SETTINGS_FEATURE(enablePostprocess),
+    SETTINGS_FEATURE(enableShadows),
+    SETTINGS_FEATURE(enableNormalMap),
+    SETTINGS_FEATURE(enableIndirect),
+    SETTINGS_FEATURE(enableDiffuse),
+    SETTINGS_FEATURE(enableSpecular),
+    SETTINGS_FEATURE(enableReflections),
+    SETTINGS_FEATURE(vctSpecularConeAngleFromRoughness),
+    SETTINGS_FEATURE(voxelizeDilate),
+    SETTINGS_FEATURE(voxelizeAtomicMax),
+    SETTINGS_FEATURE(voxelizeLighting),
+    SETTINGS_FEATURE(radianceLighting),
+    SETTINGS_FEATURE(radianceDilate),
+    SETTINGS_FEATURE(temporalFilterRadiance),
+    SETTINGS_FEATURE(voxelOctree),
+};
+
+#undef VOXEL_FEATURE
+#undef SETTINGS_FEATURE
+
+static const size_t FEATURE_COUNT = sizeof(FEATURES) / sizeof(FEATURES[0]);
+static_assert(FEATURE_COUNT <= 64, "Features must fit in the 64 bit variant key");
+
+// Replaces comments with a space, so identifiers only mentioned in them don't count
+static string stripComments(const string &source) {
+    string stripped;
+    stripped.reserve(source.size());
+    for (size_t i = 0; i < source.size(); i++) {
+        if (source.compare(i, 2, "//") == 0) {
+            i = source.find('\n', i);
+            if (i == string::npos) {
+                break;
+            }
+            stripped += '\n';
+        }
+        else if (source.compare(i, 2, "/*") == 0) {
+            i = source.find("*/", i + 2);
+            stripped += ' ';
+            if (i == string::npos) {
+                break;
+            }
+            i++;
+        }
+        else {
+            stripped += source[i];
+        }
+    }
+    return stripped;
+}
+
+// Whether name appears in source as a whole identifier
+static bool usesIdentifier(const string &source, const string &name) {
+    for (size_t i = source.find(name); i != string::npos; i = source.find(name, i + 1)) {
+        size_t end = i + name.size();
+        bool startsWord = i == 0 || !(isalnum((unsigned char)source[i - 1]) || source[i - 1] == '_');
+        bool endsWord = end == source.size() || !(isalnum((unsigned char)source[end]) || source[end] == '_');
+        if (startsWord && endsWord) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ProgramVariants::ProgramVariants(GLShaderProgram &generic, const string &label, initializer_list<const string> shaderFiles)
+    : generic{generic}, label{label}, shaderFiles(shaderFiles.begin(), shaderFiles.end()), mask{0} {
+    // frame.glsl mentions every feature, only what the rest of the sources use counts
+    const string frame = GLHelper::readText(SHADER_DIR "frame.glsl");
+
+    for (const string &file : shaderFiles) {
+        string source = GLHelper::readShaderSource(file);
+        for (size_t i = source.find(frame); i != string::npos; i = source.find(frame, i)) {
+            source.erase(i, frame.size());
+        }
+        source = stripComments(source);
+
+        for (size_t bit = 0; bit < FEATURE_COUNT; bit++) {
+            if (usesIdentifier(source, FEATURES[bit].name)) {
+                mask |= uint64_t(1) << bit;
+            }
+        }
+    }
+}
+
+uint64_t ProgramVariants::features(const FrameConstants &constants) {
+    uint64_t features = 0;
+    for (size_t bit = 0; bit < FEATURE_COUNT; bit++) {
+        const Feature &feature = FEATURES[bit];
+        GLint value = feature.voxel ? constants.voxel.*feature.voxel : constants.settings.*feature.settings;
+        if (value) {
+            features |= uint64_t(1) << bit;
+        }
+    }
+    return features;
+}
+
+string ProgramVariants::defines(uint64_t key) const {
+    string defines;
+    for (size_t bit = 0; bit < FEATURE_COUNT; bit++) {
+        if (!((mask >> bit) & 1)) {
+            continue;
+        }
+        defines += "#define SPECIALIZE_" + string(FEATURES[bit].name) + ((key >> bit) & 1 ? " true\n" : " false\n");
+    }
+    return defines;
+}
+
+GLShaderProgram &ProgramVariants::select(uint64_t features) {
+    if (!enabled) {
+        return generic;
+    }
+
+    uint64_t key = features & mask;
+    auto it = variants.find(key);
+    if (it == variants.end()) {
+        unique_ptr<GLShaderProgram> variant = make_unique<GLShaderProgram>();
+        for (const string &file : shaderFiles) {
+            variant->attachShader(file);
+        }
+        variant->setDefines(defines(key));
+        variant->beginLink();
+
+        char name[32];
+        snprintf(name, sizeof(name), " (%016llx)", (unsigned long long)key);
+        variant->setObjectLabel(label + name);
+
+        it = variants.emplace(key, move(variant)).first;
+    }
+
+    GLShaderProgram &variant = *it->second;
+    if (!variant.isReady() || !variant.isLinked()) {
+        return generic;
+    }
+    return variant;
+}
@@ -0,0 +1,45 @@
+#ifndef PROGRAM_VARIANTS_H
+#define PROGRAM_VARIANTS_H
+
+#include <Graphics/GLShaderProgram.h>
+#include <Graphics/FrameConstants.h>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Variants of a program with the booleans of FrameBlock, VoxelBlock and SettingsBlock compiled in as
+// constants (see the end of shaders/frame.glsl). A variant is keyed by the bits of the features its
+// sources actually use and compiled the first time it is selected. Until it is ready the generic
+// program, which reads the blocks at runtime, is used instead.
+class ProgramVariants {
+public:
+    static bool enabled;
+
+    ProgramVariants(GLShaderProgram &generic, const std::string &label, std::initializer_list<const std::string> shaderFiles);
+
+    ProgramVariants(const ProgramVariants &other) = delete;
+    ProgramVariants &operator=(const ProgramVariants &other) = delete;
+
+    // Bitmask of the features set in the constants of this frame
+    static uint64_t features(const FrameConstants &constants);
+
+    // Program to draw with for the features, never waits on a compile
+    GLShaderProgram &select(uint64_t features);
+
+    size_t getVariantCount() const { return variants.size(); }
+
+private:
+    GLShaderProgram &generic;
+    std::string label;
+    std::vector<std::string> shaderFiles;
+    uint64_t mask;  // features referenced by the sources
+
+    std::unordered_map<uint64_t, std::unique_ptr<GLShaderProgram>> variants;
+
+    std::string defines(uint64_t key) const;
+};
+
+#endif
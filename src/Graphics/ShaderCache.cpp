@@ -0,0 +1,163 @@
+#include "ShaderCache.h"
+
+#include <MappedFile.h>
+#include <common.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+#ifdef SHADER_CACHE_DIR
+bool ShaderCache::enabled = true;
+#else
+bool ShaderCache::enabled = false;
+#define SHADER_CACHE_DIR ""
+#endif
+
+ShaderCache::Stats ShaderCache::stats;
+
+static const char PROGRAM_BINARY_MAGIC[4] = { 'V', 'C', 'T', 'P' };
+static const uint32_t PROGRAM_BINARY_VERSION = 1;
+
+struct ProgramBinaryHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;       // catches file name collisions
+    uint32_t format;    // GLenum from glGetProgramBinary
+    uint32_t length;
+};
+
+static uint64_t fnv1a(uint64_t h, const void *data, size_t length) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < length; i++) {
+        h = (h ^ bytes[i]) * 1099511628211ull;
+    }
+    return h;
+}
+
+static uint64_t fnv1a(uint64_t h, const char *s) {
+    // Hash the terminator too, so consecutive strings can't run into each other
+    return fnv1a(h, s ? s : "", s ? strlen(s) + 1 : 1);
+}
+
+// Some drivers support no binary formats at all
+static bool binariesSupported() {
+    static GLint formats = -1;
+    if (formats < 0) {
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        if (formats == 0) {
+            LOG_INFO("Driver supports no program binary formats, shader cache disabled");
+        }
+    }
+    return formats > 0;
+}
+
+uint64_t ShaderCache::computeKey(const vector<Source> &sources) {
+    uint64_t h = 14695981039346656037ull;
+    h = fnv1a(h, &PROGRAM_BINARY_VERSION, sizeof(PROGRAM_BINARY_VERSION));
+
+    // A driver update changes the version string
+    h = fnv1a(h, (const char *)glGetString(GL_VENDOR));
+    h = fnv1a(h, (const char *)glGetString(GL_RENDERER));
+    h = fnv1a(h, (const char *)glGetString(GL_VERSION));
+    h = fnv1a(h, (const char *)glGetString(GL_SHADING_LANGUAGE_VERSION));
+
+    for (const Source &source : sources) {
+        h = fnv1a(h, &source.type, sizeof(source.type));
+        h = fnv1a(h, source.text.c_str(), source.text.size() + 1);
+    }
+
+    return h;
+}
+
+string ShaderCache::cacheFilename(uint64_t key) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+    return SHADER_CACHE_DIR + string(name);
+}
+
+bool ShaderCache::load(GLuint program, uint64_t key) {
+    if (!enabled || !binariesSupported()) {
+        return false;
+    }
+
+    MappedFile file;
+    if (!file.open(cacheFilename(key))) {
+        stats.misses++;
+        return false;
+    }
+
+    ProgramBinaryHeader header;
+    bool valid = file.size() >= sizeof(header);
+    if (valid) {
+        memcpy(&header, file.data(), sizeof(header));
+        valid = memcmp(header.magic, PROGRAM_BINARY_MAGIC, sizeof(header.magic)) == 0
+             && header.version == PROGRAM_BINARY_VERSION
+             && header.key == key
+             && file.size() == sizeof(header) + header.length;
+    }
+
+    if (valid) {
+        glProgramBinary(program, header.format, file.data() + sizeof(header), header.length);
+
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        valid = linked == GL_TRUE;
+    }
+
+    if (!valid) {
+        LOG_DEBUG("Ignoring stale program binary ", cacheFilename(key));
+        stats.rejected++;
+        stats.misses++;
+        return false;
+    }
+
+    stats.hits++;
+    return true;
+}
+
+void ShaderCache::store(GLuint program, uint64_t key) {
+    if (!enabled || !binariesSupported()) {
+        return;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    vector<unsigned char> buffer(sizeof(ProgramBinaryHeader) + length);
+    GLenum format = GL_NONE;
+    glGetProgramBinary(program, length, &length, &format, buffer.data() + sizeof(ProgramBinaryHeader));
+
+    ProgramBinaryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PROGRAM_BINARY_MAGIC, sizeof(header.magic));
+    header.version = PROGRAM_BINARY_VERSION;
+    header.key = key;
+    header.format = format;
+    header.length = length;
+    memcpy(buffer.data(), &header, sizeof(header));
+    buffer.resize(sizeof(header) + length);
+
+    // Write to a temporary file first so an interrupted write never leaves a truncated binary behind
+    string filename = cacheFilename(key);
+    string tmpname = filename + ".tmp";
+    FILE *fp = fopen(tmpname.c_str(), "wb");
+    if (fp == nullptr) {
+        LOG_WARN("Failed to write program binary ", filename, ": ", strerror(errno));
+        return;
+    }
+
+    bool written = fwrite(buffer.data(), 1, buffer.size(), fp) == buffer.size();
+    written = (fclose(fp) == 0) && written;
+
+    remove(filename.c_str());
+    if (!written || rename(tmpname.c_str(), filename.c_str()) != 0) {
+        LOG_WARN("Failed to write program binary ", filename, ": ", strerror(errno));
+        remove(tmpname.c_str());
+    }
+}
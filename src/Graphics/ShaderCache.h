@@ -0,0 +1,42 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <Graphics/opengl.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Disk cache of linked program binaries in SHADER_CACHE_DIR. Programs are keyed by a hash of their
+// preprocessed sources (so includes and defines are covered) and of the renderer and driver version.
+// A binary the driver rejects is recompiled from source and replaced.
+class ShaderCache {
+public:
+    static bool enabled;
+
+    struct Source {
+        GLenum type;
+        std::string filename;
+        std::string text;   // with includes resolved
+    };
+
+    static uint64_t computeKey(const std::vector<Source> &sources);
+
+    // Links program from the cached binary, false if there is none or the driver rejected it
+    static bool load(GLuint program, uint64_t key);
+
+    // Program must be linked, with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set before linking
+    static void store(GLuint program, uint64_t key);
+
+    struct Stats {
+        GLuint hits = 0, misses = 0;
+        GLuint rejected = 0;  // misses with a cached binary the driver didn't accept
+    };
+    static const Stats &getStats() { return stats; }
+
+private:
+    static std::string cacheFilename(uint64_t key);
+
+    static Stats stats;
+};
+
+#endif
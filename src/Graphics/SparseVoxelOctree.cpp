@@ -0,0 +1,226 @@
+#include "SparseVoxelOctree.h"
+
+#include <common.h>
+
+#include <cmath>
+#include <cstddef>
+
+using namespace std;
+
+static const GLuint BRICK_POOL_DIM = 2 * SparseVoxelOctree::BRICK_POOL_TILES;
+static const GLuint MAX_TILES = SparseVoxelOctree::BRICK_POOL_TILES * SparseVoxelOctree::BRICK_POOL_TILES * SparseVoxelOctree::BRICK_POOL_TILES;
+static const size_t FRAGMENT_SIZE = 3 * sizeof(GLuint);
+static const size_t FRAGMENT_HEADER_SIZE = 4 * sizeof(GLuint);
+
+static const GLuint NODE_BINDING = 10, FRAGMENT_BINDING = 11, INFO_BINDING = 12;
+static const size_t INFO_HEADER_SIZE = 8 * sizeof(GLuint);
+static const size_t LEVEL_SIZE = 8 * sizeof(GLuint);
+static const int MAX_DEPTH = 10;    // voxel positions are packed in 10 bits per axis
+
+static GLuint makeBrickPool(const char *label) {
+    GLuint texture;
+    glCreateTextures(GL_TEXTURE_3D, 1, &texture);
+    glObjectLabel(GL_TEXTURE, texture, -1, label);
+    glTextureStorage3D(texture, 1, GL_RGBA8, BRICK_POOL_DIM, BRICK_POOL_DIM, BRICK_POOL_DIM);
+    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+SparseVoxelOctree::SparseVoxelOctree() {
+    glCreateBuffers(1, &nodes);
+    glObjectLabel(GL_BUFFER, nodes, -1, "Octree nodes");
+    glNamedBufferStorage(nodes, MAX_TILES * 8 * sizeof(GLuint), nullptr, 0);
+
+    glCreateBuffers(1, &fragments);
+    glObjectLabel(GL_BUFFER, fragments, -1, "Octree fragments");
+    glNamedBufferStorage(fragments, FRAGMENT_HEADER_SIZE + MAX_FRAGMENTS * FRAGMENT_SIZE, nullptr, 0);
+
+    glCreateBuffers(1, &info);
+    glObjectLabel(GL_BUFFER, info, -1, "Octree info");
+    glNamedBufferStorage(info, INFO_HEADER_SIZE + (MAX_DEPTH + 2) * LEVEL_SIZE, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+    brickColor = makeBrickPool("Octree brick color");
+    brickNormal = makeBrickPool("Octree brick normal");
+    brickRadiance = makeBrickPool("Octree brick radiance");
+}
+
+SparseVoxelOctree::~SparseVoxelOctree() {
+    GLuint buffers[] = { nodes, fragments, info };
+    glDeleteBuffers(3, buffers);
+    GLuint textures[] = { brickColor, brickNormal, brickRadiance };
+    glDeleteTextures(3, textures);
+}
+
+void SparseVoxelOctree::addPrograms(ProgramRegistry &programs) {
+    programs.add(flagProgram, "Octree Flag", {SHADER_DIR "octreeFlag.comp"}, ProgramRegistry::OPTIONAL);
+    programs.add(allocProgram, "Octree Alloc", {SHADER_DIR "octreeAlloc.comp"}, ProgramRegistry::OPTIONAL);
+    programs.add(levelProgram, "Octree Level", {SHADER_DIR "octreeLevel.comp"}, ProgramRegistry::OPTIONAL);
+    programs.add(writeLeavesProgram, "Octree Write Leaves", {SHADER_DIR "octreeWriteLeaves.comp"}, ProgramRegistry::OPTIONAL);
+    programs.add(injectProgram, "Octree Inject Radiance", {SHADER_DIR "octreeInjectRadiance.comp"}, ProgramRegistry::OPTIONAL);
+    programs.add(filterProgram, "Octree Filter", {SHADER_DIR "octreeFilter.comp"}, ProgramRegistry::OPTIONAL);
+}
+
+bool SparseVoxelOctree::isReady() {
+    GLShaderProgram *octreePrograms[] = { &flagProgram, &allocProgram, &levelProgram, &writeLeavesProgram, &injectProgram, &filterProgram };
+    for (GLShaderProgram *program : octreePrograms) {
+        if (!program->isReady() || !program->isLinked()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SparseVoxelOctree::beginVoxelize() {
+    glClearNamedBufferSubData(fragments, GL_R32UI, 0, sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FRAGMENT_BINDING, fragments);
+}
+
+void SparseVoxelOctree::endVoxelize() {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FRAGMENT_BINDING, 0);
+}
+
+// Dispatches over the nodes at depth, or over the voxel fragments for 0, as sized by octreeLevel.comp
+static void dispatchLevel(int depth) {
+    glDispatchComputeIndirect(INFO_HEADER_SIZE + depth * LEVEL_SIZE + 2 * sizeof(GLuint));
+}
+
+void SparseVoxelOctree::build(int voxelDim) {
+    // Keeps the last stats until a newer build's copy is done
+    statsReadback.read(&stats);
+
+    depth = min((int)ceil(log2((float)voxelDim)), MAX_DEPTH);
+    if ((1 << depth) < voxelDim) {
+        LOG_WARN("Octree can't hold a voxelDim of ", voxelDim);
+    }
+
+    // Only the root tile exists, the level pass for depth 0 turns it into level 1
+    const GLuint rootTiles = 1;
+    glClearNamedBufferData(info, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glNamedBufferSubData(info, 0, sizeof(rootTiles), &rootTiles);
+    glClearNamedBufferData(nodes, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+    glClearTexImage(brickColor, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glClearTexImage(brickNormal, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glClearTexImage(brickRadiance, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, NODE_BINDING, nodes);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FRAGMENT_BINDING, fragments);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INFO_BINDING, info);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, info);
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    levelProgram.bind();
+    levelProgram.setUniform1i("depth", 0);
+    glDispatchCompute(1, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+    for (int d = 1; d < depth; d++) {
+        flagProgram.bind();
+        flagProgram.setUniform1i("depth", d);
+        dispatchLevel(0);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        allocProgram.bind();
+        allocProgram.setUniform1i("depth", d);
+        dispatchLevel(d);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        levelProgram.bind();
+        levelProgram.setUniform1i("depth", d);
+        glDispatchCompute(1, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+    }
+
+    writeLeavesProgram.bind();
+    glBindImageTexture(0, brickColor, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+    glBindImageTexture(1, brickNormal, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+    dispatchLevel(0);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    // Finish the leaf averages before radiance is injected into them
+    filterProgram.bind();
+    glBindImageTexture(0, brickColor, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
+    glBindImageTexture(1, brickNormal, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
+    glBindImageTexture(2, brickRadiance, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
+    filterProgram.setUniform1i("depth", depth);
+    dispatchLevel(depth);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    glBindImageTexture(0, 0, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
+    glBindImageTexture(1, 0, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
+    glBindImageTexture(2, 0, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
+    filterProgram.unbind();
+
+    GLuint statsBuffer = statsReadback.beginWrite();
+    glCopyNamedBufferSubData(fragments, statsBuffer, 0, offsetof(Stats, fragments), sizeof(GLuint));
+    glCopyNamedBufferSubData(info, statsBuffer, 0, offsetof(Stats, tiles), sizeof(GLuint));
+    statsReadback.endWrite();
+}
+
+void SparseVoxelOctree::injectRadiance(GLuint shadowmap, int shadowmapWidth, int shadowmapHeight) {
+    injectProgram.bind();
+
+    glBindImageTexture(0, brickColor, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA8);
+    glBindImageTexture(1, brickNormal, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA8);
+    glBindImageTexture(2, brickRadiance, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
+    glBindTextureUnit(1, shadowmap);
+    injectProgram.setUniform1i("shadowmap", 1);
+
+    // 2D workgroup should be the size of shadowmap, local_size = 16
+    glDispatchCompute((shadowmapWidth + 16 - 1) / 16, (shadowmapHeight + 16 - 1) / 16, 1);
+
+    glBindTextureUnit(1, 0);
+    glBindImageTexture(0, 0, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA8);
+    glBindImageTexture(1, 0, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA8);
+    glBindImageTexture(2, 0, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
+    injectProgram.unbind();
+
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+
+void SparseVoxelOctree::filter() {
+    filterProgram.bind();
+    glBindImageTexture(0, brickColor, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
+    glBindImageTexture(1, brickNormal, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
+    glBindImageTexture(2, brickRadiance, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
+
+    for (int d = depth - 1; d >= 1; d--) {
+        filterProgram.setUniform1i("depth", d);
+        dispatchLevel(d);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+
+    glBindImageTexture(0, 0, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
+    glBindImageTexture(1, 0, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
+    glBindImageTexture(2, 0, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
+    filterProgram.unbind();
+
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void SparseVoxelOctree::bind(GLuint colorUnit, GLuint normalUnit, GLuint radianceUnit) {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, NODE_BINDING, nodes);
+    glBindTextureUnit(colorUnit, brickColor);
+    glBindTextureUnit(normalUnit, brickNormal);
+    glBindTextureUnit(radianceUnit, brickRadiance);
+}
+
+void SparseVoxelOctree::unbind(GLuint colorUnit, GLuint normalUnit, GLuint radianceUnit) {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, NODE_BINDING, 0);
+    glBindTextureUnit(colorUnit, 0);
+    glBindTextureUnit(normalUnit, 0);
+    glBindTextureUnit(radianceUnit, 0);
+}
+
+size_t SparseVoxelOctree::getMemoryUsage() const {
+    size_t brickPool = (size_t)BRICK_POOL_DIM * BRICK_POOL_DIM * BRICK_POOL_DIM * 4;
+    return MAX_TILES * 8 * sizeof(GLuint)
+         + FRAGMENT_HEADER_SIZE + MAX_FRAGMENTS * FRAGMENT_SIZE
+         + 3 * brickPool;
+}
@@ -0,0 +1,65 @@
+#ifndef SPARSE_VOXEL_OCTREE_H
+#define SPARSE_VOXEL_OCTREE_H
+
+#include <Graphics/opengl.h>
+#include <Graphics/GLReadbackBuffer.h>
+#include <Graphics/GLShaderProgram.h>
+#include <Graphics/ProgramRegistry.h>
+
+// Sparse alternative to the dense VCT volumes, after OpenGL Insights chapter 22 (see shaders/octree.glsl).
+// The scene is voxelized into a list of voxel fragments (voxelize.frag with voxelizeFragmentList), the
+// octree is then subdivided one depth at a time where there are fragments, entirely on the GPU with
+// indirect dispatches over the nodes of each depth. Leaves average their fragments into the brick pools,
+// radiance is injected into the leaves and both are filtered up the tree in place of the mip chain.
+// Rebuilt from scratch every frame like the dense volumes.
+class SparseVoxelOctree {
+public:
+    // Tiles per axis of the brick pools, which also bounds the node pool
+    static const GLuint BRICK_POOL_TILES = 81;
+    static const GLuint MAX_FRAGMENTS = 1 << 22;
+
+    SparseVoxelOctree();
+    ~SparseVoxelOctree();
+
+    SparseVoxelOctree(const SparseVoxelOctree &other) = delete;
+    SparseVoxelOctree &operator=(const SparseVoxelOctree &other) = delete;
+
+    // The programs compile with the others as OPTIONAL, the octree can't be used until isReady()
+    void addPrograms(ProgramRegistry &programs);
+    bool isReady();
+
+    // Empties the fragment list and binds it for voxelize.frag
+    void beginVoxelize();
+    void endVoxelize();
+
+    // Subdivides down to the voxels of a voxelDim^3 volume and writes the fragments into the leaves
+    void build(int voxelDim);
+    void injectRadiance(GLuint shadowmap, int shadowmapWidth, int shadowmapHeight);
+    void filter();
+
+    // Binds the nodes and the color, normal and radiance brick pools in place of the dense textures
+    void bind(GLuint colorUnit, GLuint normalUnit, GLuint radianceUnit);
+    void unbind(GLuint colorUnit, GLuint normalUnit, GLuint radianceUnit);
+
+    // Size of the pools
+    size_t getMemoryUsage() const;
+
+    // Read back a few frames late. Either count can exceed its pool, what doesn't fit is dropped.
+    struct Stats {
+        GLuint fragments = 0, tiles = 0;
+    };
+    const Stats &getStats() const { return stats; }
+
+private:
+    GLShaderProgram flagProgram, allocProgram, levelProgram, writeLeavesProgram, injectProgram, filterProgram;
+
+    GLuint nodes = 0, fragments = 0, info = 0;
+    GLuint brickColor = 0, brickNormal = 0, brickRadiance = 0;
+    int depth = 0;
+
+    // Counters copied at the end of each build, read once the copy is done
+    GLReadbackBuffer statsReadback {"Octree stats", sizeof(Stats)};
+    Stats stats;
+};
+
+#endif
@@ -0,0 +1,304 @@
+#include "TextureStreamer.h"
+
+#include <Graphics/DDS.h>
+#include <Graphics/GLHelper.h>
+#include <ResourceLoader.h>
+#include <ThreadPool.h>
+#include <common.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+using namespace std;
+
+static string getFileExtension(const string &path) {
+    size_t pos = path.find_last_of('.');
+    return (pos == string::npos) ? path : path.substr(pos + 1);
+}
+
+TextureStreamer &TextureStreamer::getInstance() {
+    static TextureStreamer streamer;
+    return streamer;
+}
+
+TextureStreamer::~TextureStreamer() {
+    // Decode tasks still running on the pool push into this object
+    {
+        unique_lock<std::mutex> lock(mutex);
+        readyCondition.wait(lock, [this] { return completed + decoded.size() == requested; });
+    }
+
+}
+
+void TextureStreamer::request(const std::string &imagename, GLuint texture, ResidentCallback onResident) {
+    DecodedImage *image = new DecodedImage();
+    image->imagename = imagename;
+    image->texture = texture;
+    image->onResident = std::move(onResident);
+
+    {
+        lock_guard<std::mutex> lock(mutex);
+        requested++;
+    }
+
+    ThreadPool::getInstance().submit([this, image] {
+        image->decoded = decode(*image);
+        // notify under the lock, the destructor may be waiting for this task
+        lock_guard<std::mutex> lock(mutex);
+        decoded.emplace_back(image);
+        readyCondition.notify_all();
+    });
+}
+
+bool TextureStreamer::decode(DecodedImage &image) {
+    string filename = ResourceLoader::findCookedTexture(image.imagename);
+
+    if (getFileExtension(filename) == "dds") {
+        DDS::Image dds;
+        string err;
+        if (!image.file.open(filename) || !DDS::parse(image.file.data(), image.file.size(), dds, err)) {
+            return false;
+        }
+
+        // levels are contiguous, upload them as one range starting at the first
+        size_t begin = dds.levels.front().offset;
+        image.pixels = image.file.data() + begin;
+        image.size = dds.levels.back().offset + dds.levels.back().size - begin;
+        image.compressed = true;
+        image.internalFormat = dds.internalFormat;
+        image.width = dds.width;
+        image.height = dds.height;
+        for (const DDS::Level &level : dds.levels) {
+            image.levels.push_back(Level {level.offset - begin, level.size, level.width, level.height});
+        }
+
+        // fault the pages in here rather than in the copy on the GL thread
+        volatile unsigned char sum = 0;
+        for (size_t i = 0; i < image.size; i += 4096) {
+            sum += image.pixels[i];
+        }
+
+        return true;
+    }
+
+    int width, height, channels;
+    unsigned char *pixels = stbi_load(filename.c_str(), &width, &height, &channels, STBI_default);
+    if (pixels == nullptr) {
+        return false;
+    }
+
+    static const GLenum internalFormats[] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+    static const GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+
+    image.data = unique_ptr<unsigned char, void (*)(void *)>(pixels, stbi_image_free);
+    image.pixels = pixels;
+    image.internalFormat = internalFormats[channels - 1];
+    image.format = formats[channels - 1];
+    image.width = width;
+    image.height = height;
+    image.size = (size_t)width * height * channels;
+    image.levels.push_back(Level {0, image.size, width, height});
+
+    return true;
+}
+
+void TextureStreamer::update() {
+    retireStaging();
+
+    size_t uploaded = 0;
+    while (uploaded < bytesPerFrame) {
+        unique_ptr<DecodedImage> image;
+        {
+            lock_guard<std::mutex> lock(mutex);
+            if (decoded.empty()) {
+                break;
+            }
+            image = std::move(decoded.front());
+            decoded.pop_front();
+        }
+
+        if (image->decoded) {
+            if (!upload(*image)) {
+                // Its staging range is still being read, try again next frame
+                lock_guard<std::mutex> lock(mutex);
+                decoded.push_front(std::move(image));
+                break;
+            }
+            uploaded += image->size;
+            image->onResident(image->imagename, image->texture);
+        }
+        else {
+            LOG_ERROR("TEXTURE::LOAD_FAILED::", image->imagename);
+        }
+
+        lock_guard<std::mutex> lock(mutex);
+        completed++;
+    }
+}
+
+void TextureStreamer::finish() {
+    size_t budget = bytesPerFrame;
+    bytesPerFrame = numeric_limits<size_t>::max();
+
+    for (;;) {
+        {
+            unique_lock<std::mutex> lock(mutex);
+            readyCondition.wait(lock, [this] { return requested == completed || !decoded.empty(); });
+            if (requested == completed) {
+                break;
+            }
+        }
+        update();
+    }
+
+    bytesPerFrame = budget;
+}
+
+void TextureStreamer::shutdown() {
+    {
+        unique_lock<std::mutex> lock(mutex);
+        readyCondition.wait(lock, [this] { return completed + decoded.size() == requested; });
+        completed += decoded.size();
+        decoded.clear();
+    }
+
+    for (StagingRange &range : inflight) {
+        glDeleteSync(range.fence);
+    }
+    inflight.clear();
+
+    if (stagingBuffer != 0) {
+        glUnmapNamedBuffer(stagingBuffer);
+        glDeleteBuffers(1, &stagingBuffer);
+        stagingBuffer = 0;
+        stagingPtr = nullptr;
+        stagingHead = 0;
+    }
+}
+
+size_t TextureStreamer::getPendingCount() const {
+    lock_guard<std::mutex> lock(mutex);
+    return requested - completed;
+}
+
+bool TextureStreamer::upload(DecodedImage &image) {
+    if (stagingBuffer == 0) {
+        createStagingBuffer();
+    }
+
+    // Images that don't fit into the ring are uploaded from client memory
+    bool staged = image.size <= stagingSize;
+    uintptr_t source = (uintptr_t)image.pixels;
+    if (staged) {
+        size_t stagingOffset;
+        if (!allocateStaging(image.size, stagingOffset)) {
+            return false;
+        }
+        memcpy(stagingPtr + stagingOffset, image.pixels, image.size);
+
+        // with an unpack buffer bound the pointers are offsets into it
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+        source = stagingOffset;
+    }
+
+    GLuint texture = image.texture;
+    GLsizei levels = image.compressed ? (GLsizei)image.levels.size() : (GLsizei)std::log2(std::max(image.width, image.height)) + 1;
+
+    glTextureStorage2D(texture, levels, image.internalFormat, image.width, image.height);
+
+    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTextureParameteri(texture, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+    if (GLAD_GL_EXT_texture_filter_anisotropic) {
+        float maxAnisotropy = 1.0f;
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &maxAnisotropy);
+        glTextureParameterf(texture, GL_TEXTURE_MAX_ANISOTROPY, maxAnisotropy);
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (size_t i = 0; i < image.levels.size(); i++) {
+        const Level &level = image.levels[i];
+        const void *pixels = (const void *)(source + level.offset);
+
+        if (image.compressed) {
+            glCompressedTextureSubImage2D(texture, (GLint)i, 0, 0, level.width, level.height, image.internalFormat, (GLsizei)level.size, pixels);
+        }
+        else {
+            glTextureSubImage2D(texture, (GLint)i, 0, 0, level.width, level.height, image.format, GL_UNSIGNED_BYTE, pixels);
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    if (staged) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        inflight.push_back(StagingRange {source, source + image.size, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)});
+    }
+
+    if (!image.compressed) {
+        glGenerateTextureMipmap(texture);
+    }
+
+    return true;
+}
+
+void TextureStreamer::createStagingBuffer() {
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glCreateBuffers(1, &stagingBuffer);
+    glObjectLabel(GL_BUFFER, stagingBuffer, -1, "TextureStreamer staging");
+    glNamedBufferStorage(stagingBuffer, stagingSize, nullptr, flags);
+    stagingPtr = (unsigned char *)glMapNamedBufferRange(stagingBuffer, 0, stagingSize, flags);
+}
+
+bool TextureStreamer::allocateStaging(size_t size, size_t &offset) {
+    size_t begin = (stagingHead + 15) & ~(size_t)15;
+    if (begin + size > stagingSize) {
+        begin = 0;
+    }
+    size_t end = begin + size;
+
+    // Fences signal in order, so the last overlapping range being done covers every range before it
+    size_t retire = 0;
+    for (size_t i = 0; i < inflight.size(); i++) {
+        if (inflight[i].begin < end && begin < inflight[i].end) {
+            retire = i + 1;
+        }
+    }
+
+    if (retire > 0) {
+        // Never waits, the flush makes sure the fence signals by the time the upload is retried
+        GLenum status = glClientWaitSync(inflight[retire - 1].fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            return false;
+        }
+
+        for (size_t i = 0; i < retire; i++) {
+            glDeleteSync(inflight.front().fence);
+            inflight.pop_front();
+        }
+    }
+
+    stagingHead = end;
+    offset = begin;
+    return true;
+}
+
+void TextureStreamer::retireStaging() {
+    while (!inflight.empty()) {
+        GLenum status = glClientWaitSync(inflight.front().fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            break;
+        }
+
+        glDeleteSync(inflight.front().fence);
+        inflight.pop_front();
+    }
+}
@@ -0,0 +1,97 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <Graphics/opengl.h>
+#include <MappedFile.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Loads textures in the background. Images are decoded (or DDS files mapped) on the
+// ThreadPool and uploaded from the GL thread in update(), staged through a persistently
+// mapped pixel unpack buffer and limited to bytesPerFrame per frame.
+class TextureStreamer {
+public:
+    // Called on the GL thread once every level of the texture has been uploaded
+    typedef std::function<void(const std::string &imagename, GLuint texture)> ResidentCallback;
+
+    static TextureStreamer &getInstance();
+
+    ~TextureStreamer();
+
+    TextureStreamer(const TextureStreamer &other) = delete;
+    TextureStreamer &operator=(const TextureStreamer &other) = delete;
+
+    // texture must be a texture object without storage, it gets its storage when the image is uploaded
+    void request(const std::string &imagename, GLuint texture, ResidentCallback onResident);
+
+    // Uploads decoded images until the frame budget is used up, or until the staging ring is still in use
+    void update();
+
+    // Blocks until every requested texture is resident
+    void finish();
+
+    // Drops the textures not uploaded yet and frees the staging buffer, must be called while the
+    // context is still current since the singleton outlives it
+    void shutdown();
+
+    size_t getPendingCount() const;
+
+    size_t bytesPerFrame = 16 << 20;
+
+private:
+    struct Level {
+        size_t offset, size;
+        GLsizei width, height;
+    };
+
+    struct DecodedImage {
+        std::string imagename;
+        GLuint texture;
+        ResidentCallback onResident;
+
+        bool decoded = false, compressed = false;
+        GLenum internalFormat = 0, format = 0;
+        GLsizei width = 0, height = 0;
+        std::vector<Level> levels;
+        // points into data for decoded images and into file for dds files
+        const unsigned char *pixels = nullptr;
+        size_t size = 0;
+        std::unique_ptr<unsigned char, void (*)(void *)> data { nullptr, free };
+        MappedFile file;
+    };
+
+    struct StagingRange {
+        size_t begin, end;
+        GLsync fence;
+    };
+
+    TextureStreamer() {}
+
+    static bool decode(DecodedImage &image);
+    // Returns false without touching the texture when the staging ring is still in use
+    bool upload(DecodedImage &image);
+
+    void createStagingBuffer();
+    bool allocateStaging(size_t size, size_t &offset);
+    void retireStaging();
+
+    mutable std::mutex mutex;
+    std::condition_variable readyCondition;
+    std::deque<std::unique_ptr<DecodedImage>> decoded;
+    size_t requested = 0, completed = 0;
+
+    GLuint stagingBuffer = 0;
+    unsigned char *stagingPtr = nullptr;
+    size_t stagingSize = 64 << 20, stagingHead = 0;
+    std::deque<StagingRange> inflight;
+};
+
+#endif
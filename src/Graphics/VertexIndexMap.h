@@ -0,0 +1,86 @@
+#ifndef VERTEX_INDEX_MAP_H
+#define VERTEX_INDEX_MAP_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// OBJ face-vertex reference, -1 for a missing normal/texcoord
+struct VertexKey {
+    int vertex, normal, texcoord;
+
+    bool operator==(const VertexKey &other) const {
+        return vertex == other.vertex && normal == other.normal && texcoord == other.texcoord;
+    }
+};
+
+// Open addressing (linear probing) map from VertexKey to deduplicated vertex index.
+// All slots are allocated once up front for the expected number of keys, so lookups
+// and inserts never touch the heap. The table never grows, so expectedKeys must be
+// an upper bound (e.g. the number of face-vertices).
+class VertexIndexMap {
+public:
+    static const uint32_t EMPTY = 0xffffffff;
+
+    explicit VertexIndexMap(size_t expectedKeys) : mask(0), size(0) {
+        // keep the load factor at or below 0.5
+        size_t slotCount = 16;
+        while (slotCount < expectedKeys * 2) {
+            slotCount *= 2;
+        }
+
+        slots.reset(new Slot[slotCount]);
+        for (size_t i = 0; i < slotCount; i++) {
+            slots[i].value = EMPTY;
+        }
+        mask = slotCount - 1;
+    }
+
+    // Returns the index stored for key, or stores and returns value if key is new
+    uint32_t findOrInsert(const VertexKey &key, uint32_t value, bool &inserted) {
+        for (size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+            Slot &slot = slots[i];
+            if (slot.value == EMPTY) {
+                // at least one slot must stay empty or probing never terminates
+                assert(size < mask);
+                slot.key = key;
+                slot.value = value;
+                size++;
+                inserted = true;
+                return value;
+            }
+
+            if (slot.key == key) {
+                inserted = false;
+                return slot.value;
+            }
+        }
+    }
+
+    size_t getSize() const { return size; }
+
+private:
+    struct Slot {
+        VertexKey key;
+        uint32_t value;
+    };
+
+    static size_t hash(const VertexKey &key) {
+        // murmur3 finalizer over the combined indices
+        uint32_t h = (uint32_t)key.vertex * 0x9e3779b1u;
+        h ^= (uint32_t)key.normal * 0x85ebca77u;
+        h ^= (uint32_t)key.texcoord * 0xc2b2ae3du;
+        h ^= h >> 16;
+        h *= 0x85ebca6bu;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35u;
+        h ^= h >> 16;
+        return h;
+    }
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask, size;
+};
+
+#endif
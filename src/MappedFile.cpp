@@ -0,0 +1,98 @@
+#include "MappedFile.h"
+
+#include <cstring>
+#include <cerrno>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "common.h"
+
+bool MappedFile::open(const std::string &path) {
+    close();
+
+#ifdef _WIN32
+    HANDLE fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(fileHandle);
+        return false;
+    }
+
+    HANDLE mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle == nullptr) {
+        CloseHandle(fileHandle);
+        LOG_ERROR("Failed to map file ", path);
+        return false;
+    }
+
+    void *view = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+        CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        LOG_ERROR("Failed to map file ", path);
+        return false;
+    }
+
+    file = fileHandle;
+    mapping = mappingHandle;
+    ptr = static_cast<const unsigned char *>(view);
+    length = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void *view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+
+    if (view == MAP_FAILED) {
+        LOG_ERROR("Failed to map file ", path, ": ", strerror(errno));
+        return false;
+    }
+
+    ptr = static_cast<const unsigned char *>(view);
+    length = static_cast<size_t>(st.st_size);
+#endif
+
+    return true;
+}
+
+void MappedFile::close() {
+    if (ptr == nullptr) {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(ptr);
+    CloseHandle(mapping);
+    CloseHandle(file);
+    mapping = nullptr;
+    file = nullptr;
+#else
+    munmap(const_cast<unsigned char *>(ptr), length);
+#endif
+
+    ptr = nullptr;
+    length = 0;
+}
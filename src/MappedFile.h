@@ -0,0 +1,34 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() {}
+    explicit MappedFile(const std::string &path) { open(path); }
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile &other) = delete;
+    MappedFile &operator=(const MappedFile &other) = delete;
+
+    bool open(const std::string &path);
+    void close();
+
+    bool isOpen() const { return ptr != nullptr; }
+    const unsigned char *data() const { return ptr; }
+    size_t size() const { return length; }
+
+private:
+    const unsigned char *ptr = nullptr;
+    size_t length = 0;
+
+#ifdef _WIN32
+    void *file = nullptr;
+    void *mapping = nullptr;
+#endif
+};
+
+#endif
@@ -2,6 +2,8 @@
 #include <Application.h>
 #include <Camera.h>
 #include <Graphics/GLHelper.h>
+#include <Graphics/TextureStreamer.h>
+#include <Graphics/ShaderCache.h>
 #include <common.h>
 
 #include <Graphics/opengl.h>
@@ -116,12 +118,85 @@ void Overlay::render(float dt) {
                 );
             }
 
+            {
+                const Application::CullingInfo &info = app.cullingInfo;
+                nk_labelf(ctx, NK_TEXT_LEFT, "Draws submitted (shadowmap, voxelize, render): (%zu, %zu, %zu) of %zu",
+                    info.shadowmap, info.voxelize, info.render, info.total
+                );
+                nk_labelf(ctx, NK_TEXT_LEFT, "Draws culled (shadowmap, voxelize, render): (%zu, %zu, %zu)",
+                    info.total - info.shadowmap, info.total * info.voxelizePasses - info.voxelize, info.total - info.render
+                );
+                nk_labelf(ctx, NK_TEXT_LEFT, "Voxelized regions: %zu", app.voxelRegions.size());
+
+                const DrawList &drawList = app.scene->getDrawList();
+                nk_labelf(ctx, NK_TEXT_LEFT, "Scene BVH: %zu nodes, cost %.1f, %zu builds",
+                    drawList.getBVH().getNodeCount(), drawList.getBVH().getCost(), drawList.getBVHRebuildCount()
+                );
+                nk_labelf(ctx, NK_TEXT_LEFT, "Draw list: %zu draws in %zu batches, sorted %zu times",
+                    drawList.getDrawCount(), drawList.getBatchCount(), drawList.getSortCount()
+                );
+                if (settings.occlusionCulling && app.occlusionCullingReady) {
+                    const OcclusionCulling::Stats &stats = app.occlusionCulling.getStats();
+                    nk_labelf(ctx, NK_TEXT_LEFT, "Occlusion culling (first phase, second phase, visible): (%u, %u, %u)",
+                        stats.firstPhase, stats.secondPhase, stats.visible
+                    );
+                }
+                if (app.pickedActor >= 0) {
+                    nk_labelf(ctx, NK_TEXT_LEFT, "Picked actor %d at %.2f", app.pickedActor, app.pickedDistance);
+                }
+            }
+
+            const ShaderCache::Stats &shaderCacheStats = ShaderCache::getStats();
+            nk_labelf(ctx, NK_TEXT_LEFT, "Shader cache (hits, misses, rejected): (%u, %u, %u)",
+                shaderCacheStats.hits, shaderCacheStats.misses, shaderCacheStats.rejected
+            );
+
+            size_t variants = app.phongVariants.getVariantCount() + app.voxelizeVariants.getVariantCount()
+                            + app.injectRadianceVariants.getVariantCount() + app.transferVoxelsVariants.getVariantCount()
+                            + app.voxelizeTesselationVariants.getVariantCount();
+            nk_labelf(ctx, NK_TEXT_LEFT, "Shader variants: %zu", variants);
+
+            // Color and radiance keep their mip chains, normals and occupancy only the base level. Every
+            // clipmap cascade is a volume of its own.
+            size_t dense = 0;
+            for (int level = 0, dim = app.vct.voxelDim; level < app.vct.voxelLevels; level++, dim >>= 1) {
+                dense += (size_t)dim * dim * dim * 4 * 2 * app.vct.voxelCascades;
+            }
+            dense += (size_t)app.vct.voxelDim * app.vct.voxelDim * app.vct.voxelDim * 4 * app.vct.voxelCascades;
+            dense += (size_t)app.vct.voxelOccupancyDim * app.vct.voxelOccupancyDim * app.vct.voxelOccupancyDim * 4;
+            if (!app.voxelOctree()) {
+                nk_labelf(ctx, NK_TEXT_LEFT, "Voxel memory (%d cascades): %zu MB", app.vct.voxelCascades, dense >> 20);
+            }
+            else {
+                nk_labelf(ctx, NK_TEXT_LEFT, "Voxel memory (octree, dense): (%zu, %zu) MB",
+                    app.octree.getMemoryUsage() >> 20, dense >> 20
+                );
+
+                const SparseVoxelOctree::Stats &octreeStats = app.octree.getStats();
+                const GLuint maxTiles = SparseVoxelOctree::BRICK_POOL_TILES * SparseVoxelOctree::BRICK_POOL_TILES * SparseVoxelOctree::BRICK_POOL_TILES;
+                nk_labelf(ctx, NK_TEXT_LEFT, "Octree fragments: %u / %u, tiles: %u / %u",
+                    octreeStats.fragments, SparseVoxelOctree::MAX_FRAGMENTS, octreeStats.tiles, maxTiles
+                );
+            }
+
+            size_t pendingPrograms = app.programs.getPendingCount();
+            if (pendingPrograms > 0) {
+                nk_labelf(ctx, NK_TEXT_LEFT, "Compiling programs: %zu", pendingPrograms);
+            }
+
+            size_t pendingTextures = TextureStreamer::getInstance().getPendingCount();
+            if (pendingTextures > 0) {
+                nk_labelf(ctx, NK_TEXT_LEFT, "Streaming textures: %zu", pendingTextures);
+            }
+
             if (nk_tree_push(ctx, NK_TREE_NODE, "Timing Breakdown", NK_MINIMIZED)) {
                 nk_layout_row_dynamic(ctx, rowheight, 1);
                 nk_labelf(ctx, NK_TEXT_LEFT, "Voxelize: %.2f ms", app.voxelizeTimer.getTime() / 1.0e6);
+                nk_labelf(ctx, NK_TEXT_LEFT, "Octree Build: %.2f ms", app.octreeBuildTimer.getTime() / 1.0e6);
                 nk_labelf(ctx, NK_TEXT_LEFT, "Shadowmap: %.2f ms", app.shadowmapTimer.getTime() / 1.0e6);
                 nk_labelf(ctx, NK_TEXT_LEFT, "Radiance: %.2f ms", app.radianceTimer.getTime() / 1.0e6);
                 nk_labelf(ctx, NK_TEXT_LEFT, "Mipmap: %.2f ms", app.mipmapTimer.getTime() / 1.0e6);
+                nk_labelf(ctx, NK_TEXT_LEFT, "Light Culling: %.2f ms", app.lightCullingTimer.getTime() / 1.0e6);
                 nk_labelf(ctx, NK_TEXT_LEFT, "Render: %.2f ms", app.renderTimer.getTime() / 1.0e6);
                 nk_labelf(ctx, NK_TEXT_LEFT, "Total: %.2f ms", app.totalTimer.getTime() / 1.0e6);
 
@@ -138,6 +213,20 @@ void Overlay::render(float dt) {
 
             nk_checkbox_label(ctx, "Light Editor", &show_light_editor);
 
+            nk_layout_row_dynamic(ctx, rowheight, 2);
+            nk_checkbox_label(ctx, "Clustered Lighting", &settings.clusteredLighting);
+            nk_checkbox_label(ctx, "Frustum Culling", &settings.frustumCulling);
+            nk_checkbox_label(ctx, "Occlusion Culling", &settings.occlusionCulling);
+            int useBVH = DrawList::useBVH;
+            nk_checkbox_label(ctx, "Cull with BVH", &useBVH);
+            DrawList::useBVH = useBVH;
+            int specializeShaders = ProgramVariants::enabled;
+            nk_checkbox_label(ctx, "Specialized Shaders", &specializeShaders);
+            ProgramVariants::enabled = specializeShaders;
+            nk_checkbox_label(ctx, "Light Stress Test", &settings.lightStressTest);
+            nk_layout_row_dynamic(ctx, rowheight, 1);
+            nk_property_int(ctx, "Stress Lights", 0, &settings.lightStressCount, 65536, 256, 64.0f);
+
             nk_layout_row_dynamic(ctx, rowheight, 2);
             nk_checkbox_label(ctx, "Voxels", &settings.drawVoxels);
             nk_checkbox_label(ctx, "Dominant Axis", &settings.drawDominantAxis);
@@ -267,6 +356,7 @@ void Overlay::render(float dt) {
             nk_checkbox_label(ctx, "warpTexture", &settings.warpTexture);
             nk_checkbox_label(ctx, "warpTextureLinear", &settings.warpTextureLinear);
             nk_checkbox_label(ctx, "voxelFillHoles", &settings.voxelFillHoles);
+            nk_checkbox_label(ctx, "voxelOctree", &settings.voxelOctree);
             nk_checkbox_label(ctx, "voxelizeAtomicMax", &settings.voxelizeAtomicMax);
             if (nk_checkbox_label(ctx, "voxelTrackCamera", &settings.voxelTrackCamera)) {
                 // reset voxel center to origin after tracking
@@ -274,6 +364,12 @@ void Overlay::render(float dt) {
                     app.vct.center = glm::vec3(0.0f);
                 }
             }
+            nk_checkbox_label(ctx, "voxelScrolling", &settings.voxelScrolling);
+            nk_checkbox_label(ctx, "voxelizeStaticSplit", &settings.voxelizeStaticSplit);
+            nk_checkbox_label(ctx, "voxelizeDirtyRegions", &settings.voxelizeDirtyRegions);
+            if (settings.voxelizeStaticSplit && nk_button_label(ctx, "Revoxelize static")) {
+                app.scene->drawList.invalidateStatic();
+            }
 
             nk_layout_row_dynamic(ctx, rowheight, 2);
             nk_labelf(ctx, NK_TEXT_LEFT, "Ambient Scale: %0.1f", settings.ambientScale);
@@ -303,7 +399,7 @@ void Overlay::render(float dt) {
             static int nextVoxelResolution = app.vct.voxelDim;
             sprintf(tmp_buffer, "Set voxelDim (%d->%d)", app.vct.voxelDim, nextVoxelResolution);
             if (nk_button_label(ctx, tmp_buffer) && nextVoxelResolution != app.vct.voxelDim) {
-                app.vct.remake(nextVoxelResolution, app.vct.voxelLevels);
+                app.vct.remake(nextVoxelResolution, app.vct.voxelLevels, app.vct.voxelCascades);
             }
             const int minVoxelDim = 64, maxVoxelDim = 512;
             nk_slider_int(ctx, minVoxelDim, &nextVoxelResolution, maxVoxelDim, 64);
@@ -312,11 +408,19 @@ void Overlay::render(float dt) {
             static int nextVoxelLevels = app.vct.voxelLevels;
             sprintf(tmp_buffer, "Set voxelLevels (%d->%d)", app.vct.voxelLevels, nextVoxelLevels);
             if (nk_button_label(ctx, tmp_buffer) && nextVoxelLevels != app.vct.voxelLevels) {
-                app.vct.remake(app.vct.voxelDim, nextVoxelLevels);
+                app.vct.remake(app.vct.voxelDim, nextVoxelLevels, app.vct.voxelCascades);
             }
             const int minVoxelLevels = 1;
             nk_slider_int(ctx, minVoxelLevels, &nextVoxelLevels, std::log2(app.vct.voxelDim) + 1, 1);
 
+            nk_layout_row_dynamic(ctx, rowheight, 2);
+            static int nextVoxelCascades = app.vct.voxelCascades;
+            sprintf(tmp_buffer, "Set voxelCascades (%d->%d)", app.vct.voxelCascades, nextVoxelCascades);
+            if (nk_button_label(ctx, tmp_buffer) && nextVoxelCascades != app.vct.voxelCascades) {
+                app.vct.remake(app.vct.voxelDim, app.vct.voxelLevels, nextVoxelCascades);
+            }
+            nk_slider_int(ctx, 1, &nextVoxelCascades, VCT::MAX_CASCADES, 1);
+
             nk_layout_row_dynamic(ctx, rowheight, 1);
             static glm::vec3 nextVoxelExtentMin = app.vct.min, nextVoxelExtentMax = app.vct.max;
             sprintf(tmp_buffer, "voxelExtentMin: %.2f, %.2f, %.2f", nextVoxelExtentMin[0], nextVoxelExtentMin[1], nextVoxelExtentMin[2]);
@@ -5,7 +5,11 @@
 #include <string>
 #include <unordered_map>
 
+#include <sys/stat.h>
+
 #include "common.h"
+#include "MappedFile.h"
+#include "Graphics/DDS.h"
 #include "Graphics/Mesh.h"
 
 typedef std::shared_ptr<Mesh> MeshResource;
@@ -16,99 +20,84 @@ public:
         static std::unordered_map<std::string, MeshResource> meshes;
 
         if (meshes.count(meshname) == 0) {
-            auto entry = std::make_pair(meshname, std::make_shared<Mesh>(meshname));
-            meshes.insert(entry);
+            // Prefer the cooked binary unless the source OBJ has been modified since it was written,
+            // loadCookedMesh rejects it too once one of the .mtl files has changed
+            std::string cookedname = meshname + ".cooked";
+            auto mesh = std::make_shared<Mesh>();
+
+            bool cooked = isUpToDate(cookedname, meshname) && mesh->loadCookedMesh(meshname, cookedname);
+            if (!cooked) {
+                mesh->loadMesh(meshname, cookedname);
+            }
+
+            meshes.insert(std::make_pair(meshname, mesh));
         }
 
         return meshes.at(meshname);
     }
 
+    // Maps a block compressed dds file and uploads every stored mip level from the mapping
     static GLuint loadDDS(const std::string &path) {
-        // https://msdn.microsoft.com/en-us/library/windows/desktop/bb943991(v=vs.85).aspx
-        // http://www.opengl-tutorial.org/beginners-tutorials/tutorial-5-a-textured-cube/#compressed-textures
-        struct dds_header {
-            uint32_t dwSize, dwFlags, dwHeight, dwWidth, dwPitchOrLinearSize;
-            uint32_t dwDepth, dwMipMapCount, dwReserved1[11];
-            struct dds_pixelformat {
-                uint32_t dwSize, dwFlags, dwFourCC, dwRGBBitCount;
-                uint32_t dwRBitMask, dwGBitMask, dwBBitMask, dwABitMask;
-            } ddspf;
-            uint32_t dwCaps, dwCaps2, dwCaps3, dwCaps4, dwReserved2;
-        } hdr;
-
-        FILE *fp = fopen(path.c_str(), "rb");
-        if (fp == nullptr) {
-            LOG_ERROR("Failed to load dds file ", path, ": ", strerror(errno));
-            return 0;
-        }
-
-        char filecode[4];
-        fread(filecode, 1, 4, fp);
-        if (strncmp(filecode, "DDS ", 4) != 0) {
-            fclose(fp);
-            LOG_ERROR("Failed to load dds file ", path, ": invalid filecode '", filecode, "'");
+        MappedFile file;
+        if (!file.open(path)) {
+            LOG_ERROR("Failed to load dds file ", path, ": could not map file");
             return 0;
         }
 
-        fread(&hdr, 124, 1, fp);
-
-        unsigned int bufsize = hdr.dwMipMapCount > 1 ? hdr.dwPitchOrLinearSize * 2 : hdr.dwPitchOrLinearSize;
-        unsigned char *buffer = (unsigned char *)malloc(bufsize * sizeof(unsigned char));
-        fread(buffer, 1, bufsize, fp);
-
-        fclose(fp);
-
-        unsigned int components, format;
-        if (strncmp((char *)&hdr.ddspf.dwFourCC, "DXT1", 4) == 0) {
-            components = 3;
-            format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
-        }
-        else if (strncmp((char *)&hdr.ddspf.dwFourCC, "DXT3", 4) == 0) {
-            components = 4;
-            format = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
-        }
-        else if (strncmp((char *)&hdr.ddspf.dwFourCC, "DXT5", 4) == 0) {
-            components = 4;
-            format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
-        }
-        else {
-            free(buffer);
+        DDS::Image image;
+        std::string err;
+        if (!DDS::parse(file.data(), file.size(), image, err)) {
+            LOG_ERROR("Failed to load dds file ", path, ": ", err);
             return 0;
         }
 
         GLuint texture_id;
-        glGenTextures(1, &texture_id);
-        glBindTexture(GL_TEXTURE_2D, texture_id);
+        glCreateTextures(GL_TEXTURE_2D, 1, &texture_id);
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTextureParameteri(texture_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+        glTextureParameteri(texture_id, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTextureParameteri(texture_id, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTextureParameteri(texture_id, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTextureParameteri(texture_id, GL_TEXTURE_MAX_LEVEL, (GLint)image.levels.size() - 1);
 
         if (GLAD_GL_EXT_texture_filter_anisotropic) {
             float maxAnisotropy = 1.0f;
             glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &maxAnisotropy);
-            glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY, maxAnisotropy);
+            glTextureParameterf(texture_id, GL_TEXTURE_MAX_ANISOTROPY, maxAnisotropy);
         }
 
-        unsigned int blockSize = (format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) ? 8 : 16;
-        unsigned int offset = 0;
-        unsigned int width = hdr.dwWidth, height = hdr.dwHeight;
-        for (unsigned int level = 0; level < hdr.dwMipMapCount && (width || height); ++level) {
-            unsigned int size = ((width + 3) / 4) * ((height + 3) / 4) * blockSize;
-            glCompressedTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0, size, buffer + offset);
-            offset += size;
-            width /= 2;
-            height /= 2;
+        glTextureStorage2D(texture_id, (GLsizei)image.levels.size(), image.internalFormat, image.width, image.height);
+        for (size_t level = 0; level < image.levels.size(); level++) {
+            const DDS::Level &l = image.levels[level];
+            glCompressedTextureSubImage2D(texture_id, (GLint)level, 0, 0, l.width, l.height, image.internalFormat,
+                                          (GLsizei)l.size, file.data() + l.offset);
         }
-        glBindTexture(GL_TEXTURE_2D, 0);
 
-        free(buffer);
         return texture_id;
     }
 
+    // The output of the texture cooker if it exists and is up to date, path otherwise
+    static std::string findCookedTexture(const std::string &path) {
+        std::string cookedname = path + ".cooked.dds";
+        return isUpToDate(cookedname, path) ? cookedname : path;
+    }
+
 private:
     ResourceLoader() {}
+
+    // True if derived exists and is not older than source (or source is gone)
+    static bool isUpToDate(const std::string &derived, const std::string &source) {
+        struct stat derivedStat, sourceStat;
+        if (stat(derived.c_str(), &derivedStat) != 0) {
+            return false;
+        }
+
+        if (stat(source.c_str(), &sourceStat) != 0) {
+            return true;
+        }
+
+        return derivedStat.st_mtime >= sourceStat.st_mtime;
+    }
 };
 
 #endif
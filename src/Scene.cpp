@@ -4,73 +4,137 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <memory>
 
 #include "Graphics/Mesh.h"
 
+// Past this the dirty boxes are merged, nothing clears them while no frame is voxelized
+static const size_t MAX_DIRTY_BOXES = 64;
+
 Scene::Scene() {}
 
 void Scene::update(float dt) {
-    for (auto &actor : actors) {
-        actor->update(dt);
+    drawList.begin();
+    transformActors.clear();
+    for (std::size_t i = 0; i < actors.size(); i++) {
+        actors[i]->update(dt);
+        actors[i]->addDraws(drawList);
+        transformActors.resize(drawList.getAddedMeshCount(), i);
+    }
+    drawList.upload();
+    const std::vector<DrawList::MovedBox> &moved = drawList.getMovedBoxes();
+    dirtyBoxes.insert(dirtyBoxes.end(), moved.begin(), moved.end());
+    if (dirtyBoxes.size() > MAX_DIRTY_BOXES) {
+        mergeDirtyBoxes();
     }
 
     for (std::size_t i = 0; i < lights.size(); i++) {
         auto &light = lights[i];
 
         if (light.dirty) {
-            glBindBuffer(GL_SHADER_STORAGE_BUFFER, lightSSBO);
-            light.writeSSBO(i * Light::glslSize);
+            lightData[i] = light.getData();
+            lightDirtyBegin = lightDirtyBegin == lightDirtyEnd ? i : std::min(lightDirtyBegin, i);
+            lightDirtyEnd = std::max(lightDirtyEnd, i + 1);
+            light.dirty = false;
         }
     }
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    uploadLights();
 }
 
-void Scene::draw(GLShaderProgram &program, GLenum mode) {
-    for (auto &actor : actors) {
-        program.setUniformMatrix4fv("model", actor->getTransform());
-        actor->draw(program, mode);
+// Merges the dirty boxes into one static and one dynamic box, which still cover every out of date voxel
+void Scene::mergeDirtyBoxes() {
+    DrawList::MovedBox merged[2];
+    bool used[2] = { false, false };
+    for (const DrawList::MovedBox &box : dirtyBoxes) {
+        DrawList::MovedBox &m = merged[box.dynamic];
+        m.min = used[box.dynamic] ? glm::min(m.min, box.min) : box.min;
+        m.max = used[box.dynamic] ? glm::max(m.max, box.max) : box.max;
+        m.dynamic = box.dynamic;
+        used[box.dynamic] = true;
+    }
+
+    dirtyBoxes.clear();
+    for (int i = 0; i < 2; i++) {
+        if (used[i]) {
+            dirtyBoxes.push_back(merged[i]);
+        }
     }
 }
 
-void Scene::addLight(const Light &light) {
-    if (lightSSBO == 0) {
-        glCreateBuffers(1, &lightSSBO);
+size_t Scene::draw(GLShaderProgram &program, GLenum mode, const Frustum *frustum, DrawList::Subset subset) {
+    return drawList.draw(program, mode, frustum, subset);
+}
+
+void Scene::drawIndirect(GLShaderProgram &program, GLuint indirectBuffer, GLenum mode) {
+    drawList.drawIndirect(program, indirectBuffer, mode);
+}
+
+int Scene::raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, float &distance) const {
+    uint32_t draw = 0;
+    if (!drawList.getBVH().raycast(origin, direction, maxDistance, draw, distance)) {
+        return -1;
     }
+    return transformActors[drawList.getDrawTransform(draw)];
+}
 
+void Scene::addLight(const Light &light) {
     lights.push_back(light);
+    lightData.push_back(light.getData());
+
+    lightDirtyBegin = lightDirtyBegin == lightDirtyEnd ? lights.size() - 1 : lightDirtyBegin;
+    lightDirtyEnd = lights.size();
+}
 
-    // Extend buffer (orphaning old one)
-    glNamedBufferData(lightSSBO, lights.size() * Light::glslSize, nullptr, GL_STATIC_DRAW);
+void Scene::removeLights(size_t count) {
+    count = std::min(count, lights.size());
+    lights.resize(lights.size() - count);
+    lightData.resize(lights.size());
 
-    // Copy data to buffer
-    unsigned int offset = 0;
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, lightSSBO);
-    for (const auto &light : lights) {
-        light.writeSSBO(offset);
-        offset += Light::glslSize;
+    // The buffer keeps its capacity, bindLightSSBO only binds the remaining lights
+    lightDirtyEnd = std::min(lightDirtyEnd, lights.size());
+    lightDirtyBegin = std::min(lightDirtyBegin, lightDirtyEnd);
+}
+
+void Scene::uploadLights() {
+    if (lightData.size() > lightCapacity) {
+        // Grow geometrically, the old contents are rewritten below
+        lightCapacity = std::max(lightData.size(), lightCapacity * 2);
+        if (lightSSBO == 0) {
+            glCreateBuffers(1, &lightSSBO);
+        }
+        glNamedBufferData(lightSSBO, lightCapacity * sizeof(LightData), nullptr, GL_DYNAMIC_DRAW);
+
+        lightDirtyBegin = 0;
+        lightDirtyEnd = lightData.size();
+    }
+
+    if (lightDirtyBegin < lightDirtyEnd) {
+        glNamedBufferSubData(lightSSBO, lightDirtyBegin * sizeof(LightData),
+                             (lightDirtyEnd - lightDirtyBegin) * sizeof(LightData), &lightData[lightDirtyBegin]);
+        lightDirtyBegin = lightDirtyEnd = 0;
     }
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 }
 
-void Scene::bindLightSSBO(GLuint index) const {
+void Scene::bindLightSSBO(GLuint index) {
     assert(lights.size() > 0);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, index, lightSSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    uploadLights();
+    // The buffer may have room for more lights, LightBlock.lights[] must only see the used part
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, index, lightSSBO, 0, lights.size() * sizeof(LightData));
 }
 
-void Light::writeSSBO(unsigned int offset) const {
-    glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset + 0, 12, &position);
-    glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset + 16, 12, &direction);
-    glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset + 32, 12, &color);
-
-    glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset + 44, 4, &range);
-    glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset + 48, 4, &intensity);
-
-    glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset + 52, 4, &enabled);
-    glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset + 56, 4, &selected);
-    glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset + 60, 4, &shadowCaster);
-    glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset + 64, 4, &type);
+LightData Light::getData() const {
+    LightData data = {};
+    data.position = position;
+    data.direction = direction;
+    data.color = color;
+    data.range = range;
+    data.intensity = intensity;
+    data.enabled = enabled;
+    data.selected = selected;
+    data.shadowCaster = shadowCaster;
+    data.type = type;
+    return data;
 }
@@ -4,11 +4,34 @@
 #include <Graphics/opengl.h>
 #include <glm/glm.hpp>
 
+#include <cstddef>
 #include <string>
 #include <vector>
 #include <memory>
 
 #include <Actor.h>
+#include <Graphics/DrawList.h>
+
+// Matches Light in shaders/light.glsl (LightBlock, std140)
+struct LightData {
+    glm::vec3 position;
+    float pad0;
+    glm::vec3 direction;
+    float pad1;
+    glm::vec3 color;
+    float range;
+
+    float intensity;
+    GLuint enabled;
+    GLuint selected;
+    GLuint shadowCaster;
+    GLuint type;
+    GLuint pad2[3];
+};
+static_assert(offsetof(LightData, direction) == 16, "LightData must match the std140 layout of Light");
+static_assert(offsetof(LightData, range) == 44, "LightData must match the std140 layout of Light");
+static_assert(offsetof(LightData, type) == 64, "LightData must match the std140 layout of Light");
+static_assert(sizeof(LightData) == 80, "LightData must match the std140 array stride of Light");
 
 struct Light {
     enum Type { Point, Directional };
@@ -27,10 +50,7 @@ struct Light {
 
     bool dirty = false;
 
-    // Assumes buffer bound to GL_SHADER_STORAGE_BUFFER target
-    void writeSSBO(unsigned int offset) const;
-
-    static const unsigned int glslSize = 80;
+    LightData getData() const;
 };
 
 class Scene {
@@ -38,19 +58,50 @@ public:
     Scene();
     ~Scene() { glDeleteBuffers(1, &lightSSBO); }
 
+    // Updates actors and the draw list
     void update(float dt);
-    void draw(GLShaderProgram &program, GLenum mode = GL_TRIANGLES);
+    // Draws the actors of subset with the draw list built in update(), culled against frustum if given.
+    // Returns the number of draws submitted.
+    size_t draw(GLShaderProgram &program, GLenum mode = GL_TRIANGLES, const Frustum *frustum = nullptr, DrawList::Subset subset = DrawList::ALL);
+    // Draws with commands culled on the GPU, see DrawList::drawIndirect
+    void drawIndirect(GLShaderProgram &program, GLuint indirectBuffer, GLenum mode = GL_TRIANGLES);
+    size_t getDrawCount() const { return drawList.getDrawCount(); }
+    const DrawList &getDrawList() const { return drawList; }
+    // Boxes of the meshes that moved in the updates since clearDirtyBoxes(), the voxels they covered
+    // before and after moving are out of date. Merged into fewer, larger boxes when they pile up.
+    const std::vector<DrawList::MovedBox> &getDirtyBoxes() const { return dirtyBoxes; }
+    void clearDirtyBoxes() { dirtyBoxes.clear(); }
+
+    // Index into actors of the nearest actor whose drawable bounds the ray hits, -1 if none
+    int raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, float &distance) const;
 
     void addActor(std::shared_ptr<Actor> actor) { actors.push_back(actor); }
     void addLight(const Light &light);
+    // Removes the count most recently added lights
+    void removeLights(size_t count);
 
-    void bindLightSSBO(GLuint index) const;
+    // Uploads lights added or marked dirty since the last call and binds the buffer
+    void bindLightSSBO(GLuint index);
 
 // private:
     std::vector<std::shared_ptr<Actor>> actors;
     std::vector<Light> lights;
 
+    DrawList drawList;
+
     GLuint lightSSBO = 0;
+
+private:
+    void uploadLights();
+    void mergeDirtyBoxes();
+
+    // Actor of each addMesh call in the draw list
+    std::vector<size_t> transformActors;
+    std::vector<DrawList::MovedBox> dirtyBoxes;
+
+    std::vector<LightData> lightData;
+    size_t lightCapacity = 0;
+    size_t lightDirtyBegin = 0, lightDirtyEnd = 0;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,94 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed size pool of worker threads pulling tasks from a shared queue
+class ThreadPool {
+public:
+    // 0 picks one worker per hardware thread, minus the calling thread
+    explicit ThreadPool(size_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &other) = delete;
+    ThreadPool &operator=(const ThreadPool &other) = delete;
+
+    template<typename F>
+    std::future<typename std::result_of<F()>::type> submit(F &&fn) {
+        typedef typename std::result_of<F()>::type Result;
+
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(fn));
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.emplace_back([task] { (*task)(); });
+        }
+        condition.notify_one();
+
+        return result;
+    }
+
+    // Calls fn(i) for every i in [0, count) on the workers and the calling thread, returns once all calls are done.
+    // Must not be called from a pool thread.
+    template<typename F>
+    void parallelFor(size_t count, F &&fn) {
+        if (count == 0) {
+            return;
+        }
+
+        std::atomic<size_t> next(0);
+        auto run = [&] {
+            for (size_t i = next++; i < count; i = next++) {
+                fn(i);
+            }
+        };
+
+        size_t helperCount = std::min(count - 1, workers.size());
+        std::vector<std::future<void>> helpers;
+        helpers.reserve(helperCount);
+        for (size_t i = 0; i < helperCount; i++) {
+            helpers.push_back(submit(run));
+        }
+
+        run();
+        for (auto &helper : helpers) {
+            helper.get();
+        }
+    }
+
+    // Calls fn(begin, end) over [0, count) split into blocks of at most blockSize
+    template<typename F>
+    void parallelForBlocks(size_t count, size_t blockSize, F &&fn) {
+        size_t blockCount = (count + blockSize - 1) / blockSize;
+        parallelFor(blockCount, [&] (size_t block) {
+            size_t begin = block * blockSize;
+            fn(begin, std::min(begin + blockSize, count));
+        });
+    }
+
+    // Number of threads taking part in parallelFor, including the caller
+    size_t getThreadCount() const { return workers.size() + 1; }
+
+    static ThreadPool &getInstance();
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+};
+
+#endif
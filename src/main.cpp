@@ -241,6 +241,7 @@ int main() {
 
     LOG_INFO("Exitting...");
 
+    app.shutdown();
     glfwTerminate();
 
     return 0;
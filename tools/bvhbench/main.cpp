@@ -0,0 +1,210 @@
+// Compares the scene BVH against testing every box, for the frustum, box and ray queries the
+// renderer and picking make. Boxes are scattered at a constant density so larger counts mean a
+// larger world, as with bigger scenes rather than more detailed ones.
+//
+//     bvhbench [count...]     (default 1000 10000 100000)
+
+#include <Graphics/BVH.h>
+#include <Graphics/Frustum.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+static const int QUERY_COUNT = 256;
+
+struct Boxes {
+    vector<glm::vec3> mins, maxs;
+    // Centers and half extents per component, padded to a multiple of 4 for Frustum::cullBoxes
+    vector<float> center[3], extent[3];
+};
+
+static Boxes generateBoxes(size_t count, float worldSize, mt19937 &rng) {
+    uniform_real_distribution<float> position(0.0f, worldSize);
+    uniform_real_distribution<float> size(0.5f, 4.0f);
+
+    Boxes boxes;
+    boxes.mins.resize(count);
+    boxes.maxs.resize(count);
+    size_t paddedCount = (count + 3) & ~size_t(3);
+    for (int c = 0; c < 3; c++) {
+        boxes.center[c].assign(paddedCount, 0.0f);
+        boxes.extent[c].assign(paddedCount, 0.0f);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 center(position(rng), position(rng), position(rng));
+        glm::vec3 extent(size(rng), size(rng), size(rng));
+        boxes.mins[i] = center - extent;
+        boxes.maxs[i] = center + extent;
+        for (int c = 0; c < 3; c++) {
+            boxes.center[c][i] = center[c];
+            boxes.extent[c][i] = extent[c];
+        }
+    }
+    return boxes;
+}
+
+static bool overlaps(const glm::vec3 &minA, const glm::vec3 &maxA, const glm::vec3 &minB, const glm::vec3 &maxB) {
+    return minA.x <= maxB.x && maxA.x >= minB.x
+        && minA.y <= maxB.y && maxA.y >= minB.y
+        && minA.z <= maxB.z && maxA.z >= minB.z;
+}
+
+static bool rayBox(const glm::vec3 &origin, const glm::vec3 &invDirection, const glm::vec3 &min, const glm::vec3 &max, float maxDistance, float &distance) {
+    glm::vec3 t0 = (min - origin) * invDirection;
+    glm::vec3 t1 = (max - origin) * invDirection;
+    glm::vec3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+    float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+    float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+    distance = enter;
+    return enter <= exit;
+}
+
+template<typename F>
+static double milliseconds(F f) {
+    auto start = chrono::high_resolution_clock::now();
+    f();
+    return chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+}
+
+static void run(size_t count) {
+    mt19937 rng(1234);
+    float worldSize = 20.0f * cbrt((float)count);
+    Boxes boxes = generateBoxes(count, worldSize, rng);
+
+    uniform_real_distribution<float> unit(0.0f, 1.0f);
+    auto randomPoint = [&] () { return glm::vec3(unit(rng), unit(rng), unit(rng)) * worldSize; };
+
+    vector<Frustum> frustums(QUERY_COUNT);
+    vector<glm::vec3> boxMins(QUERY_COUNT), boxMaxs(QUERY_COUNT);
+    vector<glm::vec3> rayOrigins(QUERY_COUNT), rayDirections(QUERY_COUNT);
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 0.25f * worldSize);
+    for (int q = 0; q < QUERY_COUNT; q++) {
+        glm::vec3 eye = randomPoint();
+        frustums[q] = Frustum::fromMatrix(projection * glm::lookAt(eye, randomPoint(), glm::vec3(0.0f, 1.0f, 0.0f)));
+
+        glm::vec3 center = randomPoint();
+        boxMins[q] = center - glm::vec3(0.05f * worldSize);
+        boxMaxs[q] = center + glm::vec3(0.05f * worldSize);
+
+        rayOrigins[q] = randomPoint();
+        rayDirections[q] = randomPoint() - rayOrigins[q];
+    }
+
+    BVH bvh;
+    double buildTime = milliseconds([&] () { bvh.build(boxes.mins.data(), boxes.maxs.data(), count); });
+
+    // Every box moved a little, as when actors animate
+    vector<glm::vec3> movedMins = boxes.mins, movedMaxs = boxes.maxs;
+    uniform_real_distribution<float> jitter(-1.0f, 1.0f);
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 offset(jitter(rng), jitter(rng), jitter(rng));
+        movedMins[i] += offset;
+        movedMaxs[i] += offset;
+    }
+    BVH refitted = bvh;
+    double refitTime = milliseconds([&] () { refitted.refit(movedMins.data(), movedMaxs.data()); });
+
+    size_t mismatches = 0, linearHits = 0, bvhHits = 0;
+    vector<uint8_t> visible(boxes.center[0].size());
+    vector<uint32_t> result;
+    const float *center[3] = { boxes.center[0].data(), boxes.center[1].data(), boxes.center[2].data() };
+    const float *extent[3] = { boxes.extent[0].data(), boxes.extent[1].data(), boxes.extent[2].data() };
+
+    double linearFrustum = milliseconds([&] () {
+        for (int q = 0; q < QUERY_COUNT; q++) {
+            frustums[q].cullBoxes(center, extent, count, visible.data());
+            for (size_t i = 0; i < count; i++) {
+                linearHits += visible[i];
+            }
+        }
+    });
+    double bvhFrustum = milliseconds([&] () {
+        for (int q = 0; q < QUERY_COUNT; q++) {
+            result.clear();
+            bvh.queryFrustum(frustums[q], result);
+            bvhHits += result.size();
+        }
+    });
+    mismatches += linearHits != bvhHits;
+
+    linearHits = bvhHits = 0;
+    double linearBox = milliseconds([&] () {
+        for (int q = 0; q < QUERY_COUNT; q++) {
+            for (size_t i = 0; i < count; i++) {
+                linearHits += overlaps(boxes.mins[i], boxes.maxs[i], boxMins[q], boxMaxs[q]);
+            }
+        }
+    });
+    double bvhBox = milliseconds([&] () {
+        for (int q = 0; q < QUERY_COUNT; q++) {
+            result.clear();
+            bvh.queryBox(boxMins[q], boxMaxs[q], result);
+            bvhHits += result.size();
+        }
+    });
+    mismatches += linearHits != bvhHits;
+
+    vector<float> linearDistances(QUERY_COUNT), bvhDistances(QUERY_COUNT);
+    double linearRay = milliseconds([&] () {
+        for (int q = 0; q < QUERY_COUNT; q++) {
+            glm::vec3 invDirection = 1.0f / rayDirections[q];
+            float nearest = numeric_limits<float>::infinity();
+            for (size_t i = 0; i < count; i++) {
+                float distance;
+                if (rayBox(rayOrigins[q], invDirection, boxes.mins[i], boxes.maxs[i], 1.0f, distance)) {
+                    nearest = std::min(nearest, distance);
+                }
+            }
+            linearDistances[q] = nearest;
+        }
+    });
+    double bvhRay = milliseconds([&] () {
+        for (int q = 0; q < QUERY_COUNT; q++) {
+            uint32_t item;
+            float distance;
+            bvhDistances[q] = bvh.raycast(rayOrigins[q], rayDirections[q], 1.0f, item, distance)
+                ? distance : numeric_limits<float>::infinity();
+        }
+    });
+    for (int q = 0; q < QUERY_COUNT; q++) {
+        mismatches += linearDistances[q] != bvhDistances[q];
+    }
+
+    printf("%8zu %7zu %8.2f %8.2f | %9.4f %9.4f | %9.4f %9.4f | %9.4f %9.4f | %s\n",
+        count, bvh.getNodeCount(), buildTime, refitTime,
+        linearFrustum / QUERY_COUNT, bvhFrustum / QUERY_COUNT,
+        linearBox / QUERY_COUNT, bvhBox / QUERY_COUNT,
+        linearRay / QUERY_COUNT, bvhRay / QUERY_COUNT,
+        mismatches == 0 ? "ok" : "MISMATCH"
+    );
+}
+
+int main(int argc, char **argv) {
+    vector<size_t> counts;
+    for (int i = 1; i < argc; i++) {
+        counts.push_back(strtoul(argv[i], nullptr, 10));
+    }
+    if (counts.empty()) {
+        counts = { 1000, 10000, 100000 };
+    }
+
+    printf("Milliseconds, build and refit once, queries averaged over %d\n", QUERY_COUNT);
+    printf("%8s %7s %8s %8s | %9s %9s | %9s %9s | %9s %9s |\n",
+        "boxes", "nodes", "build", "refit", "frustum", "(bvh)", "box", "(bvh)", "ray", "(bvh)");
+    for (size_t count : counts) {
+        run(count);
+    }
+    return 0;
+}
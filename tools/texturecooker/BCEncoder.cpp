@@ -0,0 +1,290 @@
+#include "BCEncoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+// Mean and dominant direction of the first n channels of a block (power iteration on the covariance)
+static void fitAxis(const float texels[16][4], int n, float mean[4], float axis[4]) {
+    float lo[4], hi[4];
+    for (int c = 0; c < 4; c++) {
+        mean[c] = 0.0f;
+        lo[c] = hi[c] = texels[0][c];
+    }
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < n; c++) {
+            mean[c] += texels[i][c] / 16.0f;
+            lo[c] = min(lo[c], texels[i][c]);
+            hi[c] = max(hi[c], texels[i][c]);
+        }
+    }
+
+    float cov[4][4] = {};
+    for (int i = 0; i < 16; i++) {
+        float d[4];
+        for (int c = 0; c < n; c++) {
+            d[c] = texels[i][c] - mean[c];
+        }
+        for (int a = 0; a < n; a++) {
+            for (int b = 0; b < n; b++) {
+                cov[a][b] += d[a] * d[b];
+            }
+        }
+    }
+
+    for (int c = 0; c < 4; c++) {
+        axis[c] = c < n ? hi[c] - lo[c] : 0.0f;
+    }
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[4] = {};
+        for (int a = 0; a < n; a++) {
+            for (int b = 0; b < n; b++) {
+                next[a] += cov[a][b] * axis[b];
+            }
+        }
+
+        float length = 0.0f;
+        for (int c = 0; c < n; c++) {
+            length = max(length, fabs(next[c]));
+        }
+        if (length == 0.0f) {
+            break;
+        }
+        for (int c = 0; c < n; c++) {
+            axis[c] = next[c] / length;
+        }
+    }
+
+    float length = 0.0f;
+    for (int c = 0; c < n; c++) {
+        length += axis[c] * axis[c];
+    }
+    length = sqrt(length);
+    for (int c = 0; c < n; c++) {
+        axis[c] = length > 0.0f ? axis[c] / length : 0.0f;
+    }
+}
+
+// Endpoints at the extremes of the texels projected onto the axis, pulled in slightly to reduce error
+static void fitEndpoints(const float texels[16][4], int n, float e0[4], float e1[4]) {
+    float mean[4], axis[4];
+    fitAxis(texels, n, mean, axis);
+
+    float tmin = 0.0f, tmax = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        float t = 0.0f;
+        for (int c = 0; c < n; c++) {
+            t += (texels[i][c] - mean[c]) * axis[c];
+        }
+        tmin = min(tmin, t);
+        tmax = max(tmax, t);
+    }
+
+    float inset = (tmax - tmin) / 32.0f;
+    tmin += inset;
+    tmax -= inset;
+
+    for (int c = 0; c < 4; c++) {
+        e0[c] = min(max(mean[c] + axis[c] * tmax, 0.0f), 255.0f);
+        e1[c] = min(max(mean[c] + axis[c] * tmin, 0.0f), 255.0f);
+    }
+}
+
+static void loadTexels(const uint8_t rgba[64], float texels[16][4]) {
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 4; c++) {
+            texels[i][c] = rgba[i * 4 + c];
+        }
+    }
+}
+
+static int nearestIndex(const float texel[4], const int palette[][4], int count, int n) {
+    int best = 0;
+    float bestError = 1e30f;
+    for (int p = 0; p < count; p++) {
+        float error = 0.0f;
+        for (int c = 0; c < n; c++) {
+            float d = texel[c] - palette[p][c];
+            error += d * d;
+        }
+        if (error < bestError) {
+            bestError = error;
+            best = p;
+        }
+    }
+    return best;
+}
+
+static uint16_t packRGB565(const float color[4]) {
+    int r = (int)lround(color[0] * 31.0f / 255.0f);
+    int g = (int)lround(color[1] * 63.0f / 255.0f);
+    int b = (int)lround(color[2] * 31.0f / 255.0f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void unpackRGB565(uint16_t packed, int color[4]) {
+    int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+    color[3] = 255;
+}
+
+void BCEncoder::encodeBC1(const uint8_t rgba[64], uint8_t block[8]) {
+    float texels[16][4];
+    loadTexels(rgba, texels);
+
+    float e0[4], e1[4];
+    fitEndpoints(texels, 3, e0, e1);
+
+    // c0 > c1 selects the four color mode
+    uint16_t c0 = packRGB565(e0), c1 = packRGB565(e1);
+    if (c0 < c1) {
+        swap(c0, c1);
+    }
+
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        int palette[4][4];
+        unpackRGB565(c0, palette[0]);
+        unpackRGB565(c1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (int i = 0; i < 16; i++) {
+            indices |= (uint32_t)nearestIndex(texels[i], palette, 4, 3) << (2 * i);
+        }
+    }
+
+    block[0] = c0 & 0xff;
+    block[1] = c0 >> 8;
+    block[2] = c1 & 0xff;
+    block[3] = c1 >> 8;
+    memcpy(block + 4, &indices, 4);
+}
+
+void BCEncoder::encodeBC4(const uint8_t values[16], uint8_t block[8]) {
+    int lo = 255, hi = 0;
+    for (int i = 0; i < 16; i++) {
+        lo = min(lo, (int)values[i]);
+        hi = max(hi, (int)values[i]);
+    }
+
+    // a0 > a1 selects eight interpolated values, equal endpoints decode to a0 for index 0
+    uint64_t bits = (uint64_t)hi | ((uint64_t)lo << 8);
+    if (hi != lo) {
+        int palette[8][4] = {};
+        palette[0][0] = hi;
+        palette[1][0] = lo;
+        for (int i = 1; i < 7; i++) {
+            palette[i + 1][0] = ((7 - i) * hi + i * lo) / 7;
+        }
+
+        for (int i = 0; i < 16; i++) {
+            float texel[4] = { (float)values[i] };
+            bits |= (uint64_t)nearestIndex(texel, palette, 8, 1) << (16 + 3 * i);
+        }
+    }
+
+    memcpy(block, &bits, 8);
+}
+
+void BCEncoder::encodeBC5(const uint8_t rgba[64], uint8_t block[16]) {
+    uint8_t red[16], green[16];
+    for (int i = 0; i < 16; i++) {
+        red[i] = rgba[i * 4 + 0];
+        green[i] = rgba[i * 4 + 1];
+    }
+
+    encodeBC4(red, block);
+    encodeBC4(green, block + 8);
+}
+
+// Writes bit fields from the least significant bit up
+struct BitWriter {
+    uint8_t *out;
+    int position = 0;
+
+    explicit BitWriter(uint8_t *out) : out(out) {}
+
+    void write(uint32_t value, int bits) {
+        for (int i = 0; i < bits; i++, position++) {
+            if ((value >> i) & 1) {
+                out[position >> 3] |= 1 << (position & 7);
+            }
+        }
+    }
+};
+
+// 7 bit endpoint plus a shared p-bit, picks the p-bit that reconstructs the color best
+static void quantizeBC7Mode6(const float endpoint[4], int quantized[4], int &pbit) {
+    float bestError = 1e30f;
+    for (int p = 0; p < 2; p++) {
+        int q[4];
+        float error = 0.0f;
+        for (int c = 0; c < 4; c++) {
+            q[c] = min(max((int)lround((endpoint[c] - p) / 2.0f), 0), 127);
+            float d = endpoint[c] - ((q[c] << 1) | p);
+            error += d * d;
+        }
+        if (error < bestError) {
+            bestError = error;
+            pbit = p;
+            memcpy(quantized, q, sizeof(q));
+        }
+    }
+}
+
+void BCEncoder::encodeBC7(const uint8_t rgba[64], uint8_t block[16]) {
+    static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    float texels[16][4];
+    loadTexels(rgba, texels);
+
+    float e[2][4];
+    fitEndpoints(texels, 4, e[0], e[1]);
+
+    int q[2][4], p[2];
+    quantizeBC7Mode6(e[0], q[0], p[0]);
+    quantizeBC7Mode6(e[1], q[1], p[1]);
+
+    int palette[16][4];
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 4; c++) {
+            int a = (q[0][c] << 1) | p[0], b = (q[1][c] << 1) | p[1];
+            palette[i][c] = ((64 - weights[i]) * a + weights[i] * b + 32) >> 6;
+        }
+    }
+
+    int indices[16];
+    for (int i = 0; i < 16; i++) {
+        indices[i] = nearestIndex(texels[i], palette, 16, 4);
+    }
+
+    // The first index is stored without its top bit, so it has to be in the lower half
+    if (indices[0] & 8) {
+        swap(q[0], q[1]);
+        swap(p[0], p[1]);
+        for (int i = 0; i < 16; i++) {
+            indices[i] = 15 - indices[i];
+        }
+    }
+
+    memset(block, 0, 16);
+    BitWriter writer(block);
+    writer.write(1 << 6, 7);
+    for (int c = 0; c < 4; c++) {
+        writer.write(q[0][c], 7);
+        writer.write(q[1][c], 7);
+    }
+    writer.write(p[0], 1);
+    writer.write(p[1], 1);
+    writer.write(indices[0], 3);
+    for (int i = 1; i < 16; i++) {
+        writer.write(indices[i], 4);
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef BC_ENCODER_H
+#define BC_ENCODER_H
+
+#include <cstdint>
+
+// Encoders for single 4x4 blocks. Input texels are RGBA8, row by row.
+// Endpoints are fit along the principal axis of the block and each texel takes the nearest palette entry.
+class BCEncoder {
+public:
+    static void encodeBC1(const uint8_t rgba[64], uint8_t block[8]);
+    // values holds one 8 bit channel per texel
+    static void encodeBC4(const uint8_t values[16], uint8_t block[8]);
+    // red and green as two BC4 blocks
+    static void encodeBC5(const uint8_t rgba[64], uint8_t block[16]);
+    // mode 6 only: one subset, RGBA endpoints with 4 bit indices
+    static void encodeBC7(const uint8_t rgba[64], uint8_t block[16]);
+
+private:
+    BCEncoder() {}
+};
+
+#endif
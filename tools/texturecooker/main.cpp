@@ -0,0 +1,288 @@
+// Converts material textures to block compressed dds files with full mip chains.
+// The output is written next to the source as <texture>.cooked.dds, which the
+// engine loads instead of the source while it is up to date.
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+#include <stb_image.h>
+
+#include <Graphics/DDS.h>
+#include <ThreadPool.h>
+#include <common.h>
+
+#include "BCEncoder.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+enum CookFormat { AUTO_COLOR, COOK_BC1, COOK_BC4, COOK_BC5, COOK_BC7 };
+
+struct Image {
+    int width, height;
+    vector<uint8_t> rgba;
+};
+
+static bool isUpToDate(const string &derived, const string &source) {
+    struct stat derivedStat, sourceStat;
+    if (stat(derived.c_str(), &derivedStat) != 0 || stat(source.c_str(), &sourceStat) != 0) {
+        return false;
+    }
+    return derivedStat.st_mtime >= sourceStat.st_mtime;
+}
+
+static bool hasSuffix(const string &str, const string &suffix) {
+    return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static bool isNormalMapName(string name) {
+    transform(name.begin(), name.end(), name.begin(), ::tolower);
+    return name.find("_ddn") != string::npos || name.find("_normal") != string::npos;
+}
+
+// Half resolution 2x2 box filter, normals are renormalized after averaging
+static Image downsample(const Image &src, bool normalMap) {
+    Image dst;
+    dst.width = max(src.width / 2, 1);
+    dst.height = max(src.height / 2, 1);
+    dst.rgba.resize((size_t)dst.width * dst.height * 4);
+
+    for (int y = 0; y < dst.height; y++) {
+        for (int x = 0; x < dst.width; x++) {
+            float sum[4] = {};
+            for (int dy = 0; dy < 2; dy++) {
+                for (int dx = 0; dx < 2; dx++) {
+                    int sx = min(x * 2 + dx, src.width - 1), sy = min(y * 2 + dy, src.height - 1);
+                    const uint8_t *texel = &src.rgba[((size_t)sy * src.width + sx) * 4];
+                    for (int c = 0; c < 4; c++) {
+                        sum[c] += texel[c] / 4.0f;
+                    }
+                }
+            }
+
+            if (normalMap) {
+                float n[3], length = 0.0f;
+                for (int c = 0; c < 3; c++) {
+                    n[c] = sum[c] / 127.5f - 1.0f;
+                    length += n[c] * n[c];
+                }
+                length = sqrt(length);
+                for (int c = 0; c < 3 && length > 0.0f; c++) {
+                    sum[c] = (n[c] / length + 1.0f) * 127.5f;
+                }
+            }
+
+            uint8_t *texel = &dst.rgba[((size_t)y * dst.width + x) * 4];
+            for (int c = 0; c < 4; c++) {
+                texel[c] = (uint8_t)min(max(lround(sum[c]), 0L), 255L);
+            }
+        }
+    }
+
+    return dst;
+}
+
+static void encodeLevel(const Image &image, DDS::Format format, uint8_t *out) {
+    int blocksX = (image.width + 3) / 4, blocksY = (image.height + 3) / 4;
+    size_t blockSize = DDS::getBlockSize(format);
+
+    ThreadPool::getInstance().parallelFor(blocksY, [&] (size_t by) {
+        for (int bx = 0; bx < blocksX; bx++) {
+            // texels past the edge repeat the last row/column
+            uint8_t rgba[64], values[16];
+            for (int i = 0; i < 16; i++) {
+                int x = min(bx * 4 + i % 4, image.width - 1), y = min((int)by * 4 + i / 4, image.height - 1);
+                memcpy(&rgba[i * 4], &image.rgba[((size_t)y * image.width + x) * 4], 4);
+                values[i] = rgba[i * 4];
+            }
+
+            uint8_t *block = out + (by * blocksX + bx) * blockSize;
+            switch (format) {
+                case DDS::BC1: BCEncoder::encodeBC1(rgba, block); break;
+                case DDS::BC4: BCEncoder::encodeBC4(values, block); break;
+                case DDS::BC5: BCEncoder::encodeBC5(rgba, block); break;
+                case DDS::BC7: BCEncoder::encodeBC7(rgba, block); break;
+                default: break;
+            }
+        }
+    });
+}
+
+static bool cookTexture(const string &path, CookFormat cookFormat) {
+    string cookedname = path + ".cooked.dds";
+
+    if (hasSuffix(path, ".dds")) {
+        LOG_INFO("skipping ", path, ": already block compressed");
+        return true;
+    }
+    if (isUpToDate(cookedname, path)) {
+        LOG_INFO("skipping ", path, ": up to date");
+        return true;
+    }
+
+    Image image;
+    int channels;
+    unsigned char *pixels = stbi_load(path.c_str(), &image.width, &image.height, &channels, STBI_rgb_alpha);
+    if (pixels == nullptr) {
+        LOG_ERROR("Failed to load ", path, ": ", stbi_failure_reason());
+        return false;
+    }
+    image.rgba.assign(pixels, pixels + (size_t)image.width * image.height * 4);
+    stbi_image_free(pixels);
+
+    DDS::Format format;
+    switch (cookFormat) {
+        case COOK_BC1: format = DDS::BC1; break;
+        case COOK_BC4: format = DDS::BC4; break;
+        case COOK_BC5: format = DDS::BC5; break;
+        case COOK_BC7: format = DDS::BC7; break;
+        default: {
+            if (isNormalMapName(path)) {
+                format = DDS::BC5;
+                break;
+            }
+
+            bool opaque = true;
+            for (size_t i = 3; i < image.rgba.size() && opaque; i += 4) {
+                opaque = image.rgba[i] == 255;
+            }
+            format = opaque ? DDS::BC1 : DDS::BC7;
+        }
+    }
+
+    int width = image.width, height = image.height;
+    uint32_t levelCount = (uint32_t)log2(max(width, height)) + 1;
+    vector<unsigned char> data = DDS::createHeader(format, width, height, levelCount);
+
+    size_t sourceSize = 0;
+    for (uint32_t level = 0; level < levelCount; level++) {
+        if (level > 0) {
+            image = downsample(image, format == DDS::BC5);
+        }
+
+        size_t offset = data.size();
+        data.resize(offset + DDS::getLevelSize(format, image.width, image.height));
+        encodeLevel(image, format, data.data() + offset);
+
+        sourceSize += image.rgba.size();
+    }
+
+    // Write to a temporary first so a failed write never leaves a truncated file that looks up to date
+    string tmpname = cookedname + ".tmp";
+    FILE *fp = fopen(tmpname.c_str(), "wb");
+    if (fp == nullptr) {
+        LOG_ERROR("Failed to write ", tmpname, ": ", strerror(errno));
+        return false;
+    }
+    bool written = fwrite(data.data(), 1, data.size(), fp) == data.size();
+    written = (fclose(fp) == 0) && written;
+
+    remove(cookedname.c_str());
+    if (!written || rename(tmpname.c_str(), cookedname.c_str()) != 0) {
+        LOG_ERROR("Failed to write ", cookedname);
+        remove(tmpname.c_str());
+        return false;
+    }
+
+    const char *formatName = format == DDS::BC1 ? "BC1" : format == DDS::BC4 ? "BC4" : format == DDS::BC5 ? "BC5" : "BC7";
+    LOG_INFO("cooked ", path, " (", width, "x", height, " ", formatName, ", ",
+             levelCount, " levels) ", sourceSize / 1024, " KB -> ", data.size() / 1024, " KB");
+
+    return true;
+}
+
+// Every texture slot the engine reads, spec and PBR maps are single channel, bump maps are normal maps
+static bool cookMaterials(const string &mtlname) {
+    ifstream stream(mtlname);
+    if (!stream) {
+        LOG_ERROR("Failed to open ", mtlname);
+        return false;
+    }
+
+    map<string, int> materialMap;
+    vector<tinyobj::material_t> materials;
+    string warning;
+    tinyobj::LoadMtl(&materialMap, &materials, &stream, &warning);
+    if (!warning.empty()) {
+        LOG_WARN(warning);
+    }
+
+    const pair<string tinyobj::material_t::*, CookFormat> slots[] = {
+        { &tinyobj::material_t::diffuse_texname, AUTO_COLOR },
+        { &tinyobj::material_t::specular_texname, COOK_BC4 },
+        { &tinyobj::material_t::normal_texname, COOK_BC5 },
+        { &tinyobj::material_t::bump_texname, COOK_BC5 },
+        { &tinyobj::material_t::roughness_texname, COOK_BC4 },
+        { &tinyobj::material_t::metallic_texname, COOK_BC4 },
+        { &tinyobj::material_t::alpha_texname, COOK_BC4 },
+    };
+
+    string basedir = mtlname.substr(0, mtlname.find_last_of('/') + 1);
+    map<string, CookFormat> textures;
+    for (const tinyobj::material_t &material : materials) {
+        for (const auto &slot : slots) {
+            string texname = material.*slot.first;
+            if (texname.empty()) {
+                continue;
+            }
+
+            replace(texname.begin(), texname.end(), '\\', '/');
+            textures[basedir + texname] = isNormalMapName(texname) ? COOK_BC5 : slot.second;
+        }
+    }
+
+    bool success = true;
+    for (const auto &texture : textures) {
+        success = cookTexture(texture.first, texture.second) && success;
+    }
+    return success;
+}
+
+static void printUsage(const char *program) {
+    fprintf(stderr,
+        "usage: %s [-f bc1|bc4|bc5|bc7] <file.mtl | image>...\n"
+        "  .mtl files cook every texture they reference, the format follows the material slot\n"
+        "  images are cooked with the given format, or BC1/BC7 depending on alpha\n", program);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    CookFormat format = AUTO_COLOR;
+    bool success = true;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-f" && i + 1 < argc) {
+            string name = argv[++i];
+            if (name == "bc1") { format = COOK_BC1; }
+            else if (name == "bc4") { format = COOK_BC4; }
+            else if (name == "bc5") { format = COOK_BC5; }
+            else if (name == "bc7") { format = COOK_BC7; }
+            else {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (hasSuffix(arg, ".mtl")) {
+            success = cookMaterials(arg) && success;
+        }
+        else {
+            success = cookTexture(arg, format) && success;
+        }
+    }
+
+    return success ? 0 : 1;
+}